@@ -0,0 +1,103 @@
+/*
+ Arena.cpp
+ CodeGenerator
+
+ A bump allocator for data that lives exactly as long as one compilation.
+ Memory is taken from the general heap in large blocks and handed out by
+ advancing a pointer; nothing is freed individually, and everything is freed
+ together by release() or when the arena is destroyed.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "Arena.hpp"
+#include "HeapStats.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+/*
+ Starts empty; the first block is taken on the first allocation.
+ */
+Arena::Arena()
+{
+    blocks = NULL;
+    next = NULL;
+    limit = NULL;
+    allocated = 0;
+}
+
+/*
+ Frees every block.
+ */
+Arena::~Arena()
+{
+    release();
+}
+
+/*
+ Frees everything allocated from the arena at once.
+ */
+void Arena::release()
+{
+    Block *block;
+
+    while (blocks != NULL)
+    {
+        block = blocks;
+        blocks = block->next;
+        free(block);
+    }
+
+    next = NULL;
+    limit = NULL;
+    allocated = 0;
+}
+
+/*
+ Exchanges everything allocated with another arena, without copying.
+ */
+void Arena::swap(Arena &other)
+{
+    std::swap(blocks, other.blocks);
+    std::swap(next, other.next);
+    std::swap(limit, other.limit);
+    std::swap(allocated, other.allocated);
+}
+
+/*
+ Returns the number of bytes taken from the general heap.
+ */
+size_t Arena::getBytesAllocated()
+{
+    return allocated;
+}
+
+/*
+ Starts a new block when the current one is full. Requests larger than a
+ block get a block of their own.
+ */
+void *Arena::allocateBlock(size_t size, size_t align)
+{
+    size_t header = (sizeof(Block) + align - 1) & ~(align - 1);
+    size_t blockSize = header + size;
+    Block *block;
+
+    if (blockSize < BLOCK_SIZE)
+        blockSize = BLOCK_SIZE;
+
+    block = (Block *) malloc(blockSize);
+    if (block == NULL)
+        throw std::bad_alloc();
+    HeapStats::recordAllocation(blockSize);
+
+    block->next = blocks;
+    block->size = blockSize;
+    blocks = block;
+    allocated += blockSize;
+
+    next = (char *) block + header + size;
+    limit = (char *) block + blockSize;
+
+    return (char *) block + header;
+}
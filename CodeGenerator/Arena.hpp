@@ -0,0 +1,71 @@
+/*
+ Arena.hpp
+ CodeGenerator
+
+ A bump allocator for data that lives exactly as long as one compilation.
+ Memory is taken from the general heap in large blocks and handed out by
+ advancing a pointer; nothing is freed individually, and everything is freed
+ together by release() or when the arena is destroyed.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef Arena_hpp
+#define Arena_hpp
+
+#include <cstddef>
+
+class Arena
+{
+private:
+    struct Block
+    {
+        Block *next;
+        size_t size;
+    };
+
+    static const size_t BLOCK_SIZE = 64 * 1024;
+    Block *blocks;
+    char *next;
+    char *limit;
+    size_t allocated;
+
+private:
+    void *allocateBlock(size_t size, size_t align);
+
+public:
+    Arena();
+    ~Arena();
+    void release();
+    void swap(Arena &other);
+    size_t getBytesAllocated();
+
+    /*
+     Returns size bytes aligned to align, which must be a power of two.
+     */
+    void *allocate(size_t size, size_t align)
+    {
+        char *p = (char *) (((size_t) next + align - 1) & ~(align - 1));
+
+        if (next == NULL || (size_t) (limit - p) < size)
+            return allocateBlock(size, align);
+
+        next = p + size;
+        return p;
+    }
+
+    /*
+     Returns uninitialized room for count objects of type T.
+     */
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        return (T *) allocate(count * sizeof(T), alignof(T));
+    }
+
+private:
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+};
+
+#endif /* Arena_hpp */
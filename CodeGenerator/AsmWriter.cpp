@@ -0,0 +1,899 @@
+/*
+ AsmWriter.cpp
+ CodeGenerator
+
+ Writes a whole program as one .asm file of Hack assembly, straight from the
+ VM code held in a VMProgram, with no .vm files or separate translator in
+ between. The work that a VM translator repeats at every call, return and
+ comparison is done once, in shared routines that the code jumps to: a call
+ site is four instructions and a return two. Within a run of code with no
+ label, the value on top of the stack is kept in the D register rather than
+ in memory, so that a value pushed only to be popped, added or tested is
+ never stored, and the stack pointer is only moved when it has to be.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "AsmWriter.hpp"
+#include <algorithm>
+#include <set>
+
+/*
+ The routines every program shares. Each $ENTRY.n routine, which the
+ program adds for each argument count n it calls with, leaves the count in
+ D and goes on to $ENTRY, the last of them by falling into it.
+
+ $ENTRY starts a function: R13 holds the address to return to, R14 the
+ address of the function's body and D the number of arguments. It saves the
+ caller's frame on the stack and points ARG and LCL at the new one.
+
+ $RETURN returns from a function with its value in D, which it leaves there
+ as the top of the caller's stack, unstored, with SP pointing where it goes.
+
+ $GT, $LT and $EQ compare the value on the stack with the one in R13 and go
+ back to the address in D with the result, true or false, in D. $LESS
+ finds whether R15 is less than R13, testing signs first so that a
+ difference that would overflow is never taken.
+ */
+static const char *const runtime[] =
+{
+    "($ENTRY)",
+    "@SP", "D=M-D", "@R15", "M=D",
+    "@R13", "D=M", "@SP", "A=M", "M=D",
+    "@LCL", "D=M", "@SP", "AM=M+1", "M=D",
+    "@ARG", "D=M", "@SP", "AM=M+1", "M=D",
+    "@THIS", "D=M", "@SP", "AM=M+1", "M=D",
+    "@THAT", "D=M", "@SP", "AM=M+1", "M=D",
+    "@SP", "MD=M+1", "@LCL", "M=D",
+    "@R15", "D=M", "@ARG", "M=D",
+    "@R14", "A=M", "0;JMP",
+
+    "($RETURN)",
+    "@R14", "M=D",
+    "@LCL", "D=M", "@5", "A=D-A", "D=M", "@R13", "M=D",
+    "@ARG", "D=M", "@SP", "M=D",
+    "@LCL", "AM=M-1", "D=M", "@THAT", "M=D",
+    "@LCL", "AM=M-1", "D=M", "@THIS", "M=D",
+    "@LCL", "AM=M-1", "D=M", "@ARG", "M=D",
+    "@LCL", "AM=M-1", "D=M", "@LCL", "M=D",
+    "@R14", "D=M", "@R13", "A=M", "0;JMP",
+
+    "($GT)",
+    "@R14", "M=D",
+    "@R13", "D=M", "@R15", "M=D",
+    "@SP", "AM=M-1", "D=M", "@R13", "M=D",
+    "@$LESS", "0;JMP",
+
+    "($LT)",
+    "@R14", "M=D",
+    "@SP", "AM=M-1", "D=M", "@R15", "M=D",
+    "($LESS)",
+    "@R13", "D=M", "@$LESS_NEGATIVE", "D;JLT",
+    "@R15", "D=M", "@$TRUE", "D;JLT",
+    "@$LESS_SAME", "0;JMP",
+    "($LESS_NEGATIVE)",
+    "@R15", "D=M", "@$FALSE", "D;JGE",
+    "($LESS_SAME)",
+    "@R13", "D=D-M", "@$TRUE", "D;JLT",
+    "@$FALSE", "0;JMP",
+
+    "($EQ)",
+    "@R14", "M=D",
+    "@SP", "AM=M-1", "D=M", "@R13", "D=D-M",
+    "@$TRUE", "D;JEQ",
+    "($FALSE)",
+    "D=0", "@R14", "A=M", "0;JMP",
+    "($TRUE)",
+    "D=-1", "@R14", "A=M", "0;JMP"
+};
+
+AsmWriter::AsmWriter()
+{
+    romSize = 0;
+    code = NULL;
+    labelCount = 0;
+    cached = false;
+}
+
+/*
+ Writes the program to fileName, or to standard output if it is empty. The
+ program must hold every subroutine it calls, the OS's included, as the
+ Hack machine has nothing else to run. Returns false, with the reasons in
+ diagnostics, if it does not, or if its statics or code do not fit in the
+ machine.
+ */
+bool AsmWriter::write(VMProgram &program, const string &fileName,
+                      string &diagnostics)
+{
+    string root;
+    bool ok = true;
+
+    if (!checkProgram(program, root, diagnostics))
+        return false;
+
+    if (!out.open(fileName))
+    {
+        diagnostics += "cannot create " + fileName + "\n";
+        return false;
+    }
+
+    romSize = 0;
+    writeRuntime(root);
+
+    for (int u = 0; u < program.getUnitCount(); u++)
+    {
+        code = &program.getCode(u);
+        className.clear();
+        writeCode(code->getInstructions());
+    }
+
+    if (!out.close())
+    {
+        diagnostics += fileName + ": cannot write output\n";
+        ok = false;
+    }
+    if (romSize > (size_t) ROM_SIZE)
+    {
+        diagnostics += "program is " + std::to_string(romSize) +
+                       " instructions, more than the ROM holds\n";
+        ok = false;
+    }
+
+    return ok;
+}
+
+/*
+ Finds the function the program starts at, as VMProgram::removeDeadCode()
+ does, and the argument counts of every call, and checks that each
+ function called is in the program and that the statics fit in the RAM
+ set aside for them.
+ */
+bool AsmWriter::checkProgram(VMProgram &program, string &root,
+                             string &diagnostics)
+{
+    std::set<string> defined;
+    std::set<string> missing;
+    int staticCount = 0;
+
+    for (int u = 0; u < program.getUnitCount(); u++)
+    {
+        VMCode &unit = program.getCode(u);
+        vector<VMInstruction> &instructions = unit.getInstructions();
+
+        for (size_t i = 0; i < instructions.size(); i++)
+        {
+            if (instructions[i].op == VM_FUNCTION)
+                defined.insert(unit.getName(instructions[i].name));
+        }
+    }
+
+    root = defined.count("Sys.init") ? "Sys.init" : "Main.main";
+    if (defined.count(root) == 0)
+    {
+        diagnostics += "program has no Main.main\n";
+        return false;
+    }
+
+    argumentCounts.clear();
+    argumentCounts[root].push_back(0);
+    allCounts.assign(1, 0);
+
+    for (int u = 0; u < program.getUnitCount(); u++)
+    {
+        VMCode &unit = program.getCode(u);
+        vector<VMInstruction> &instructions = unit.getInstructions();
+        std::set<int> statics;
+
+        for (size_t i = 0; i < instructions.size(); i++)
+        {
+            const VMInstruction &instruction = instructions[i];
+
+            if ((instruction.op == VM_PUSH || instruction.op == VM_POP) &&
+                instruction.segment == SEG_STATIC)
+                statics.insert(instruction.value);
+
+            if (instruction.op != VM_CALL)
+                continue;
+
+            const string &name = unit.getName(instruction.name);
+            vector<int> &counts = argumentCounts[name];
+
+            if (std::find(counts.begin(), counts.end(), instruction.value) ==
+                counts.end())
+                counts.push_back(instruction.value);
+            if (std::find(allCounts.begin(), allCounts.end(),
+                          instruction.value) == allCounts.end())
+                allCounts.push_back(instruction.value);
+            if (defined.count(name) == 0 && missing.insert(name).second)
+                diagnostics += name + ": no such subroutine\n";
+        }
+        staticCount += (int) statics.size();
+    }
+
+    if (staticCount > STATIC_LIMIT)
+    {
+        diagnostics += "program has " + std::to_string(staticCount) +
+                       " static variables, more than the RAM holds\n";
+        return false;
+    }
+
+    if (!missing.empty())
+    {
+        diagnostics += "the Hack machine has no OS of its own: compile the "
+                       "OS's classes with the program\n";
+        return false;
+    }
+
+    std::sort(allCounts.begin(), allCounts.end());
+    return true;
+}
+
+/*
+ Writes the code that sets up the stack and calls the program's first
+ function, stopping in a loop if it ever returns, and then the shared
+ routines.
+ */
+void AsmWriter::writeRuntime(const string &root)
+{
+    functionName.clear();
+    labelCount = 0;
+    cached = false;
+
+    emitAt(256);
+    emit("D=A");
+    emitAt("SP");
+    emit("M=D");
+    writeCall(root, 0);
+    emitLabel("$HALT");
+    emitAt("$HALT");
+    emit("0;JMP");
+
+    for (size_t i = 0; i < allCounts.size(); i++)
+    {
+        emitLabel("$ENTRY." + std::to_string(allCounts[i]));
+        emitAt("R14");
+        emit("M=D");
+        loadConstant(allCounts[i]);
+        if (i + 1 < allCounts.size())
+        {
+            emitAt("$ENTRY");
+            emit("0;JMP");
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(runtime) / sizeof(runtime[0]); i++)
+        emit(runtime[i]);
+}
+
+/*
+ Writes the entry points of a function, one for each argument count it is
+ called with, and the start of its body, which sets its locals to 0.
+ */
+void AsmWriter::writeFunction(const VMInstruction &instruction)
+{
+    vector<int> &counts = argumentCounts[code->getName(instruction.name)];
+    string body;
+    int localCount = instruction.value;
+
+    functionName = code->getName(instruction.name);
+    labelCount = 0;
+    cached = false;
+    if (className.empty())
+        className = functionName.substr(0, functionName.find('.'));
+    body = functionName + "$body";
+
+    out.append("// ");
+    out.append(functionName.data(), functionName.length());
+    out.append("\n", 1);
+
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        emitLabel(entryName(functionName, counts[i]));
+        emitAt("R13");
+        emit("M=D");
+        emitAt(body);
+        emit("D=A");
+        emitAt("$ENTRY." + std::to_string(counts[i]));
+        emit("0;JMP");
+    }
+    emitLabel(body);
+
+    if (localCount > 0 && localCount <= 4)
+    {
+        emitAt("SP");
+        emit("A=M");
+        emit("M=0");
+        for (int i = 1; i < localCount; i++)
+        {
+            emit("A=A+1");
+            emit("M=0");
+        }
+        emit("D=A+1");
+        emitAt("SP");
+        emit("M=D");
+    }
+    else if (localCount > 4)
+    {
+        emitAt(localCount);
+        emit("D=A");
+        emitLabel(functionName + "$zero");
+        emitAt("SP");
+        emit("AM=M+1");
+        emit("A=A-1");
+        emit("M=0");
+        emit("D=D-1");
+        emitAt(functionName + "$zero");
+        emit("D;JGT");
+    }
+}
+
+/*
+ Writes the code of a class. A push that an arithmetic instruction or a
+ test and branch takes straight off the stack is written together with it
+ where the two make shorter code than each would alone.
+ */
+void AsmWriter::writeCode(const vector<VMInstruction> &instructions)
+{
+    for (size_t i = 0; i < instructions.size(); i++)
+    {
+        const VMInstruction &instruction = instructions[i];
+        int next = (i + 1 < instructions.size()) ? instructions[i + 1].op : 0;
+        size_t branch;
+        bool negate;
+
+        switch (instruction.op)
+        {
+            case VM_PUSH:
+                if (isBinary(next) && writeOperand(instruction, next))
+                {
+                    i++;
+                    break;
+                }
+                if (next == VM_EQ || next == VM_LT || next == VM_GT)
+                {
+                    branch = findBranch(instructions, i + 1, negate);
+                    if (branch != 0 &&
+                        writeTest(instruction, next, negate,
+                                  instructions[branch].name))
+                    {
+                        i = branch;
+                        break;
+                    }
+                }
+                writePush(instruction);
+                break;
+
+            case VM_POP:
+                writePop(instruction);
+                break;
+
+            case VM_ADD:
+                load();
+                emitAt("SP");
+                emit("AM=M-1");
+                emit("D=D+M");
+                break;
+
+            case VM_SUB:
+                load();
+                emitAt("SP");
+                emit("AM=M-1");
+                emit("D=M-D");
+                break;
+
+            case VM_AND:
+                load();
+                emitAt("SP");
+                emit("AM=M-1");
+                emit("D=D&M");
+                break;
+
+            case VM_OR:
+                load();
+                emitAt("SP");
+                emit("AM=M-1");
+                emit("D=D|M");
+                break;
+
+            case VM_NEG:
+                load();
+                emit("D=-D");
+                break;
+
+            case VM_NOT:
+                load();
+                emit("D=!D");
+                break;
+
+            case VM_EQ:
+            case VM_LT:
+            case VM_GT:
+                branch = findBranch(instructions, i, negate);
+                writeCompare(instruction.op, negate,
+                             (branch != 0) ? instructions[branch].name : -1);
+                if (branch != 0)
+                    i = branch;
+                break;
+
+            case VM_LABEL:
+                flush();
+                emitLabel(labelName(instruction.name));
+                break;
+
+            case VM_GOTO:
+                flush();
+                emitAt(labelName(instruction.name));
+                emit("0;JMP");
+                break;
+
+            case VM_IF_GOTO:
+                load();
+                emitAt(labelName(instruction.name));
+                emit("D;JNE");
+                cached = false;
+                break;
+
+            case VM_FUNCTION:
+                writeFunction(instruction);
+                break;
+
+            case VM_CALL:
+                flush();
+                writeCall(code->getName(instruction.name), instruction.value);
+                break;
+
+            case VM_RETURN:
+                load();
+                emitAt("$RETURN");
+                emit("0;JMP");
+                cached = false;
+                break;
+        }
+    }
+}
+
+/*
+ Pushes a value, which only puts it in D once whatever was in D is stored.
+ */
+void AsmWriter::writePush(const VMInstruction &instruction)
+{
+    int segment = instruction.segment;
+    int index = instruction.value;
+
+    flush();
+
+    if (segment == SEG_CONSTANT)
+    {
+        loadConstant(index);
+    }
+    else if (segmentBase(segment) == NULL || index <= 3)
+    {
+        address(segment, index);
+        emit("D=M");
+    }
+    else
+    {
+        emitAt(index);
+        emit("D=A");
+        emitAt(segmentBase(segment));
+        emit("A=D+M");
+        emit("D=M");
+    }
+    cached = true;
+}
+
+/*
+ Pops the top of the stack into a segment. An address too far into the
+ segment to reach without D is found in D while R13 holds the value, which
+ is then got back as the difference between their sum and the address.
+ */
+void AsmWriter::writePop(const VMInstruction &instruction)
+{
+    int segment = instruction.segment;
+    int index = instruction.value;
+
+    load();
+
+    if (isDirect(segment, index))
+    {
+        address(segment, index);
+        emit("M=D");
+    }
+    else
+    {
+        emitAt("R13");
+        emit("M=D");
+        emitAt(segmentBase(segment));
+        emit("D=M");
+        emitAt(index);
+        emit("D=D+A");
+        emitAt("R13");
+        emit("D=D+M");
+        emit("A=D-M");
+        emit("M=D-A");
+    }
+    cached = false;
+}
+
+/*
+ Writes a push followed by add, sub, and or or as one operation on D, if
+ the pushed value is a constant or can be addressed without D. Returns
+ false, having written nothing, if it cannot.
+ */
+bool AsmWriter::writeOperand(const VMInstruction &push, int op)
+{
+    static const char *const withA[] = { "D=D+A", "D=D-A", "D=D&A", "D=D|A" };
+    static const char *const withM[] = { "D=D+M", "D=D-M", "D=D&M", "D=D|M" };
+    int which = (op == VM_ADD) ? 0 : (op == VM_SUB) ? 1 :
+                (op == VM_AND) ? 2 : 3;
+
+    if (push.segment == SEG_CONSTANT)
+    {
+        if (push.value < 0 || push.value > 32767)
+            return false;
+        load();
+        if (push.value == 1 && which < 2)
+        {
+            emit((which == 0) ? "D=D+1" : "D=D-1");
+            return true;
+        }
+        emitAt(push.value);
+        emit(withA[which]);
+        return true;
+    }
+
+    if (!isDirect(push.segment, push.value))
+        return false;
+    load();
+    address(push.segment, push.value);
+    emit(withM[which]);
+    return true;
+}
+
+/*
+ Writes a push, a comparison and a branch on its result as a test of D, if
+ the pushed value can be compared with D directly: any value that can be
+ addressed without D for eq, and a constant that is not negative for lt and
+ gt. A value below 0 is less than any such constant, and any other can be
+ compared with it by subtracting, which cannot then overflow. Returns
+ false, having written nothing, if it cannot.
+ */
+bool AsmWriter::writeTest(const VMInstruction &push, int op, bool negate,
+                          int target)
+{
+    string label = labelName(target);
+    string skip;
+    int value = push.value;
+    bool constant = (push.segment == SEG_CONSTANT &&
+                     value >= 0 && value <= 32767);
+
+    if (op == VM_EQ)
+    {
+        if (!constant && !isDirect(push.segment, value))
+            return false;
+        load();
+        if (!constant)
+        {
+            address(push.segment, value);
+            emit("D=D-M");
+        }
+        else if (value != 0)
+        {
+            emitAt(value);
+            emit("D=D-A");
+        }
+        emitAt(label);
+        emit(negate ? "D;JNE" : "D;JEQ");
+        cached = false;
+        return true;
+    }
+
+    if (!constant)
+        return false;
+    load();
+    if (value != 0)
+    {
+        // A value below 0 is below c, so it branches if less is wanted
+        if ((op == VM_LT) != negate)
+        {
+            emitAt(label);
+        }
+        else
+        {
+            skip = newLabel("skip");
+            emitAt(skip);
+        }
+        emit("D;JLT");
+        emitAt(value);
+        emit("D=D-A");
+    }
+    emitAt(label);
+    if (op == VM_LT)
+        emit(negate ? "D;JGE" : "D;JLT");
+    else
+        emit(negate ? "D;JLE" : "D;JGT");
+    if (!skip.empty())
+        emitLabel(skip);
+    cached = false;
+    return true;
+}
+
+/*
+ Writes a comparison, which leaves true or false in D, and the branch that
+ follows it, if target is one. Comparing for equality and branching needs
+ no routine, as x - y is 0 exactly when x is y, even when it overflows.
+ */
+void AsmWriter::writeCompare(int op, bool negate, int target)
+{
+    string returnLabel;
+
+    load();
+
+    if (op == VM_EQ && target >= 0)
+    {
+        emitAt("SP");
+        emit("AM=M-1");
+        emit("D=M-D");
+        emitAt(labelName(target));
+        emit(negate ? "D;JNE" : "D;JEQ");
+        cached = false;
+        return;
+    }
+
+    returnLabel = newLabel("ret");
+    emitAt("R13");
+    emit("M=D");
+    emitAt(returnLabel);
+    emit("D=A");
+    emitAt((op == VM_EQ) ? "$EQ" : (op == VM_LT) ? "$LT" : "$GT");
+    emit("0;JMP");
+    emitLabel(returnLabel);
+
+    if (target >= 0)
+    {
+        emitAt(labelName(target));
+        emit(negate ? "D;JEQ" : "D;JNE");
+        cached = false;
+    }
+}
+
+/*
+ Writes a call, once its arguments are all on the stack. The function
+ returns with its value in D.
+ */
+void AsmWriter::writeCall(const string &name, int argumentCount)
+{
+    string returnLabel = newLabel("ret");
+
+    emitAt(returnLabel);
+    emit("D=A");
+    emitAt(entryName(name, argumentCount));
+    emit("0;JMP");
+    emitLabel(returnLabel);
+    cached = true;
+}
+
+/*
+ Makes sure the top of the stack is in D, taking it off the stack if it is
+ not.
+ */
+void AsmWriter::load()
+{
+    if (cached)
+        return;
+    emitAt("SP");
+    emit("AM=M-1");
+    emit("D=M");
+    cached = true;
+}
+
+/*
+ Stores the value in D on the stack, if it is the top of the stack, so that
+ the stack is all in memory, as it must be at a label, a jump or a call.
+ */
+void AsmWriter::flush()
+{
+    if (!cached)
+        return;
+    emitAt("SP");
+    emit("AM=M+1");
+    emit("A=A-1");
+    emit("M=D");
+    cached = false;
+}
+
+/*
+ Puts a constant in D. An A instruction holds 15 bits, so a negative
+ constant is loaded as its negation or complement.
+ */
+void AsmWriter::loadConstant(int value)
+{
+    value = (short) (unsigned short) value;
+
+    if (value == 0)
+    {
+        emit("D=0");
+    }
+    else if (value == 1)
+    {
+        emit("D=1");
+    }
+    else if (value == -1)
+    {
+        emit("D=-1");
+    }
+    else if (value > 0)
+    {
+        emitAt(value);
+        emit("D=A");
+    }
+    else if (value > -32768)
+    {
+        emitAt(-value);
+        emit("D=-A");
+    }
+    else
+    {
+        emitAt(32767);
+        emit("D=!A");
+    }
+}
+
+/*
+ Puts the address of a variable in A, leaving D as it is. The variable must
+ be one isDirect() accepts.
+ */
+void AsmWriter::address(int segment, int index)
+{
+    const char *base = segmentBase(segment);
+
+    if (base != NULL)
+    {
+        emitAt(base);
+        emit((index == 0) ? "A=M" : "A=M+1");
+        for (int i = 1; i < index; i++)
+            emit("A=A+1");
+    }
+    else if (segment == SEG_STATIC)
+    {
+        emitAt(className + "." + std::to_string(index));
+    }
+    else if (segment == SEG_TEMP)
+    {
+        emitAt("R" + std::to_string(5 + index));
+    }
+    else
+    {
+        emitAt((index == 0) ? "THIS" : "THAT");
+    }
+}
+
+/*
+ Returns a new label of the current function's own, e.g. Main.main$ret.3.
+ */
+string AsmWriter::newLabel(const char *kind)
+{
+    return functionName + "$" + kind + "." + std::to_string(labelCount++);
+}
+
+/*
+ Returns the label a VM label stands for. VM labels belong to a function,
+ so the function's name is put before it.
+ */
+string AsmWriter::labelName(int name)
+{
+    return functionName + "$" + code->getName(name);
+}
+
+/*
+ Returns the label a call with the given number of arguments goes to.
+ */
+string AsmWriter::entryName(const string &name, int argumentCount)
+{
+    vector<int> &counts = argumentCounts[name];
+
+    if (counts.empty() || counts[0] == argumentCount)
+        return name;
+    return name + "$args" + std::to_string(argumentCount);
+}
+
+/*
+ Writes an instruction, or a label, on a line of its own.
+ */
+void AsmWriter::emit(const char *text)
+{
+    out.append(text);
+    out.append("\n", 1);
+    if (text[0] != '(')
+        romSize++;
+}
+
+/*
+ Writes an A instruction loading a symbol's address.
+ */
+void AsmWriter::emitAt(const string &symbol)
+{
+    out.append("@", 1);
+    out.append(symbol.data(), symbol.length());
+    out.append("\n", 1);
+    romSize++;
+}
+
+/*
+ Writes an A instruction loading a number.
+ */
+void AsmWriter::emitAt(int value)
+{
+    emitAt(std::to_string(value));
+}
+
+/*
+ Writes a label, which takes no room in the ROM.
+ */
+void AsmWriter::emitLabel(const string &symbol)
+{
+    out.append("(", 1);
+    out.append(symbol.data(), symbol.length());
+    out.append(")\n", 2);
+}
+
+/*
+ Returns the register that points at a segment, or NULL for a segment at a
+ fixed place.
+ */
+const char *AsmWriter::segmentBase(int segment)
+{
+    switch (segment)
+    {
+        case SEG_LOCAL:
+            return "LCL";
+        case SEG_ARGUMENT:
+            return "ARG";
+        case SEG_THIS:
+            return "THIS";
+        case SEG_THAT:
+            return "THAT";
+    }
+    return NULL;
+}
+
+/*
+ Returns true if address() can put a variable's address in A, without D,
+ in a few instructions.
+ */
+bool AsmWriter::isDirect(int segment, int index)
+{
+    if (segment == SEG_CONSTANT)
+        return false;
+    return segmentBase(segment) == NULL || index <= 7;
+}
+
+/*
+ Returns true for the arithmetic instructions that take two values and
+ leave one.
+ */
+bool AsmWriter::isBinary(int op)
+{
+    return op == VM_ADD || op == VM_SUB || op == VM_AND || op == VM_OR;
+}
+
+/*
+ Returns the position of the if-goto that branches on the result of the
+ comparison at compare, with negate set if a not comes between them, or 0
+ if the result is not branched on straight away.
+ */
+size_t AsmWriter::findBranch(const vector<VMInstruction> &instructions,
+                             size_t compare, bool &negate)
+{
+    size_t i = compare + 1;
+
+    negate = false;
+    if (i < instructions.size() && instructions[i].op == VM_NOT)
+    {
+        negate = true;
+        i++;
+    }
+    if (i < instructions.size() && instructions[i].op == VM_IF_GOTO)
+        return i;
+    return 0;
+}
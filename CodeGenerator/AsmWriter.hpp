@@ -0,0 +1,92 @@
+/*
+ AsmWriter.hpp
+ CodeGenerator
+
+ Writes a whole program as one .asm file of Hack assembly, straight from the
+ VM code held in a VMProgram, with no .vm files or separate translator in
+ between. The work that a VM translator repeats at every call, return and
+ comparison is done once, in shared routines that the code jumps to: a call
+ site is four instructions and a return two. Within a run of code with no
+ label, the value on top of the stack is kept in the D register rather than
+ in memory, so that a value pushed only to be popped, added or tested is
+ never stored, and the stack pointer is only moved when it has to be.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef AsmWriter_hpp
+#define AsmWriter_hpp
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include "OutputFile.hpp"
+#include "VMProgram.hpp"
+
+using std::string;
+using std::vector;
+
+class AsmWriter
+{
+private:
+    static const int ROM_SIZE = 32768;
+    static const int STATIC_LIMIT = 240;
+
+    OutputFile out;
+    size_t romSize;
+
+    // The argument counts each function is called with. A call with the
+    // first count enters it at its name, any other count at a label of its
+    // own.
+    std::unordered_map<string, vector<int> > argumentCounts;
+
+    // Every argument count any call passes
+    vector<int> allCounts;
+
+    // The class and function being written, and the next number for a
+    // label of the function's own
+    VMCode *code;
+    string className;
+    string functionName;
+    int labelCount;
+
+    // Whether the value on top of the stack is in D rather than in memory
+    bool cached;
+
+private:
+    bool checkProgram(VMProgram &program, string &root,
+                      string &diagnostics);
+    void writeRuntime(const string &root);
+    void writeFunction(const VMInstruction &instruction);
+    void writeCode(const vector<VMInstruction> &instructions);
+    void writePush(const VMInstruction &instruction);
+    void writePop(const VMInstruction &instruction);
+    bool writeOperand(const VMInstruction &push, int op);
+    bool writeTest(const VMInstruction &push, int op, bool negate,
+                   int target);
+    void writeCompare(int op, bool negate, int target);
+    void writeCall(const string &name, int argumentCount);
+    void load();
+    void flush();
+    void loadConstant(int value);
+    void address(int segment, int index);
+    string newLabel(const char *kind);
+    string labelName(int name);
+    string entryName(const string &name, int argumentCount);
+    void emit(const char *text);
+    void emitAt(const string &symbol);
+    void emitAt(int value);
+    void emitLabel(const string &symbol);
+    static const char *segmentBase(int segment);
+    static bool isDirect(int segment, int index);
+    static bool isBinary(int op);
+    static size_t findBranch(const vector<VMInstruction> &instructions,
+                             size_t compare, bool &negate);
+
+public:
+    AsmWriter();
+    bool write(VMProgram &program, const string &fileName,
+               string &diagnostics);
+};
+
+#endif /* AsmWriter_hpp */
@@ -0,0 +1,391 @@
+/*
+ Benchmark.cpp
+ CodeGenerator
+
+ Measures how fast the compiler tokenizes, parses and writes XML, on given
+ source files and on synthetic classes from a few kilobytes up to a chosen
+ size. It checks that each phase's time grows in proportion to the size of
+ its input, and compares the speeds with those saved by an earlier run,
+ so that a change that makes the compiler slower is noticed.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "Benchmark.hpp"
+#include "JackGenerator.hpp"
+#include "OutputFile.hpp"
+#include "SourceFile.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+// The smallest and default largest synthetic classes
+static const size_t MIN_SYNTHETIC_SIZE = 1024;
+static const size_t DEFAULT_MAX_SIZE = 16 * 1024 * 1024;
+
+// Inputs smaller than this take too little time to show how a phase scales
+static const size_t MIN_SCALING_SIZE = 256 * 1024;
+
+// The most a phase's time may grow with size: time ~ size^SCALING_LIMIT
+static const double SCALING_LIMIT = 1.25;
+
+static const double DEFAULT_THRESHOLD = 0.2;
+
+static const char *phaseName(int phase)
+{
+    return CompilationEngine::getPhaseName(phase);
+}
+
+Benchmark::Benchmark()
+{
+    maxSize = DEFAULT_MAX_SIZE;
+    threshold = DEFAULT_THRESHOLD;
+}
+
+/*
+ Sets the size of the largest synthetic class. The sizes measured start at
+ 1KB and grow by four times up to this.
+ */
+void Benchmark::setMaxSize(size_t size)
+{
+    maxSize = size;
+}
+
+/*
+ Sets how much slower than the baseline, as a fraction, a phase may be
+ before it counts as a regression.
+ */
+void Benchmark::setThreshold(double fraction)
+{
+    threshold = fraction;
+}
+
+/*
+ Measures every file and the synthetic classes, and prints the results.
+ Compares them with baselineFile and saves them to saveFile if either is
+ given. Returns false if anything failed to compile, a phase scaled worse
+ than linearly, or a phase regressed.
+ */
+bool Benchmark::run(vector<string> &files, string baselineFile,
+                    string saveFile)
+{
+    bool ok = true;
+
+    if (!makeDirectory())
+    {
+        std::cerr << "cannot create a directory for the benchmark" << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < files.size() && ok; i++)
+    {
+        SourceFile source;
+        string name = files[i].substr(files[i].find_last_of('/') + 1);
+
+        if (!source.open(files[i]))
+        {
+            std::cerr << files[i] << ": cannot open file" << endl;
+            ok = false;
+            break;
+        }
+        ok = measure(name.substr(0, name.find_last_of('.')),
+                     string(source.begin(), source.end()), false);
+    }
+
+    for (size_t size = MIN_SYNTHETIC_SIZE; size <= maxSize && ok; size *= 4)
+    {
+        JackGenerator generator(1);
+        string name = "Synthetic" + std::to_string(size);
+
+        ok = measure(name, generator.generate(name, size), true);
+    }
+    removeDirectory();
+    if (!ok)
+        return false;
+
+    writeResults(cout);
+    ok = checkScaling(cout);
+    if (!baselineFile.empty())
+        ok = compareBaseline(baselineFile, cout) && ok;
+    if (!saveFile.empty() && !saveBaseline(saveFile))
+    {
+        std::cerr << saveFile << ": cannot write file" << endl;
+        ok = false;
+    }
+    return ok;
+}
+
+/*
+ Makes a private directory for the sources and their output.
+ */
+bool Benchmark::makeDirectory()
+{
+    const char *base = getenv("TMPDIR");
+    string pattern = string((base != NULL) ? base : "/tmp") +
+                     "/jackbench.XXXXXX";
+    vector<char> name(pattern.begin(), pattern.end());
+
+    name.push_back('\0');
+    if (mkdtemp(name.data()) == NULL)
+        return false;
+
+    directory = name.data();
+    return true;
+}
+
+void Benchmark::removeDirectory()
+{
+    rmdir(directory.c_str());
+}
+
+/*
+ Compiles one source several times and keeps the fastest time of each
+ phase, which is the least disturbed by the rest of the machine. The
+ source is written to the benchmark's directory first so its output does
+ not land next to the original.
+ */
+bool Benchmark::measure(string name, const string &text, bool synthetic)
+{
+    string fileName = directory + "/" + name + ".jack";
+    int repeatCount = (text.length() <= 1024 * 1024) ? 5 :
+                      (text.length() <= 16 * 1024 * 1024) ? 3 : 1;
+    OutputFile file;
+    Result result;
+
+    if (!file.open(fileName))
+        return false;
+    file.append(text.data(), text.length());
+    if (!file.close())
+    {
+        std::cerr << fileName << ": cannot write file" << endl;
+        return false;
+    }
+
+    result.name = name;
+    result.synthetic = synthetic;
+    for (int p = 0; p < PHASE_COUNT; p++)
+        result.seconds[p] = HUGE_VAL;
+
+    for (int r = 0; r < repeatCount; r++)
+    {
+        NameTable names;
+        CompileOptions options;
+
+        options.nameTable = &names;
+        CompilationEngine ce(fileName, NULL, options);
+        const CompileStats &stats = ce.getStats();
+
+        if (!ce.getDiagnostics().empty())
+        {
+            std::cerr << name << ": " << ce.getDiagnostics();
+            unlink(fileName.c_str());
+            unlink(CompilationEngine::getOutFileName(fileName).c_str());
+            return false;
+        }
+
+        result.bytes = stats.sourceBytes;
+        result.tokens = stats.tokenCount;
+        for (int p = 0; p < PHASE_COUNT; p++)
+            result.seconds[p] = std::min(result.seconds[p], stats.seconds[p]);
+    }
+
+    unlink(fileName.c_str());
+    unlink(CompilationEngine::getOutFileName(fileName).c_str());
+    results.push_back(result);
+    return true;
+}
+
+/*
+ Returns the speed of a phase in megabytes of source per second.
+ */
+double Benchmark::getSpeed(const Result &result, int phase)
+{
+    double seconds = std::max(result.seconds[phase], 1e-9);
+
+    return result.bytes / seconds / (1024.0 * 1024.0);
+}
+
+/*
+ Prints a table of the speed of each phase on each input, in megabytes of
+ source and millions of tokens per second.
+ */
+void Benchmark::writeResults(std::ostream &out)
+{
+    out << std::left << std::setw(20) << "input" << std::right
+        << std::setw(12) << "bytes" << std::setw(11) << "tokens";
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        out << std::setw(15) << string(phaseName(p)) + " MB/s"
+            << std::setw(9) << "Mtok/s";
+    }
+    out << "\n";
+
+    out << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        Result &result = results[i];
+
+        out << std::left << std::setw(20) << result.name << std::right
+            << std::setw(12) << result.bytes << std::setw(11)
+            << result.tokens;
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            double seconds = std::max(result.seconds[p], 1e-9);
+
+            out << std::setw(15) << getSpeed(result, p) << std::setw(9)
+                << result.tokens / seconds / 1e6;
+        }
+        out << "\n";
+    }
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+}
+
+/*
+ Fits time = c * size^e to each phase on the larger synthetic classes and
+ reports the exponent. An exponent above SCALING_LIMIT means the phase does
+ more work per byte the more bytes it is given.
+ */
+bool Benchmark::checkScaling(std::ostream &out)
+{
+    bool ok = true;
+
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+        double exponent;
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            double x, y;
+
+            if (!results[i].synthetic || results[i].bytes < MIN_SCALING_SIZE)
+                continue;
+
+            x = log((double) results[i].bytes);
+            y = log(std::max(results[i].seconds[p], 1e-9));
+            n++;
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+        }
+        if (n < 2)
+            continue;
+
+        exponent = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+        out << phaseName(p) << " time grows as size^"
+            << std::fixed << std::setprecision(2) << exponent;
+        out.unsetf(std::ios::floatfield);
+        if (exponent > SCALING_LIMIT)
+        {
+            out << ": worse than linear";
+            ok = false;
+        }
+        out << "\n";
+    }
+    return ok;
+}
+
+/*
+ Reads a baseline: lines of input name, phase and megabytes per second.
+ Lines starting with # are comments.
+ */
+bool Benchmark::readBaseline(string fileName,
+                             std::map<string, double> &speeds)
+{
+    std::ifstream in(fileName.c_str());
+    string line;
+
+    if (!in)
+        return false;
+
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        string name, phase;
+        double speed;
+
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (fields >> name >> phase >> speed)
+            speeds[name + " " + phase] = speed;
+    }
+    return true;
+}
+
+/*
+ Reports every phase that is more than the threshold slower than in the
+ baseline. Inputs the baseline does not have are skipped.
+ */
+bool Benchmark::compareBaseline(string fileName, std::ostream &out)
+{
+    std::map<string, double> speeds;
+    int regressions = 0;
+    int compared = 0;
+
+    if (!readBaseline(fileName, speeds))
+    {
+        std::cerr << fileName << ": cannot open file" << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            std::map<string, double>::iterator it =
+                speeds.find(results[i].name + " " + phaseName(p));
+            double speed = getSpeed(results[i], p);
+
+            if (it == speeds.end())
+                continue;
+
+            compared++;
+            if (speed < it->second * (1 - threshold))
+            {
+                out << results[i].name << " " << phaseName(p)
+                    << " regressed: " << std::fixed << std::setprecision(1)
+                    << speed << " MB/s, baseline " << it->second
+                    << " MB/s\n";
+                out.unsetf(std::ios::floatfield);
+                regressions++;
+            }
+        }
+    }
+
+    out << compared << " speeds compared with " << fileName << ", "
+        << regressions << " regressed by more than "
+        << (int) (threshold * 100 + 0.5) << "%\n";
+    return regressions == 0;
+}
+
+/*
+ Saves the speeds in the format readBaseline() reads.
+ */
+bool Benchmark::saveBaseline(string fileName)
+{
+    OutputFile out;
+    char line[128];
+
+    if (!out.open(fileName))
+        return false;
+
+    out.append("# input phase MB/s\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            snprintf(line, sizeof(line), "%s %s %.1f\n",
+                     results[i].name.c_str(), phaseName(p),
+                     getSpeed(results[i], p));
+            out.append(line);
+        }
+    }
+    return out.close();
+}
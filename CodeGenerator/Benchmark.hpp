@@ -0,0 +1,63 @@
+/*
+ Benchmark.hpp
+ CodeGenerator
+
+ Measures how fast the compiler tokenizes, parses and writes XML, on given
+ source files and on synthetic classes from a few kilobytes up to a chosen
+ size. It checks that each phase's time grows in proportion to the size of
+ its input, and compares the speeds with those saved by an earlier run,
+ so that a change that makes the compiler slower is noticed.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef Benchmark_hpp
+#define Benchmark_hpp
+
+#include "CompilationEngine.hpp"
+#include <iostream>
+#include <map>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+class Benchmark
+{
+private:
+    /*
+     The fastest time of each phase over the repeated runs on one input.
+     */
+    struct Result
+    {
+        string name;
+        size_t bytes;
+        int tokens;
+        bool synthetic;
+        double seconds[PHASE_COUNT];
+    };
+
+    vector<Result> results;
+    string directory;
+    size_t maxSize;
+    double threshold;
+
+private:
+    bool makeDirectory();
+    void removeDirectory();
+    bool measure(string name, const string &text, bool synthetic);
+    void writeResults(std::ostream &out);
+    bool checkScaling(std::ostream &out);
+    bool readBaseline(string fileName, std::map<string, double> &speeds);
+    bool compareBaseline(string fileName, std::ostream &out);
+    bool saveBaseline(string fileName);
+    static double getSpeed(const Result &result, int phase);
+
+public:
+    Benchmark();
+    void setMaxSize(size_t size);
+    void setThreshold(double fraction);
+    bool run(vector<string> &files, string baselineFile, string saveFile);
+};
+
+#endif /* Benchmark_hpp */
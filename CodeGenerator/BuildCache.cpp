@@ -0,0 +1,174 @@
+/*
+ BuildCache.cpp
+ CodeGenerator
+
+ An on-disk cache of compiler output, keyed on a hash of each source file's
+ contents together with the compiler version and the options that affect the
+ output. A file whose key is already in the cache is not tokenized or parsed
+ again; its output is copied from the cache instead.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "BuildCache.hpp"
+#include "SourceFile.hpp"
+#include "OutputFile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+
+/*
+ Part of every cache key. Change it whenever the compiler's output changes
+ for the same input, so that entries from older builds are never reused.
+ */
+static const char *const COMPILER_VERSION = "CodeGenerator 1.2";
+
+/*
+ Opens (creating if needed) the cache directory. The options string should
+ name every setting that changes the output for a given source.
+ */
+BuildCache::BuildCache(string directory, string options)
+{
+    string identity = COMPILER_VERSION;
+    struct stat info;
+
+    identity += '\0';
+    identity += options;
+
+    this->directory = directory;
+    seed = hash(identity.data(), identity.length(), 0);
+    hits = 0;
+    misses = 0;
+
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        usable = false;
+    else
+        usable = (stat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode));
+}
+
+/*
+ Determines whether the cache directory exists and can be used.
+ */
+bool BuildCache::isUsable()
+{
+    return usable;
+}
+
+/*
+ Returns the cache key of a source file's contents.
+ */
+unsigned long long BuildCache::makeKey(const char *data, size_t length)
+{
+    return hash(data, length, seed);
+}
+
+/*
+ Returns the path of the cache entry for a key.
+ */
+string BuildCache::getEntryName(unsigned long long key)
+{
+    char name[32];
+
+    snprintf(name, sizeof(name), "/%016llx.out", key);
+    return directory + name;
+}
+
+/*
+ Copies the cached output for a key to the output file. The output file is
+ left untouched if it already holds the same bytes. Returns false if the key
+ is not in the cache.
+ */
+bool BuildCache::restore(unsigned long long key, string outFileName)
+{
+    if (!usable || !copyFile(getEntryName(key), outFileName))
+    {
+        misses++;
+        return false;
+    }
+
+    hits++;
+    return true;
+}
+
+/*
+ Adds a freshly written output file to the cache under a key.
+ */
+void BuildCache::store(unsigned long long key, string outFileName)
+{
+    if (usable)
+        copyFile(outFileName, getEntryName(key));
+}
+
+/*
+ Returns the number of files whose output was found in the cache.
+ */
+int BuildCache::getHits()
+{
+    return hits;
+}
+
+/*
+ Returns the number of files that had to be compiled.
+ */
+int BuildCache::getMisses()
+{
+    return misses;
+}
+
+/*
+ Copies a file. The copy is made through an OutputFile, so the destination is
+ replaced atomically and only if its contents change.
+ */
+bool BuildCache::copyFile(string fromFileName, string toFileName)
+{
+    SourceFile from;
+    OutputFile to;
+
+    if (!from.open(fromFileName) || !to.open(toFileName))
+        return false;
+
+    to.writeRaw(from.begin(), from.size());
+    return to.close();
+}
+
+/*
+ A fast 64-bit hash. The input is consumed eight bytes at a time, each word
+ scrambled by a multiply and folded into the state, and the result is
+ finished with the MurmurHash3 avalanche.
+ */
+unsigned long long BuildCache::hash(const char *data, size_t length,
+                                    unsigned long long seed)
+{
+    const unsigned long long PRIME = 0x9E3779B97F4A7C15ULL;
+    unsigned long long h = seed ^ (length * PRIME);
+    unsigned long long word;
+
+    while (length >= 8)
+    {
+        memcpy(&word, data, 8);
+        word *= 0xFF51AFD7ED558CCDULL;
+        word ^= word >> 32;
+        h = (h ^ word) * PRIME;
+        h = (h << 29) | (h >> 35);
+        data += 8;
+        length -= 8;
+    }
+
+    if (length > 0)
+    {
+        word = 0;
+        memcpy(&word, data, length);
+        word *= 0xFF51AFD7ED558CCDULL;
+        word ^= word >> 32;
+        h = (h ^ word) * PRIME;
+    }
+
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
@@ -0,0 +1,50 @@
+/*
+ BuildCache.hpp
+ CodeGenerator
+
+ An on-disk cache of compiler output, keyed on a hash of each source file's
+ contents together with the compiler version and the options that affect the
+ output. A file whose key is already in the cache is not tokenized or parsed
+ again; its output is copied from the cache instead.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef BuildCache_hpp
+#define BuildCache_hpp
+
+#include <iostream>
+#include <atomic>
+
+using std::string;
+
+class BuildCache
+{
+private:
+    string directory;
+    unsigned long long seed;
+    bool usable;
+    std::atomic<int> hits;
+    std::atomic<int> misses;
+
+private:
+    string getEntryName(unsigned long long key);
+
+public:
+    BuildCache(string directory, string options);
+    bool isUsable();
+    unsigned long long makeKey(const char *data, size_t length);
+    bool restore(unsigned long long key, string outFileName);
+    void store(unsigned long long key, string outFileName);
+    int getHits();
+    int getMisses();
+    static unsigned long long hash(const char *data, size_t length,
+                                   unsigned long long seed);
+    static bool copyFile(string fromFileName, string toFileName);
+
+private:
+    BuildCache(const BuildCache &);
+    BuildCache &operator=(const BuildCache &);
+};
+
+#endif /* BuildCache_hpp */
@@ -0,0 +1,157 @@
+/*
+ BuildStats.cpp
+ CodeGenerator
+
+ Collects what compiling each file took, and the build as a whole, for
+ --stats: the time and heap allocations of each phase, the tokens of each
+ type, the bytes read and written, the rewrites of the VM peephole pass,
+ and the peak memory of the process. Each file has its own slot, so threads
+ compiling different files fill them in without locking. The result is
+ printed as JSON for scripts to read.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "BuildStats.hpp"
+#include "HeapStats.hpp"
+#include "JsonValue.hpp"
+#include <chrono>
+
+BuildStats::BuildStats()
+{
+    threadCount = 0;
+    startTime = 0;
+    seconds = 0;
+}
+
+double BuildStats::now()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ Makes an empty slot for each file and starts the build's clock.
+ */
+void BuildStats::start(const vector<string> &names, int threadCount)
+{
+    this->names = names;
+    this->threadCount = threadCount;
+    files.assign(names.size(), CompileStats());
+    startTime = now();
+}
+
+/*
+ Records the stats of one file. Only the thread compiling the file writes
+ its slot.
+ */
+void BuildStats::setFile(size_t index, const CompileStats &stats)
+{
+    files[index] = stats;
+}
+
+void BuildStats::finish()
+{
+    seconds = now() - startTime;
+}
+
+/*
+ Adds the rewrites a peephole pass made to a file's counts, for the pass a
+ whole-program build makes after the files are compiled.
+ */
+void BuildStats::addPeepholeHits(size_t index, const VMPeephole &peephole)
+{
+    for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++)
+        files[index].peepholeHits[r] += peephole.getHits(r);
+}
+
+/*
+ Writes the members every file and the total have in common: bytes, tokens
+ by type, peephole rewrites by rule, and the time and allocations of each
+ phase.
+ */
+void BuildStats::writeStats(std::ostream &out, const CompileStats &stats,
+                            const char *indent)
+{
+    out << indent << "\"sourceBytes\": " << stats.sourceBytes << ",\n"
+        << indent << "\"outputBytes\": " << stats.outputBytes << ",\n"
+        << indent << "\"treeBytes\": " << stats.treeBytes << ",\n"
+        << indent << "\"tokens\": {\"total\": " << stats.tokenCount;
+    for (int type = T_KEYWORD; type <= T_STRING_CONST; type++)
+    {
+        out << ", \"" << SyntaxTree::getKindName(type) << "\": "
+            << stats.tokenTypeCounts[type];
+    }
+    out << "},\n" << indent << "\"peephole\": {";
+    for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++)
+    {
+        out << ((r == 0) ? "\"" : ", \"") << VMPeephole::getRuleName(r)
+            << "\": " << stats.peepholeHits[r];
+    }
+    out << "},\n" << indent << "\"phases\": {\n";
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        out << indent << "  \"" << CompilationEngine::getPhaseName(p)
+            << "\": {\"seconds\": " << stats.seconds[p]
+            << ", \"allocations\": " << stats.allocations[p]
+            << ", \"allocatedBytes\": " << stats.allocatedBytes[p] << "}"
+            << ((p + 1 < PHASE_COUNT) ? ",\n" : "\n");
+    }
+    out << indent << "}";
+}
+
+/*
+ Writes an object with a member for each file, in the order the files were
+ given, and one for the totals of the whole build.
+ */
+void BuildStats::writeJSON(std::ostream &out)
+{
+    CompileStats total;
+    int cachedCount = 0;
+    int tokensCachedCount = 0;
+    std::streamsize precision = out.precision(9);
+
+    out << "{\n  \"files\": [";
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const CompileStats &stats = files[i];
+
+        out << ((i == 0) ? "\n" : ",\n") << "    {\n      \"name\": ";
+        JsonValue::writeString(out, names[i]);
+        out << ",\n      \"cached\": " << (stats.cached ? "true" : "false")
+            << ",\n      \"tokensCached\": "
+            << (stats.tokensCached ? "true" : "false") << ",\n";
+        writeStats(out, stats, "      ");
+        out << "\n    }";
+
+        cachedCount += stats.cached;
+        tokensCachedCount += stats.tokensCached;
+        total.sourceBytes += stats.sourceBytes;
+        total.outputBytes += stats.outputBytes;
+        total.treeBytes += stats.treeBytes;
+        total.tokenCount += stats.tokenCount;
+        for (int type = T_KEYWORD; type <= T_STRING_CONST; type++)
+            total.tokenTypeCounts[type] += stats.tokenTypeCounts[type];
+        for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++)
+            total.peepholeHits[r] += stats.peepholeHits[r];
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            total.seconds[p] += stats.seconds[p];
+            total.allocations[p] += stats.allocations[p];
+            total.allocatedBytes[p] += stats.allocatedBytes[p];
+        }
+    }
+    out << (files.empty() ? "],\n" : "\n  ],\n");
+
+    out << "  \"total\": {\n"
+        << "    \"files\": " << files.size() << ",\n"
+        << "    \"cachedFiles\": " << cachedCount << ",\n"
+        << "    \"tokensCachedFiles\": " << tokensCachedCount << ",\n"
+        << "    \"threads\": " << threadCount << ",\n"
+        << "    \"wallSeconds\": " << seconds << ",\n"
+        << "    \"peakResidentBytes\": " << HeapStats::getPeakResidentBytes()
+        << ",\n";
+    writeStats(out, total, "    ");
+    out << "\n  }\n}\n";
+    out.precision(precision);
+}
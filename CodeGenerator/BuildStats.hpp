@@ -0,0 +1,48 @@
+/*
+ BuildStats.hpp
+ CodeGenerator
+
+ Collects what compiling each file took, and the build as a whole, for
+ --stats: the time and heap allocations of each phase, the tokens of each
+ type, the bytes read and written, the rewrites of the VM peephole pass,
+ and the peak memory of the process. Each file has its own slot, so threads
+ compiling different files fill them in without locking. The result is
+ printed as JSON for scripts to read.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef BuildStats_hpp
+#define BuildStats_hpp
+
+#include <iostream>
+#include <vector>
+#include "CompilationEngine.hpp"
+
+using std::string;
+using std::vector;
+
+class BuildStats
+{
+private:
+    vector<string> names;
+    vector<CompileStats> files;
+    int threadCount;
+    double startTime;
+    double seconds;
+
+private:
+    static double now();
+    static void writeStats(std::ostream &out, const CompileStats &stats,
+                           const char *indent);
+
+public:
+    BuildStats();
+    void start(const vector<string> &names, int threadCount);
+    void setFile(size_t index, const CompileStats &stats);
+    void addPeepholeHits(size_t index, const VMPeephole &peephole);
+    void finish();
+    void writeJSON(std::ostream &out);
+};
+
+#endif /* BuildStats_hpp */
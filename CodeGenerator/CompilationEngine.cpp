@@ -16,64 +16,602 @@
  */
 
 #include "CompilationEngine.hpp"
+#include "VMGenerator.hpp"
+#include "VMWriter.hpp"
+#include "TreeWriter.hpp"
+#include "HeapStats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+/*
+ Returns the time in seconds from a fixed point, for timing the phases.
+ */
+static double now()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ How tightly each binary operator binds, indexed by Symbol, with 0 for the
+ symbols that are not binary operators. Jack gives every operator the same
+ precedence, so an expression is evaluated left to right; the second row,
+ used when CompileOptions::precedence is set, binds * and / tightest, then
+ + and -, the comparisons, & and lastly |, as C does.
+ */
+static const unsigned char operatorPrecedence[2][S_TILDE + 1] =
+{
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 5, 5, 2, 1, 3, 3, 3, 0}
+};
 
 /*
  Program consists of 3 stages: Building the token list, compiling the class 
- which initializes the recursive descent parsing, and then writes the parsed
- code into an .xml file.
+ which initializes the recursive descent parsing into a parse tree, and then
+ writing the tree into an .xml file.
  */
 CompilationEngine::CompilationEngine(string inFileName)
+    : CompilationEngine(inFileName, NULL, CompileOptions())
+{
+}
+
+CompilationEngine::CompilationEngine(string inFileName, BuildCache *cache)
+    : CompilationEngine(inFileName, cache, CompileOptions())
+{
+}
+
+/*
+ As above, but first looks the source up in a build cache. If the cache holds
+ the output for these exact contents it is copied out and the source is
+ neither tokenized nor parsed. Otherwise the class is compiled and, if it had
+ no errors, its output is added to the cache. The options choose the output
+ format.
+ */
+CompilationEngine::CompilationEngine(string inFileName, BuildCache *cache,
+                                     const CompileOptions &options)
 {
     this->inFileName = inFileName;
-    buildTokenList();
+    this->cache = cache;
+    this->options = options;
+    errorCount = 0;
+    precedences = operatorPrecedence[options.precedence ? 1 : 0];
+    jt.setNameTable(options.nameTable);
+    tree.setNameTable(options.nameTable);
+    
+    pieces = NULL;
+    writingParts = false;
+    editText = NULL;
+    memberStops = NULL;
+    stopped = false;
+    readLength = 0;
+    
+    if (restoreFromCache())
+        return;
+    
+    if ((options.pipeline || options.streaming) &&
+        options.tokenCache == NULL &&
+        (source.isOpen() || source.open(inFileName)))
+    {
+        compileInParts();
+    }
+    else
+    {
+        startPhase(PHASE_TOKENIZE);
+        buildTokenList();
+        endPhase(PHASE_TOKENIZE);
+        
+        startPhase(PHASE_PARSE);
+        compileClass();
+        endPhase(PHASE_PARSE);
+        
+        startPhase(PHASE_OUTPUT);
+        writeOutput();
+        endPhase(PHASE_OUTPUT);
+    }
+    stats.sourceBytes = source.size();
+    stats.tokenCount = jt.getTokenCount();
+    for (int type = T_KEYWORD; type <= T_STRING_CONST; type++)
+        stats.tokenTypeCounts[type] = jt.getTokenCount(type);
+    stats.treeBytes += tree.getBytesAllocated();
+    
+    if (cache != NULL && diagnostics.empty() && !outFileName.empty())
+        cache->store(cache->makeKey(source.begin(), source.size()),
+                     outFileName);
+}
+
+/*
+ Parses Jack text in memory without writing anything, for an editor that
+ checks a file as it is being typed. The text is tokenized only as far
+ ahead as the parser reads, and where each member of the class starts and
+ ends is recorded along with each syntax error's place in the text.
+ 
+ With rule N_CLASS the text is a whole class. Otherwise it starts at a
+ member of a class, and the rest of the class is parsed from there: with
+ N_CLASS_VAR_DEC from a point where class variables may still be
+ declared, and with N_SUBROUTINE_DEC from one where only subroutines may
+ follow. If stops is not NULL the parse ends early, after the first member
+ that ends at one of its offsets, which must be in increasing order. An
+ editor passes the places where members it has already parsed begin, so
+ as not to parse them again.
+ */
+CompilationEngine::CompilationEngine(const char *begin, const char *end,
+                                     int rule, const vector<size_t> *stops,
+                                     const CompileOptions &options)
+{
+    TokenQueue tokens(TOKEN_QUEUE_SIZE);
+    
+    this->options = options;
+    cache = NULL;
+    errorCount = 0;
+    precedences = operatorPrecedence[options.precedence ? 1 : 0];
+    pieces = NULL;
+    writingParts = false;
+    editText = begin;
+    memberStops = stops;
+    stopped = false;
+    
+    jt.startScan(begin, end, &tokens);
+    tc = TokenCursor(&tokens, &jt);
+    if (rule == N_CLASS)
+    {
+        compileClass();
+    }
+    else
+    {
+        tree.beginNode();
+        compileMembers(rule == N_CLASS_VAR_DEC);
+        tree.endNode(N_CLASS);
+    }
+    readLength = getReadOffset();
+    
+    // The cursor must not outlive the queue holding its batch
+    tc = TokenCursor();
+}
+
+/*
+ Compiles the class a part at a time instead of one phase after another.
+ The tokenizer passes tokens to the parser in batches through a ring
+ buffer, and for XML the parser passes the class on to be written a few
+ members at a time, so only a few batches of tokens and a part of the tree
+ are held at once. The other formats need the whole class and are written
+ once it has been parsed.
+ 
+ With options.pipeline the three stages run at the same time on three
+ threads, which overlaps them on a large class. Otherwise they take turns
+ on this thread: the parser has the tokenizer scan each batch as it needs
+ it, and writes each part of the class itself. With options.streaming the
+ pages of the source the parser has finished with are released as well, so
+ the memory taken does not grow with the size of the file. Each phase is
+ timed on the thread it runs on, so on one thread the tokenizing and
+ writing done along the way count as parsing.
+ */
+void CompilationEngine::compileInParts()
+{
+    TokenQueue tokens(TOKEN_QUEUE_SIZE);
+    RingBuffer<SyntaxTree *> members(PIECE_QUEUE_SIZE);
+    std::thread tokenizer;
+    std::thread writer;
+    bool written = true;
+    
+    if (options.pipeline)
+    {
+        tokenizer = std::thread([this, &tokens]()
+        {
+            startPhase(PHASE_TOKENIZE);
+            jt.tokenize(source.begin(), source.end(), &tokens);
+            endPhase(PHASE_TOKENIZE);
+        });
+    }
+    else
+    {
+        jt.startScan(source.begin(), source.end(), &tokens);
+    }
+    
+    if (options.format == FORMAT_XML)
+    {
+        openXMLFile();
+        writingParts = true;
+        if (options.pipeline)
+        {
+            pieces = &members;
+            writer = std::thread([this, &members, &written]()
+            {
+                startPhase(PHASE_OUTPUT);
+                written = writePieces(members);
+                endPhase(PHASE_OUTPUT);
+            });
+        }
+        else
+        {
+            xml.startTag(SyntaxTree::getKindName(N_CLASS));
+        }
+    }
+    
+    startPhase(PHASE_PARSE);
+    tc = TokenCursor(&tokens, options.pipeline ? NULL : &jt);
     compileClass();
-    writeXMLFile();
+    
+    // Anything after the class is not parsed, but the tokenizer must be
+    // allowed to finish
+    while (tc.tokenType() != T_NONE)
+        tc.advance();
+    endPhase(PHASE_PARSE);
+    if (options.pipeline)
+        tokenizer.join();
+    
+    if (!writingParts)
+    {
+        startPhase(PHASE_OUTPUT);
+        writeOutput();
+        endPhase(PHASE_OUTPUT);
+        return;
+    }
+    
+    if (options.pipeline)
+    {
+        writer.join();
+        pieces = NULL;
+    }
+    else
+    {
+        xml.endTag(SyntaxTree::getKindName(N_CLASS));
+        written = xml.close();
+    }
+    writingParts = false;
+    if (!written)
+        addDiagnostic("cannot write output");
+    stats.outputBytes = xml.getBytesWritten();
 }
 
 /*
- Uses the JackTokenizer to build a list of the program's tokens.
+ When the class is being written a part at a time, passes on the part
+ parsed so far once it is big enough to be worth it, and carries on in an
+ empty tree. The last part is passed on when the class has been parsed.
+ */
+void CompilationEngine::sendPiece(bool classEnded)
+{
+    if (!writingParts || (!classEnded && tree.getNodeCount() < PIECE_NODES))
+        return;
+    
+    if (pieces != NULL)
+    {
+        SyntaxTree *piece = new SyntaxTree;
+        
+        takePiece(*piece, classEnded);
+        pieces->push(piece);
+        if (classEnded)
+            pieces->push(NULL);
+    }
+    else
+    {
+        SyntaxTree piece;
+        
+        takePiece(piece, classEnded);
+        writePiece(piece);
+    }
+    
+    // The parser has read everything before the current token
+    if (options.streaming)
+        source.release((size_t) (tc.start() - source.begin()));
+}
+
+/*
+ Moves the tree built so far into piece, closing the class node in it, and
+ leaves the tree empty but for the class node, reopened.
+ */
+void CompilationEngine::takePiece(SyntaxTree &piece, bool classEnded)
+{
+    piece.setNameTable(options.nameTable);
+    piece.swap(tree);
+    if (!classEnded)
+    {
+        piece.endNode(N_CLASS);
+        tree.beginNode();
+    }
+}
+
+/*
+ The writer thread of a pipelined compile: writes each piece of the class
+ the parser sends, until it sends NULL. Returns false if the output could
+ not be written.
+ */
+bool CompilationEngine::writePieces(RingBuffer<SyntaxTree *> &members)
+{
+    SyntaxTree *piece;
+    
+    xml.startTag(SyntaxTree::getKindName(N_CLASS));
+    while ((piece = members.front()) != NULL)
+    {
+        members.pop();
+        writePiece(*piece);
+        delete piece;
+    }
+    members.pop();
+    xml.endTag(SyntaxTree::getKindName(N_CLASS));
+    
+    return xml.close();
+}
+
+/*
+ Writes the children of the class node of a piece, which are the next
+ members of the class.
+ */
+void CompilationEngine::writePiece(SyntaxTree &piece)
+{
+    int root = piece.getRoot();
+    
+    for (int i = 0; i < piece.getChildCount(root); i++)
+        xml.writeTree(piece, piece.getChild(root, i));
+    stats.treeBytes += piece.getBytesAllocated();
+}
+
+/*
+ Starts timing a phase and counting its heap allocations. The counts are
+ kept in the stats until endPhase() turns them into differences.
+ */
+void CompilationEngine::startPhase(int phase)
+{
+    HeapCount count = HeapStats::getThreadCount();
+    
+    stats.seconds[phase] = now();
+    stats.allocations[phase] = count.allocations;
+    stats.allocatedBytes[phase] = count.bytes;
+}
+
+void CompilationEngine::endPhase(int phase)
+{
+    HeapCount count = HeapStats::getThreadCount();
+    
+    stats.seconds[phase] = now() - stats.seconds[phase];
+    stats.allocations[phase] = count.allocations - stats.allocations[phase];
+    stats.allocatedBytes[phase] = count.bytes - stats.allocatedBytes[phase];
+}
+
+/*
+ Copies the output for the source from the build cache, if it is there.
+ */
+bool CompilationEngine::restoreFromCache()
+{
+    if (cache == NULL || inFileName.empty() || inFileName == "-")
+        return false;
+    
+    if (!source.open(inFileName))
+        return false;
+    
+    setOutFileName();
+    stats.sourceBytes = source.size();
+    stats.cached = cache->restore(cache->makeKey(source.begin(),
+                                                 source.size()),
+                                  outFileName);
+    return stats.cached;
+}
+
+/*
+ Uses the JackTokenizer to build a list of the program's tokens. The source is
+ memory-mapped (or read from standard input when no file name is given) and
+ tokenized in place, so the tokens refer directly into the source buffer.
+ With a token cache, the tokens of a source that has not changed since they
+ were saved are mapped from the cache instead, and otherwise saved to it.
  */
 void CompilationEngine::buildTokenList()
 {
-    ifstream jackFile(inFileName);
-    string line;
-    string token;
+    TokenCache *tokens = options.tokenCache;
+    unsigned long long key = 0;
+    
+    if (inFileName.empty() || inFileName == "-")
+        tokens = NULL;
     
-    if (jackFile.is_open())
+    if (source.isOpen() || source.open(inFileName))
     {
-        while (getline(jackFile, line))
+        if (tokens != NULL)
         {
-            if (!jt.isBlockComment(line) && !jt.isInLineComment(line))
-            {
-                jt.tokenize(line);
-            }
+            key = tokens->makeKey(source.begin(), source.size());
+            stats.tokensCached = tokens->load(inFileName, key, source.size(),
+                                              tokenFile, jt);
+        }
+        if (!stats.tokensCached)
+        {
+            jt.tokenize(source.begin(), source.end());
+            if (tokens != NULL)
+                tokens->store(inFileName, key, source.size(), jt);
         }
-        jackFile.close();
     }
+    else
+    {
+        addDiagnostic("cannot open file");
+    }
+    tc = jt.cursor();
 }
 
 /*
- Writes the finished parsed code into an .xml file
+ Returns the name of the .xml file the parsed code of a source file is written
+ to, which is placed next to the source file (e.g. Pong/Ball.jack is written
+ to Pong/OutBall.xml). Code read from standard input is written to standard
+ output, and has no name.
+ */
+string CompilationEngine::getOutFileName(string inFileName)
+{
+    return getOutFileName(inFileName, CompileOptions());
+}
+
+/*
+ As above, for the output format in the options. VM code is written to a
+ .vm file named after the class (e.g. Pong/Ball.jack to Pong/Ball.vm), and
+ a binary tree to a .jtree file (Pong/Ball.jtree).
+ */
+string CompilationEngine::getOutFileName(string inFileName,
+                                         const CompileOptions &options)
+{
+    string outFileName;
+    size_t nameStart = inFileName.find_last_of('/') + 1;
+    
+    if (!inFileName.empty() && inFileName != "-")
+    {
+        outFileName += inFileName.substr(0, nameStart);
+        if (options.format == FORMAT_XML)
+            outFileName += "Out";
+        outFileName += inFileName.substr(nameStart,
+                                         inFileName.find('.', nameStart) -
+                                         nameStart);
+        if (options.format == FORMAT_VM)
+            outFileName += ".vm";
+        else if (options.format == FORMAT_TREE)
+            outFileName += ".jtree";
+        else
+            outFileName += ".xml";
+    }
+    
+    return outFileName;
+}
+
+/*
+ Returns a short description of the options that affect the output, for
+ build caches to keep builds with different options apart.
+ */
+string CompilationEngine::getOptionsKey(const CompileOptions &options)
+{
+    string key;
+    
+    if (options.format == FORMAT_XML)
+        key = "xml";
+    else if (options.format == FORMAT_TREE)
+        key = "tree";
+    else
+        key = options.optimize ? "vm -O" : "vm";
+    
+    if (options.precedence)
+        key += " precedence";
+    return key;
+}
+
+/*
+ Names the file the compiled code is written to.
+ */
+void CompilationEngine::setOutFileName()
+{
+    outFileName = getOutFileName(inFileName, options);
+}
+
+/*
+ Opens the .xml file the parsed code is written to.
+ */
+void CompilationEngine::openXMLFile()
+{
+    setOutFileName();
+    
+    if (!xml.open(outFileName))
+    {
+        addDiagnostic("cannot create " + outFileName);
+    }
+}
+
+/*
+ Writes the parsed class in the format the options chose.
+ */
+void CompilationEngine::writeOutput()
+{
+    if (options.format == FORMAT_VM)
+    {
+        writeVMFile();
+    }
+    else if (options.format == FORMAT_TREE)
+    {
+        writeTreeFile();
+    }
+    else
+    {
+        openXMLFile();
+        writeXMLFile();
+    }
+}
+
+/*
+ Writes the parse tree out as XML and closes the .xml file.
  */
 void CompilationEngine::writeXMLFile()
 {
+    xml.writeTree(tree);
     
-    string outFileName;
-    outFileName += "Out";
-    outFileName += inFileName.erase(inFileName.find("."), inFileName.length());
-    outFileName += ".xml";
+    if (!xml.close())
+    {
+        addDiagnostic("cannot write output");
+    }
+    stats.outputBytes = xml.getBytesWritten();
+}
+
+/*
+ Translates the parse tree into VM code and writes it to a .vm file. Nothing
+ is written if the class has syntax or semantic errors, or if the code is
+ being kept for a whole-program build. With optimize, the code goes through
+ the peephole pass first.
+ */
+void CompilationEngine::writeVMFile()
+{
+    VMGenerator generator(tree, vm);
+    VMWriter writer;
+    VMPeephole peephole;
     
-    ofstream XMLFile(outFileName);
+    if (errorCount > 0)
+        return;
     
-    if (XMLFile.is_open())
+    generator.setOptimize(options.optimize);
+    generator.setPruneUnreachable(options.optimize || options.wholeProgram);
+    if (!generator.generate())
     {
-        for (int i = 0; i < XMLcode.size(); i++)
+        for (size_t i = 0; i < generator.getErrors().size(); i++)
         {
-            XMLFile << XMLcode.at(i) << endl;
+            errorCount++;
+            addDiagnostic(generator.getErrors()[i]);
         }
+        return;
     }
     
-    XMLFile.close();
+    if (options.optimize)
+    {
+        peephole.optimize(vm);
+        for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++)
+            stats.peepholeHits[r] = peephole.getHits(r);
+    }
+    
+    if (options.wholeProgram)
+        return;
+    
+    setOutFileName();
+    if (!writer.open(outFileName))
+    {
+        addDiagnostic("cannot create " + outFileName);
+        return;
+    }
+    writer.writeCode(vm);
+    if (!writer.close())
+    {
+        addDiagnostic("cannot write output");
+    }
+    stats.outputBytes = writer.getBytesWritten();
+}
+
+/*
+ Writes the parse tree to a .jtree file in the binary format. Like the XML,
+ the tree is written even if it has syntax errors, which appear in it as
+ error nodes.
+ */
+void CompilationEngine::writeTreeFile()
+{
+    TreeWriter writer;
+    
+    setOutFileName();
+    if (!writer.open(outFileName))
+    {
+        addDiagnostic("cannot create " + outFileName);
+        return;
+    }
+    writer.writeTree(tree);
+    if (!writer.close())
+    {
+        addDiagnostic("cannot write output");
+    }
+    stats.outputBytes = writer.getBytesWritten();
 }
 
 /*
@@ -81,30 +619,85 @@ void CompilationEngine::writeXMLFile()
  */
 void CompilationEngine::compileClass()
 {
-    indentLevel = 0;
-    jt.nextToken();
-    startTag("class");
+    tree.beginNode();
     
     writeKeyword("class", K_CLASS);
-    jt.nextToken();
+    tc.advance();
     writeIdentifier();
-    jt.nextToken();
-    writeSymbol("{");
-    jt.nextToken();
+    tc.advance();
+    writeSymbol(S_LEFT_BRACE);
+    tc.advance();
     
-    while (isTokenKeyword() && isValidVarDecKeyword())
+    compileMembers(true);
+    
+    tree.endNode(N_CLASS);
+    sendPiece(true);
+}
+
+/*
+ classVarDec* subroutineDec* '}'
+ 
+ The rest of a class, leaving out the class variables if varDecs is false.
+ When parsing for an editor, stops after a member that ends at one of the
+ stops instead.
+ */
+void CompilationEngine::compileMembers(bool varDecs)
+{
+    while (varDecs && !stopped && isTokenKeyword() && isValidVarDecKeyword())
     {
+        beginMember();
         compileClassVarDec();
+        endMember(N_CLASS_VAR_DEC);
+        sendPiece(false);
     }
     
-    while (isTokenKeyword() && isValidSubDecKeyword())
+    while (!stopped && isTokenKeyword() && isValidSubDecKeyword())
     {
+        beginMember();
         compileSubroutine();
+        endMember(N_SUBROUTINE_DEC);
+        sendPiece(false);
     }
-    writeSymbol("}");
+    if (!stopped)
+        writeSymbol(S_RIGHT_BRACE);
+}
+
+/*
+ When parsing for an editor, records that a member of the class starts at
+ the current token.
+ */
+void CompilationEngine::beginMember()
+{
+    ClassMember member;
     
-    indentLevel = 0;
-    endTag("class");
+    if (editText == NULL)
+        return;
+    
+    member.kind = 0;
+    member.start = (size_t) (tc.start() - editText);
+    member.end = member.readEnd = member.start;
+    member.firstError = (int) syntaxErrors.size();
+    member.errorCount = 0;
+    members.push_back(member);
+}
+
+/*
+ Records that the member begun last ends before the current token, which
+ its parse has read, and whether that is one of the stops.
+ */
+void CompilationEngine::endMember(int kind)
+{
+    if (editText == NULL)
+        return;
+    
+    members.back().kind = kind;
+    members.back().end = (size_t) (tc.start() - editText);
+    members.back().readEnd = getReadOffset();
+    members.back().errorCount = (int) syntaxErrors.size() -
+                                members.back().firstError;
+    if (memberStops != NULL)
+        stopped = std::binary_search(memberStops->begin(), memberStops->end(),
+                                     members.back().end);
 }
 
 /*
@@ -112,14 +705,14 @@ void CompilationEngine::compileClass()
  */
 void CompilationEngine::compileClassVarDec()
 {
-    startTag("classVarDec");
+    tree.beginNode();
     
-    writeKeyword(jt.getToken(), jt.keyword());
-    jt.nextToken();
+    writeKeyword(jt.getKeywordText(tc.keyword()), tc.keyword());
+    tc.advance();
     writeVarDec();
-    jt.nextToken();
+    tc.advance();
     
-    endTag("classVarDec");
+    tree.endNode(N_CLASS_VAR_DEC);
 }
 
 /*
@@ -128,25 +721,25 @@ void CompilationEngine::compileClassVarDec()
  */
 void CompilationEngine::compileSubroutine()
 {
-    startTag("subroutineDec");
+    tree.beginNode();
     
-    writeKeyword(jt.getToken(), jt.keyword());
-    jt.nextToken();
-    if (isTokenKeyword())
+    writeKeyword(jt.getKeywordText(tc.keyword()), tc.keyword());
+    tc.advance();
+    if (tc.keyword() == K_VOID)
         writeKeyword("void", K_VOID);
-    else if (isTokenIdentifier())
-        writeIdentifier();
-    jt.nextToken();
+    else
+        writeType();
+    tc.advance();
     writeIdentifier();
-    jt.nextToken();
-    writeSymbol("(");
-    jt.nextToken();
+    tc.advance();
+    writeSymbol(S_LEFT_PAREN);
+    tc.advance();
     compileParameterList();
-    writeSymbol(")");
-    jt.nextToken();
+    writeSymbol(S_RIGHT_PAREN);
+    tc.advance();
     compileSubroutineBody();
     
-    endTag("subroutineDec");
+    tree.endNode(N_SUBROUTINE_DEC);
 }
 
 /*
@@ -154,26 +747,26 @@ void CompilationEngine::compileSubroutine()
  */
 void CompilationEngine::compileParameterList()
 {
-    startTag("parameterList");
+    tree.beginNode();
 
     if (!isTokenSymbol())
     {
         writeType();
-        jt.nextToken();
+        tc.advance();
         writeIdentifier();
-        jt.nextToken();
-        while (isTokenSymbol() && jt.symbol() == ",")
+        tc.advance();
+        while (tc.symbol() == S_COMMA)
         {
-            writeSymbol(",");
-            jt.nextToken();
+            writeSymbol(S_COMMA);
+            tc.advance();
             writeType();
-            jt.nextToken();
+            tc.advance();
             writeIdentifier();
-            jt.nextToken();
+            tc.advance();
         }
     }
 
-    endTag("parameterList");
+    tree.endNode(N_PARAMETER_LIST);
 }
 
 /*
@@ -181,16 +774,16 @@ void CompilationEngine::compileParameterList()
  */
 void CompilationEngine::compileSubroutineBody()
 {
-    startTag("subroutineBody");
+    tree.beginNode();
     
-    writeSymbol("{");
-    jt.nextToken();
+    writeSymbol(S_LEFT_BRACE);
+    tc.advance();
     compileVarDec();
     compileStatements();
-    writeSymbol("}");
-    jt.nextToken();
+    writeSymbol(S_RIGHT_BRACE);
+    tc.advance();
     
-    endTag("subroutineBody");
+    tree.endNode(N_SUBROUTINE_BODY);
 }
 
 /*
@@ -198,17 +791,17 @@ void CompilationEngine::compileSubroutineBody()
  */
 void CompilationEngine::compileVarDec()
 {
-    if (isTokenKeyword() && jt.keyword() == K_VAR)
+    if (isTokenKeyword() && tc.keyword() == K_VAR)
     {
         
-        while (isTokenKeyword() && jt.keyword() == K_VAR)
+        while (isTokenKeyword() && tc.keyword() == K_VAR)
         {
-            startTag("varDec");
+            tree.beginNode();
             writeKeyword("var", K_VAR);
-            jt.nextToken();
+            tc.advance();
             writeVarDec();
-            jt.nextToken();
-            endTag("varDec");
+            tc.advance();
+            tree.endNode(N_VAR_DEC);
         }
     }
 }
@@ -218,21 +811,21 @@ void CompilationEngine::compileVarDec()
  */
 void CompilationEngine::compileStatements()
 {
-    startTag("statements");
+    tree.beginNode();
     while (isTokenKeyword() && isValidStatementKeyword())
     {
-        if (jt.keyword() == K_LET)
+        if (tc.keyword() == K_LET)
             compileLet();
-        else if (jt.keyword() == K_IF)
+        else if (tc.keyword() == K_IF)
             compileIf();
-        else if (jt.keyword() == K_WHILE)
+        else if (tc.keyword() == K_WHILE)
             compileWhile();
-        else if (jt.keyword() == K_DO)
+        else if (tc.keyword() == K_DO)
             compileDo();
-        else if (jt.keyword() == K_RETURN)
+        else if (tc.keyword() == K_RETURN)
             compileReturn();
     }
-    endTag("statements");
+    tree.endNode(N_STATEMENTS);
 }
 
 /*
@@ -240,24 +833,24 @@ void CompilationEngine::compileStatements()
  */
 void CompilationEngine::compileLet()
 {
-    startTag("letStatement");
+    tree.beginNode();
     
     writeKeyword("let", K_LET);
-    jt.nextToken();
+    tc.advance();
     writeIdentifier();
-    jt.nextToken();
-    if (isTokenSymbol() && jt.symbol() == "[")
+    tc.advance();
+    if (tc.symbol() == S_LEFT_BRACKET)
     {
-        writeEnclosedExpression("[", "]");
-        jt.nextToken();
+        writeEnclosedExpression(S_LEFT_BRACKET, S_RIGHT_BRACKET);
+        tc.advance();
     }
-    writeSymbol("=");
-    jt.nextToken();
+    writeSymbol(S_EQUALS);
+    tc.advance();
     compileExpression();
-    writeSymbol(";");
-    jt.nextToken();
+    writeSymbol(S_SEMICOLON);
+    tc.advance();
     
-    endTag("letStatement");
+    tree.endNode(N_LET_STATEMENT);
 }
 
 /*
@@ -265,26 +858,26 @@ void CompilationEngine::compileLet()
  */
 void CompilationEngine::compileIf()
 {
-    startTag("ifStatement");
+    tree.beginNode();
     
     writeKeyword("if", K_IF);
-    jt.nextToken();
-    writeEnclosedExpression("(",")");
-    jt.nextToken();
+    tc.advance();
+    writeEnclosedExpression(S_LEFT_PAREN, S_RIGHT_PAREN);
+    tc.advance();
     writeEnclosedStatements();
-    jt.nextToken();
+    tc.advance();
     if (isTokenKeyword())
     {
-        if (jt.keyword() == K_ELSE)
+        if (tc.keyword() == K_ELSE)
         {
             writeKeyword("else", K_ELSE);
-            jt.nextToken();
+            tc.advance();
             writeEnclosedStatements();
-            jt.nextToken();
+            tc.advance();
         }
     }
     
-    endTag("ifStatement");
+    tree.endNode(N_IF_STATEMENT);
 }
 
 /*
@@ -292,16 +885,16 @@ void CompilationEngine::compileIf()
  */
 void CompilationEngine::compileWhile()
 {
-    startTag("whileStatement");
+    tree.beginNode();
     
     writeKeyword("while", K_WHILE);
-    jt.nextToken();
-    writeEnclosedExpression("(",")");
-    jt.nextToken();
+    tc.advance();
+    writeEnclosedExpression(S_LEFT_PAREN, S_RIGHT_PAREN);
+    tc.advance();
     writeEnclosedStatements();
-    jt.nextToken();
+    tc.advance();
     
-    endTag("whileStatement");
+    tree.endNode(N_WHILE_STATEMENT);
 }
 
 /*
@@ -309,16 +902,16 @@ void CompilationEngine::compileWhile()
  */
 void CompilationEngine::compileDo()
 {
-    startTag("doStatement");
+    tree.beginNode();
     
     writeKeyword("do", K_DO);
-    jt.nextToken();
+    tc.advance();
     writeSubroutineCall();
-    jt.nextToken();
-    writeSymbol(";");
-    jt.nextToken();
+    tc.advance();
+    writeSymbol(S_SEMICOLON);
+    tc.advance();
     
-    endTag("doStatement");
+    tree.endNode(N_DO_STATEMENT);
 }
 
 /*
@@ -326,18 +919,18 @@ void CompilationEngine::compileDo()
  */
 void CompilationEngine::compileReturn()
 {
-    startTag("returnStatement");
+    tree.beginNode();
     
     writeKeyword("return", K_RETURN);
-    jt.nextToken();
-    if (isTokenIdentifier() || isTokenKeyword() || jt.symbol() == "(")
+    tc.advance();
+    if (tc.symbol() != S_SEMICOLON)
     {
         compileExpression();
     }
-    writeSymbol(";");
-    jt.nextToken();
+    writeSymbol(S_SEMICOLON);
+    tc.advance();
     
-    endTag("returnStatement");
+    tree.endNode(N_RETURN_STATEMENT);
 }
 
 /*
@@ -345,19 +938,61 @@ void CompilationEngine::compileReturn()
  */
 void CompilationEngine::compileExpression()
 {
-    startTag("expression");
+    int mark;
+    
+    tree.beginNode();
     
+    mark = tree.getMark();
     compileTerm();
-    jt.nextToken();
-    while (isTokenSymbol() && isValidOpSymbol())
+    tc.advance();
+    compileOperators(mark, 1);
+    
+    tree.endNode(N_EXPRESSION);
+}
+
+/*
+ Parses the (op term)* that follows the operand at mark, for as long as the
+ operators bind at least as tightly as minPrecedence. Operators of the same
+ precedence are applied left to right in one expression. An operand followed
+ by an operator that binds more tightly becomes a term holding its own
+ expression, and so does a chain of tighter operators followed by a looser
+ one. Jack gives every operator the same precedence, so unless
+ options.precedence is set this parses the flat term (op term)* of the
+ grammar.
+ */
+void CompilationEngine::compileOperators(int mark, int minPrecedence)
+{
+    int precedence = precedences[tc.symbol()];
+    
+    while (precedence >= minPrecedence)
     {
-        writeSymbol(jt.symbol());
-        jt.nextToken();
-        compileTerm();
-        jt.nextToken();
-    }
+        int level = precedence;
     
-    endTag("expression");
+        if (tree.getMark() - mark > 1)
+        {
+            tree.wrapNode(mark, N_EXPRESSION);
+            tree.wrapNode(mark, N_TERM);
+        }
+        while (precedence == level)
+        {
+            int operand;
+    
+            writeSymbol(tc.symbol());
+            tc.advance();
+            operand = tree.getMark();
+            compileTerm();
+            tc.advance();
+    
+            precedence = precedences[tc.symbol()];
+            if (precedence > level)
+            {
+                compileOperators(operand, level + 1);
+                tree.wrapNode(operand, N_EXPRESSION);
+                tree.wrapNode(operand, N_TERM);
+                precedence = precedences[tc.symbol()];
+            }
+        }
+    }
 }
 
 /*
@@ -367,62 +1002,70 @@ void CompilationEngine::compileExpression()
  */
 void CompilationEngine::compileTerm()
 {
-    startTag("term");
+    tree.beginNode();
     
-    if (isTokenIntConst())
-    {
-        writeIntVal();
-    }
-    else if (isTokenStringConst())
-    {
-        writeStringVal();
-    }
-    else if (isTokenKeyword())
-    {
-        if (jt.keyword() == K_TRUE)
-            writeKeyword("true", K_TRUE);
-        else if (jt.keyword() == K_FALSE)
-            writeKeyword("false", K_FALSE);
-        else if (jt.keyword() == K_NULL)
-            writeKeyword("null", K_NULL);
-        else if (jt.keyword() == K_THIS)
-            writeKeyword("this", K_THIS);
-    }
-    else if (isTokenIdentifier() && !isArrayReference() && !isSubroutineCall())
-    {
-        writeIdentifier();
-    }
-    else if (isTokenIdentifier() && isArrayReference())
-    {
-        writeIdentifier();
-        jt.nextToken();
-        writeEnclosedExpression("[", "]");
-    }
-    else if (isTokenIdentifier() && isSubroutineCall())
-    {
-        writeSubroutineCall();
-    }
-    else if (isTokenSymbol())
+    switch (tc.tokenType())
     {
-        if (jt.symbol() != "(")
-        {
-            if (jt.symbol() == "-")
-                writeSymbol("-");
-            else if (jt.symbol() == "~")
-                writeSymbol("~");
+        case T_INT_CONST:
+            writeIntVal();
+            break;
+    
+        case T_STRING_CONST:
+            writeStringVal();
+            break;
+    
+        case T_KEYWORD:
+            if (tc.keyword() == K_TRUE)
+                writeKeyword("true", K_TRUE);
+            else if (tc.keyword() == K_FALSE)
+                writeKeyword("false", K_FALSE);
+            else if (tc.keyword() == K_NULL)
+                writeKeyword("null", K_NULL);
+            else if (tc.keyword() == K_THIS)
+                writeKeyword("this", K_THIS);
+            else
+                writeError("Expected term");
+            break;
+    
+        // The token after the name tells the three kinds apart
+        case T_IDENTIFIER:
+            switch (tc.peekSymbol(1))
+            {
+                case S_LEFT_BRACKET:
+                    writeIdentifier();
+                    tc.advance();
+                    writeEnclosedExpression(S_LEFT_BRACKET, S_RIGHT_BRACKET);
+                    break;
+    
+                case S_LEFT_PAREN:
+                case S_PERIOD:
+                    writeSubroutineCall();
+                    break;
+    
+                default:
+                    writeIdentifier();
+                    break;
+            }
+            break;
+    
+        case T_SYMBOL:
+            if (tc.symbol() == S_LEFT_PAREN)
+            {
+                writeEnclosedExpression(S_LEFT_PAREN, S_RIGHT_PAREN);
+                break;
+            }
+    
+            if (tc.symbol() == S_MINUS || tc.symbol() == S_TILDE)
+                writeSymbol(tc.symbol());
             else
                 writeError("Expected unary operator");
-            
-            jt.nextToken();
+    
+            tc.advance();
             compileTerm();
-        }
-        else
-        {
-            writeEnclosedExpression("(",")");
-        }
+            break;
     }
     
-    endTag("term");
+    tree.endNode(N_TERM);
 }
 
 /*
@@ -430,44 +1073,41 @@ void CompilationEngine::compileTerm()
  */
 void CompilationEngine::compileExpressionList()
 {
-    startTag("expressionList");
+    tree.beginNode();
     
-    if (!isTokenSymbol() || jt.symbol() == "(")
+    // An expression can only start with a symbol if it is '(' or a unary op
+    if (!isTokenSymbol() || tc.symbol() == S_LEFT_PAREN ||
+        tc.symbol() == S_MINUS || tc.symbol() == S_TILDE)
     {
         compileExpression();
     }
-    while (isTokenSymbol() && jt.symbol() == ",")
+    while (tc.symbol() == S_COMMA)
     {
-        writeSymbol(",");
-        jt.nextToken();
+        writeSymbol(S_COMMA);
+        tc.advance();
         compileExpression();
     }
     
-    endTag("expressionList");
+    tree.endNode(N_EXPRESSION_LIST);
 }
 
 /*
- Writes the current token which is a keyword with its corresponding XML tags.
+ Adds the current token, which should be the given keyword, to the tree.
  */
 void CompilationEngine::writeKeyword(string token, int keywordType)
 {
     string line;
     
-    if (isTokenKeyword() && jt.keyword() == keywordType)
+    if (isTokenKeyword() && tc.keyword() == keywordType)
     {
-        line = addIndentToLine();
-        line += "<keyword> ";
-        line += token;
-        line += " </keyword>";
-        
-        XMLcode.push_back(line);
+        tree.addTerminal(N_KEYWORD, keywordType);
     }
     else
     {
         line += "Expected '";
         line += token;
         line += "' keyword, received '";
-        line += jt.getToken();
+        line.append(tc.start(), tc.length());
         line += "'";
         
         writeError(line);
@@ -475,21 +1115,13 @@ void CompilationEngine::writeKeyword(string token, int keywordType)
 }
 
 /*
- Writes the current token which is an identifier with its corresponding XML
- tags.
+ Adds the current token, which should be an identifier, to the tree.
  */
 void CompilationEngine::writeIdentifier()
 {
-    string line;
-    
     if (isTokenIdentifier())
     {
-        line = addIndentToLine();
-        line += "<identifier> ";
-        line += jt.identifier();
-        line += " </identifier>";
-        
-        XMLcode.push_back(line);
+        writeName(N_IDENTIFIER);
     }
     else
     {
@@ -498,68 +1130,55 @@ void CompilationEngine::writeIdentifier()
 }
 
 /*
- Writes the current token which is a symbol with its corresponding XML tags.
+ Adds the current token, an identifier or constant, to the tree. The number
+ the tokenizer gave its name is used when there is one, so its text is not
+ looked at again.
+ */
+void CompilationEngine::writeName(int kind)
+{
+    if (tc.name() >= 0)
+        tree.addName(kind, tc.name());
+    else
+        tree.addTerminal(kind, tc.start(), tc.length());
+}
+
+/*
+ Adds the current token, which should be the given symbol, to the tree.
  */
-void CompilationEngine::writeSymbol(string token)
+void CompilationEngine::writeSymbol(int symbol)
 {
-    string symbol;
+    string message;
     
-    if (isTokenSymbol() && jt.symbol() == token)
+    if (tc.symbol() == symbol)
     {
-        if (token == "\"")
-            token = "&quot;";
-        else if (token == "&")
-            token = "&amp;";
-        else if (token == "<")
-            token = "&lt;";
-        else if (token == ">")
-            token = "&gt;";
-        
-        string line = addIndentToLine();
-        line += "<symbol> ";
-        line += token;
-        line += " </symbol>";
-
-        XMLcode.push_back(line);
+        tree.addTerminal(N_SYMBOL, symbol);
     }
     else
     {
-        symbol = "Expected ";
-        symbol += token;
-        symbol += ", Received '";
-        symbol += jt.getToken();
-        symbol += "'";
-        writeError(symbol);
+        message = "Expected ";
+        message += jt.getSymbolText(symbol);
+        message += ", Received '";
+        message.append(tc.start(), tc.length());
+        message += "'";
+        writeError(message);
     }
     
 }
 
 /*
- Writes the current token which is an integer constant with its corresponding
- XML tags.
+ Adds the current token, which is an integer constant, to the tree.
  */
 void CompilationEngine::writeIntVal()
 {
-    string line = addIndentToLine();
-    line += "<integerConstant> ";
-    line += jt.intVal();
-    line += " </integerConstant>";
-    
-    XMLcode.push_back(line);
+    writeName(N_INT_CONST);
 }
 
 /*
- Writes the current token which is a string constant with its corresponding XML
- tags.
+ Adds the current token, which is a string constant, to the tree.
  */
 void CompilationEngine::writeStringVal()
 {
-    string line = addIndentToLine();
-    line += "<stringConstant> ";
-    line += jt.stringVal();
-    line += " </stringConstant>";
-    
-    XMLcode.push_back(line);
+    writeName(N_STRING_CONST);
 }
 
 /*
@@ -569,12 +1188,14 @@ void CompilationEngine::writeType()
 {
     if (isTokenKeyword())
     {
-        if (jt.keyword() == K_INT)
+        if (tc.keyword() == K_INT)
             writeKeyword("int", K_INT);
-        else if (jt.keyword() == K_CHAR)
+        else if (tc.keyword() == K_CHAR)
             writeKeyword("char", K_CHAR);
-        else if (jt.keyword() == K_BOOLEAN)
+        else if (tc.keyword() == K_BOOLEAN)
             writeKeyword("boolean", K_BOOLEAN);
+        else
+            writeError("Expected type");
     }
     else if (isTokenIdentifier())
     {
@@ -588,17 +1209,17 @@ void CompilationEngine::writeType()
 void CompilationEngine::writeVarDec()
 {
     writeType();
-    jt.nextToken();
+    tc.advance();
     writeIdentifier();
-    jt.nextToken();
-    while (isTokenSymbol() && jt.symbol() == ",")
+    tc.advance();
+    while (tc.symbol() == S_COMMA)
     {
-        writeSymbol(",");
-        jt.nextToken();
+        writeSymbol(S_COMMA);
+        tc.advance();
         writeIdentifier();
-        jt.nextToken();
+        tc.advance();
     }
-    writeSymbol(";");
+    writeSymbol(S_SEMICOLON);
 }
 
 /*
@@ -607,26 +1228,26 @@ void CompilationEngine::writeVarDec()
 void CompilationEngine::writeSubroutineCall()
 {
     writeIdentifier();
-    jt.nextToken();
+    tc.advance();
     if (isTokenSymbol())
     {
-        if (jt.symbol() == "(")
+        if (tc.symbol() == S_LEFT_PAREN)
         {
-            writeSymbol("(");
-            jt.nextToken();
+            writeSymbol(S_LEFT_PAREN);
+            tc.advance();
             compileExpressionList();
-            writeSymbol(")");
+            writeSymbol(S_RIGHT_PAREN);
         }
-        else if (jt.symbol() == ".")
+        else if (tc.symbol() == S_PERIOD)
         {
-            writeSymbol(".");
-            jt.nextToken();
+            writeSymbol(S_PERIOD);
+            tc.advance();
             writeIdentifier();
-            jt.nextToken();
-            writeSymbol("(");
-            jt.nextToken();
+            tc.advance();
+            writeSymbol(S_LEFT_PAREN);
+            tc.advance();
             compileExpressionList();
-            writeSymbol(")");
+            writeSymbol(S_RIGHT_PAREN);
         }
         else
         {
@@ -638,10 +1259,10 @@ void CompilationEngine::writeSubroutineCall()
 /*
  Writes an expression enclosed in a symbol (i.e. '(' and ')')
  */
-void CompilationEngine::writeEnclosedExpression(string open, string close)
+void CompilationEngine::writeEnclosedExpression(int open, int close)
 {
     writeSymbol(open);
-    jt.nextToken();
+    tc.advance();
     compileExpression();
     writeSymbol(close);
 }
@@ -651,121 +1272,175 @@ void CompilationEngine::writeEnclosedExpression(string open, string close)
  */
 void CompilationEngine::writeEnclosedStatements()
 {
-    writeSymbol("{");
-    jt.nextToken();
+    writeSymbol(S_LEFT_BRACE);
+    tc.advance();
     compileStatements();
-    writeSymbol("}");
+    writeSymbol(S_RIGHT_BRACE);
 }
 
 /*
- Writes an error message
+ Adds an error node to the tree, and records the message as a diagnostic.
  */
 void CompilationEngine::writeError(string errorMessage)
 {
-    string line = addIndentToLine();
-    line += "<error> ";
-    line += errorMessage;
-    line += " </error>";
+    tree.addTerminal(N_ERROR, errorMessage.c_str(), errorMessage.length());
+    errorCount++;
+    addDiagnostic(errorMessage);
     
-    XMLcode.push_back(line);
+    if (editText != NULL)
+    {
+        SyntaxError error;
+        
+        error.offset = (size_t) (tc.start() - editText);
+        error.length = (size_t) tc.length();
+        error.message = errorMessage;
+        syntaxErrors.push_back(error);
+    }
 }
 
-void CompilationEngine::startTag(string token)
+/*
+ Records a message for the caller to report, prefixed with the file name.
+ */
+void CompilationEngine::addDiagnostic(string message)
 {
-    string line = addIndentToLine();
-    indentLevel++;
-    
-    line += "<";
-    line += token;
-    line += ">";
-    
-    XMLcode.push_back(line);
+    diagnostics += (inFileName.empty() || inFileName == "-") ? "<stdin>" :
+                                                                inFileName;
+    diagnostics += ": ";
+    diagnostics += message;
+    diagnostics += "\n";
 }
 
-void CompilationEngine::endTag(string token)
+/*
+ Returns the messages recorded while compiling, one per line. The engine
+ never prints them itself, so that files compiled on different threads can be
+ reported in a fixed order.
+ */
+string CompilationEngine::getDiagnostics()
 {
-    indentLevel--;
-    string line = addIndentToLine();
+    return diagnostics;
+}
+
+/*
+ Returns the syntax errors found while parsing for an editor, in the order
+ they were found.
+ */
+const vector<SyntaxError> &CompilationEngine::getSyntaxErrors()
+{
+    return syntaxErrors;
+}
+
+/*
+ Returns the members of the class parsed for an editor, in order.
+ */
+const vector<ClassMember> &CompilationEngine::getMembers()
+{
+    return members;
+}
+
+/*
+ Returns the offset in the text parsed for an editor past which the parse
+ read nothing: the end of the current token, with room for the closing
+ quote of a string and the character that ended a word. The parse would be
+ the same if anything from there on were different.
+ */
+size_t CompilationEngine::getReadOffset()
+{
+    return (size_t) (tc.start() - editText) + tc.length() + 2;
+}
+
+/*
+ Returns how much of the text the parse for an editor read.
+ */
+size_t CompilationEngine::getReadLength()
+{
+    return readLength;
+}
+
+/*
+ Returns true if parsing for an editor stopped at one of the stops, before
+ the end of the class.
+ */
+bool CompilationEngine::reachedStop()
+{
+    return stopped;
+}
+
+/*
+ Returns the VM code of the class, which is only kept for a whole-program
+ build.
+ */
+VMCode &CompilationEngine::getVMCode()
+{
+    return vm;
+}
+
+/*
+ Returns how long each phase of compiling the file took, and what it used.
+ */
+const CompileStats &CompilationEngine::getStats()
+{
+    return stats;
+}
+
+const char *CompilationEngine::getPhaseName(int phase)
+{
+    static const char *names[] = { "tokenize", "parse", "output" };
     
-    line += "</";
-    line += token;
-    line += ">";
+    if (phase < 0 || phase >= PHASE_COUNT)
+        return "";
     
-    XMLcode.push_back(line);
+    return names[phase];
 }
 
-string CompilationEngine::addIndentToLine()
+/*
+ Returns the number of syntax errors found.
+ */
+int CompilationEngine::getErrorCount()
 {
-    string indent;
-    for (int i = 0; i < indentLevel; i++)
-    {
-        for (int j = 0; j < INDENT_SPACES; j++)
-        {
-            indent += " ";
-        }
-    }
-    return indent;
+    return errorCount;
 }
 
 bool CompilationEngine::isTokenKeyword()
 {
-    return (jt.tokenType() == T_KEYWORD);
+    return (tc.tokenType() == T_KEYWORD);
 }
 
 bool CompilationEngine::isTokenSymbol()
 {
-    return (jt.tokenType() == T_SYMBOL);
+    return (tc.tokenType() == T_SYMBOL);
 }
 
 bool CompilationEngine::isTokenIdentifier()
 {
-    return (jt.tokenType() == T_IDENTIFIER);
+    return (tc.tokenType() == T_IDENTIFIER);
 }
 
 bool CompilationEngine::isTokenIntConst()
 {
-    return (jt.tokenType() == T_INT_CONST);
+    return (tc.tokenType() == T_INT_CONST);
 }
 
 bool CompilationEngine::isTokenStringConst()
 {
-    return (jt.tokenType() == T_STRING_CONST);
-}
-
-bool CompilationEngine::isSubroutineCall()
-{
-    return (jt.getTokenInList(jt.getListIndex()) == "(" ||
-            jt.getTokenInList(jt.getListIndex()) == ".");
-}
-
-bool CompilationEngine::isArrayReference()
-{
-    return (jt.getTokenInList(jt.getListIndex()) == "[");
+    return (tc.tokenType() == T_STRING_CONST);
 }
 
 bool CompilationEngine::isValidStatementKeyword()
 {
-    return (jt.keyword() == K_LET || jt.keyword() == K_IF ||
-            jt.keyword() == K_WHILE || jt.keyword() == K_DO ||
-            jt.keyword() == K_RETURN);
+    return (tc.keyword() == K_LET || tc.keyword() == K_IF ||
+            tc.keyword() == K_WHILE || tc.keyword() == K_DO ||
+            tc.keyword() == K_RETURN);
 }
 
 bool CompilationEngine::isValidVarDecKeyword()
 {
-    return (jt.keyword() == K_FIELD || jt.keyword() == K_STATIC);
+    return (tc.keyword() == K_FIELD || tc.keyword() == K_STATIC);
 }
 
 bool CompilationEngine::isValidSubDecKeyword()
 {
-    return (jt.keyword() == K_CONSTRUCTOR || jt.keyword() == K_METHOD ||
-            jt.keyword() == K_FUNCTION || jt.keyword() == K_INT ||
-            jt.keyword() == K_CHAR || jt.keyword() == K_BOOLEAN ||
+    return (tc.keyword() == K_CONSTRUCTOR || tc.keyword() == K_METHOD ||
+            tc.keyword() == K_FUNCTION || tc.keyword() == K_INT ||
+            tc.keyword() == K_CHAR || tc.keyword() == K_BOOLEAN ||
             isTokenIdentifier());
 }
-
-bool CompilationEngine::isValidOpSymbol()
-{
-    return (jt.symbol() == "+" || jt.symbol() == "-" || jt.symbol() == "*" ||
-            jt.symbol() == "/" || jt.symbol() == "&" || jt.symbol() == "|" ||
-            jt.symbol() == "<" || jt.symbol() == ">" || jt.symbol() == "=");
-}
\ No newline at end of file
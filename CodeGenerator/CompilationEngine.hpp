@@ -16,28 +16,183 @@
 #define CompilationEngine_hpp
 
 #include <iostream>
-#include <fstream>
 #include "JackTokenizer.hpp"
+#include "SourceFile.hpp"
+#include "SyntaxTree.hpp"
+#include "XMLWriter.hpp"
+#include "VMCode.hpp"
+#include "VMPeephole.hpp"
+#include "BuildCache.hpp"
+#include "TokenCache.hpp"
+#include "RingBuffer.hpp"
 
 using std::string;
-using std::ifstream;
-using std::ofstream;
 using std::cout;
 using std::endl;
 
+/*
+ The formats a class can be compiled to: the parse tree as XML, Hack VM
+ code, or the parse tree in the binary format TreeReader reads.
+ */
+enum OutputFormat
+{
+    FORMAT_XML = 0, FORMAT_VM, FORMAT_TREE
+};
+
+/*
+ Settings that apply to every file in a build. optimize turns on the
+ expression optimizations and the peephole pass of the VM back end.
+ wholeProgram keeps each class's VM code in the engine, for the caller to
+ optimize the program as a whole and write it out. inlineLimit is the
+ longest subroutine, in instructions, whose calls the whole-program pass
+ replaces with its body; 0 turns inlining off. precedence parses binary
+ operators with the usual precedence of C instead of strictly left to right
+ as Jack does. pipeline tokenizes, parses and writes each file at the same
+ time on three threads, and streaming compiles it on one thread holding
+ only a little of it at a time, so that memory does not grow with its size;
+ neither applies when tokens come from a token cache. tokenCache, if not
+ NULL, saves each file's tokens so an unchanged file is not tokenized
+ again. nameTable, if not NULL, numbers the names of every file in the
+ build as they are tokenized.
+ */
+struct CompileOptions
+{
+    int format;
+    bool optimize;
+    bool wholeProgram;
+    int inlineLimit;
+    bool precedence;
+    bool pipeline;
+    bool streaming;
+    TokenCache *tokenCache;
+    NameTable *nameTable;
+
+    CompileOptions() : format(FORMAT_XML), optimize(false),
+                       wholeProgram(false), inlineLimit(0),
+                       precedence(false), pipeline(false), streaming(false),
+                       tokenCache(NULL), nameTable(NULL) {}
+};
+
+/*
+ The phases of compiling a file: buildTokenList(), compileClass(), and
+ writing the XML or VM file.
+ */
+enum CompilePhase
+{
+    PHASE_TOKENIZE = 0, PHASE_PARSE, PHASE_OUTPUT, PHASE_COUNT
+};
+
+/*
+ What compiling one file took: the seconds and heap allocations of each
+ phase, the bytes read and written, the memory the parse tree took, and the
+ number of tokens of each TokenType. A file restored from the build cache
+ records only that it was, and its size. tokensCached is set when the tokens
+ were loaded from the token cache rather than scanned. peepholeHits counts
+ the rewrites of each PeepholeRule made in its VM code.
+ */
+struct CompileStats
+{
+    bool cached;
+    bool tokensCached;
+    double seconds[PHASE_COUNT];
+    unsigned long long allocations[PHASE_COUNT];
+    unsigned long long allocatedBytes[PHASE_COUNT];
+    size_t sourceBytes;
+    size_t outputBytes;
+    size_t treeBytes;
+    int tokenCount;
+    int tokenTypeCounts[T_STRING_CONST + 1];
+    int peepholeHits[PEEPHOLE_RULE_COUNT];
+
+    CompileStats() : cached(false), tokensCached(false), seconds(), allocations(),
+                     allocatedBytes(), sourceBytes(0), outputBytes(0),
+                     treeBytes(0), tokenCount(0), tokenTypeCounts(),
+                     peepholeHits() {}
+};
+
+/*
+ A syntax error found while parsing for an editor: the offset and length in
+ the text of the token the parser had reached, and the message.
+ */
+struct SyntaxError
+{
+    size_t offset;
+    size_t length;
+    string message;
+};
+
+/*
+ Where a member of a class was found while parsing for an editor. kind is
+ N_CLASS_VAR_DEC or N_SUBROUTINE_DEC, start is the offset of its first token
+ and end that of the token after it, and readEnd is how far into the text
+ its parse read. Its errors are the errorCount syntax errors from
+ firstError on.
+ */
+struct ClassMember
+{
+    int kind;
+    size_t start;
+    size_t end;
+    size_t readEnd;
+    int firstError;
+    int errorCount;
+};
+
 class CompilationEngine
 {
 private:
-    int const INDENT_SPACES = 2;
-    int indentLevel;
+    // Batches of tokens and pieces of the class in flight when a class is
+    // compiled in parts, and the number of nodes that makes a piece worth
+    // sending
+    static const unsigned int TOKEN_QUEUE_SIZE = 16;
+    static const unsigned int PIECE_QUEUE_SIZE = 16;
+    static const int PIECE_NODES = 16384;
+    
+    SourceFile source;
+    SourceFile tokenFile;
     JackTokenizer jt;
-    vector<string> XMLcode;
+    TokenCursor tc;
+    SyntaxTree tree;
+    XMLWriter xml;
+    VMCode vm;
+    CompileOptions options;
+    CompileStats stats;
     string inFileName;
+    string outFileName;
+    BuildCache *cache;
+    string diagnostics;
+    int errorCount;
+    const unsigned char *precedences;
+    RingBuffer<SyntaxTree *> *pieces;
+    bool writingParts;
+    const char *editText;
+    vector<SyntaxError> syntaxErrors;
+    vector<ClassMember> members;
+    const vector<size_t> *memberStops;
+    bool stopped;
+    size_t readLength;
     
 private:
+    void compileInParts();
+    void sendPiece(bool classEnded);
+    void takePiece(SyntaxTree &piece, bool classEnded);
+    bool writePieces(RingBuffer<SyntaxTree *> &members);
+    void writePiece(SyntaxTree &piece);
+    void startPhase(int phase);
+    void endPhase(int phase);
+    bool restoreFromCache();
     void buildTokenList();
+    void setOutFileName();
+    void writeOutput();
+    void openXMLFile();
     void writeXMLFile();
+    void writeVMFile();
+    void writeTreeFile();
     void compileClass();
+    void compileMembers(bool varDecs);
+    void beginMember();
+    void endMember(int kind);
+    size_t getReadOffset();
     void compileClassVarDec();
     void compileSubroutine();
     void compileParameterList();
@@ -50,37 +205,52 @@ private:
     void compileReturn();
     void compileIf();
     void compileExpression();
+    void compileOperators(int mark, int minPrecedence);
     void compileTerm();
     void compileExpressionList();
     void writeKeyword(string token, int keywordType);
     void writeIdentifier();
-    void writeSymbol(string token);
+    void writeName(int kind);
+    void writeSymbol(int symbol);
     void writeIntVal();
     void writeStringVal();
     void writeType();
     void writeVarDec();
     void writeSubroutineCall();
-    void writeEnclosedExpression(string open, string close);
+    void writeEnclosedExpression(int open, int close);
     void writeEnclosedStatements();
     void writeError(string errorMessage);
-    void startTag(string token);
-    void endTag(string token);
-    void tagTerminal(string token);
-    string addIndentToLine();
+    void addDiagnostic(string message);
     bool isTokenKeyword();
     bool isTokenSymbol();
     bool isTokenIdentifier();
     bool isTokenIntConst();
     bool isTokenStringConst();
-    bool isSubroutineCall();
-    bool isArrayReference();
     bool isValidStatementKeyword();
     bool isValidVarDecKeyword();
     bool isValidSubDecKeyword();
-    bool isValidOpSymbol();
     
 public:
     CompilationEngine(string inFileName);
+    CompilationEngine(string inFileName, BuildCache *cache);
+    CompilationEngine(string inFileName, BuildCache *cache,
+                      const CompileOptions &options);
+    CompilationEngine(const char *begin, const char *end, int rule,
+                      const vector<size_t> *stops,
+                      const CompileOptions &options);
+    string getDiagnostics();
+    const vector<SyntaxError> &getSyntaxErrors();
+    const vector<ClassMember> &getMembers();
+    size_t getReadLength();
+    bool reachedStop();
+    VMCode &getVMCode();
+    const CompileStats &getStats();
+    static const char *getPhaseName(int phase);
+    static string getOutFileName(string inFileName);
+    static string getOutFileName(string inFileName,
+                                 const CompileOptions &options);
+    static string getOptionsKey(const CompileOptions &options);
+    int getErrorCount();
 };
 
 #endif /* CompilationEngine_hpp */
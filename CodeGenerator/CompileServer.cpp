@@ -0,0 +1,446 @@
+/*
+ CompileServer.cpp
+ CodeGenerator
+
+ Keeps the compiler running between builds. The server remembers the
+ contents hash, output and diagnostics of every file it has compiled, so a
+ file that has not changed since the last request costs one read and one
+ hash, and only changed files are compiled again.
+
+ Requests arrive on a local Unix socket as one path per line, ended by an
+ empty line. The reply is the diagnostics for those files followed by a
+ final line "status N", where N is the number of files with errors. In watch
+ mode the server instead recompiles .jack files as soon as they are saved.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "CompileServer.hpp"
+#include "CompilationEngine.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+/*
+ Starts the worker threads that requests are compiled on. Every file is
+ compiled with the same options.
+ */
+CompileServer::CompileServer(int threadCount, BuildCache *cache,
+                             const CompileOptions &options)
+    : pool(threadCount)
+{
+    this->cache = cache;
+    this->options = options;
+}
+
+/*
+ Brings one file's output up to date. If the file's contents hash matches the
+ last compile, the remembered output is only written back if the output file
+ has gone missing or no longer holds it. Output is only remembered from a
+ compile without errors, as the cache keeps it, so a failed compile that
+ wrote nothing never brings back the output of an older one. Returns false
+ if the file had errors.
+ */
+bool CompileServer::compileFile(string fileName,
+                                const CompileOptions &batchOptions,
+                                string &diagnostics)
+{
+    SourceFile source;
+    string outFileName = CompilationEngine::getOutFileName(fileName, options);
+    unsigned long long key;
+    std::map<string, Entry>::iterator it;
+
+    if (!source.open(fileName))
+    {
+        diagnostics = fileName + ": cannot open file\n";
+        return false;
+    }
+    key = BuildCache::hash(source.begin(), source.size(), 0);
+    source.close();
+
+    {
+        std::lock_guard<std::mutex> guard(entriesLock);
+
+        it = entries.find(fileName);
+        if (it != entries.end() && it->second.key == key)
+        {
+            diagnostics = it->second.diagnostics;
+
+            if (it->second.hasOutput &&
+                !hasContents(outFileName, it->second.output))
+            {
+                OutputFile out;
+                out.open(outFileName);
+                out.writeRaw(it->second.output.data(),
+                             it->second.output.size());
+                out.close();
+            }
+            return diagnostics.empty();
+        }
+    }
+
+    CompilationEngine ce(fileName, cache, batchOptions);
+    Entry entry;
+
+    entry.key = key;
+    entry.diagnostics = ce.getDiagnostics();
+    entry.hasOutput = entry.diagnostics.empty() && source.open(outFileName);
+    if (entry.hasOutput)
+        entry.output.assign(source.begin(), source.size());
+    diagnostics = entry.diagnostics;
+
+    {
+        std::lock_guard<std::mutex> guard(entriesLock);
+        entries[fileName] = entry;
+    }
+
+    return diagnostics.empty();
+}
+
+/*
+ Returns true if a file exists and holds exactly the given text.
+ */
+bool CompileServer::hasContents(const string &fileName, const string &text)
+{
+    SourceFile file;
+
+    return file.open(fileName) && file.size() == text.size() &&
+           std::equal(text.begin(), text.end(), file.begin());
+}
+
+/*
+ Compiles a batch of files on the worker threads. The diagnostics are added
+ to the report in the order the files were given. Each batch numbers its
+ names in a NameTable of its own, so a long-running server does not keep
+ the names of every version of every file. Returns the number of files that
+ had errors.
+ */
+int CompileServer::compile(vector<string> &files, string &report)
+{
+    vector<string> diagnostics(files.size());
+    vector<int> errors(files.size(), 0);
+    NameTable names;
+    CompileOptions batchOptions = options;
+    int failed = 0;
+
+    batchOptions.nameTable = &names;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        pool.submit([this, i, &files, &batchOptions, &diagnostics, &errors]
+        {
+            errors[i] = !compileFile(files[i], batchOptions, diagnostics[i]);
+        });
+    }
+    pool.wait();
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        report += diagnostics[i];
+        failed += errors[i];
+    }
+
+    return failed;
+}
+
+/*
+ Reads one line from a socket, without the newline. Bytes read past the line
+ are kept in pending for the next call. Returns false at end of input.
+ */
+bool CompileServer::readLine(int fd, string &line, string &pending)
+{
+    char buffer[4096];
+    size_t newline;
+    ssize_t count;
+
+    while ((newline = pending.find('\n')) == string::npos)
+    {
+        count = read(fd, buffer, sizeof(buffer));
+        if (count <= 0)
+        {
+            line = pending;
+            pending.clear();
+            return !line.empty();
+        }
+        pending.append(buffer, count);
+    }
+
+    line = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+    return true;
+}
+
+/*
+ Writes all of a string to a socket.
+ */
+bool CompileServer::writeAll(int fd, const string &text)
+{
+    size_t done = 0;
+    ssize_t count;
+
+    while (done < text.length())
+    {
+        count = write(fd, text.data() + done, text.length() - done);
+        if (count <= 0)
+            return false;
+        done += (size_t) count;
+    }
+    return true;
+}
+
+/*
+ Answers one request: reads the paths, compiles them and replies with their
+ diagnostics and the status line.
+ */
+void CompileServer::handleClient(int fd)
+{
+    vector<string> files;
+    string pending;
+    string line;
+    string report;
+    int failed;
+
+    while (readLine(fd, line, pending) && !line.empty())
+        files.push_back(line);
+
+    failed = compile(files, report);
+    report += "status " + std::to_string(failed) + "\n";
+    writeAll(fd, report);
+}
+
+/*
+ Listens for requests on a Unix socket until the process is stopped. A stale
+ socket left by an earlier server is replaced.
+ */
+int CompileServer::serve(string socketName)
+{
+    struct sockaddr_un address;
+    int listener;
+    int client;
+
+    if (socketName.length() >= sizeof(address.sun_path))
+    {
+        std::cerr << socketName << ": socket path too long" << std::endl;
+        return 1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketName.c_str());
+
+    signal(SIGPIPE, SIG_IGN);
+    unlink(socketName.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listener, 16) != 0)
+    {
+        std::cerr << socketName << ": cannot listen on socket" << std::endl;
+        return 1;
+    }
+
+    for (;;)
+    {
+        client = accept(listener, NULL, NULL);
+        if (client < 0)
+            continue;
+
+        handleClient(client);
+        close(client);
+    }
+}
+
+/*
+ Compiles the files, then recompiles any .jack file in their directories each
+ time one is saved, until the process is stopped. On Linux saves are
+ reported by inotify; elsewhere the files' modification times are polled.
+ */
+int CompileServer::watch(vector<string> &files)
+{
+    vector<string> directories;
+    string report;
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        size_t slash = files[i].find_last_of('/');
+        string directory = (slash == string::npos) ? "." :
+                                                     files[i].substr(0, slash);
+
+        if (std::find(directories.begin(), directories.end(), directory) ==
+            directories.end())
+        {
+            directories.push_back(directory);
+        }
+    }
+
+    compile(files, report);
+    std::cerr << report;
+    std::cout << "watching " << files.size() << " files" << std::endl;
+
+#ifdef __linux__
+    char buffer[16 * 1024] __attribute__((aligned(8)));
+    vector<int> watches;
+    struct pollfd pending;
+    int fd = inotify_init();
+
+    if (fd < 0)
+    {
+        std::cerr << "cannot watch files: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    for (size_t i = 0; i < directories.size(); i++)
+    {
+        watches.push_back(inotify_add_watch(fd, directories[i].c_str(),
+                                            IN_CLOSE_WRITE | IN_MOVED_TO));
+        if (watches.back() < 0)
+        {
+            std::cerr << directories[i] << ": cannot watch directory: "
+                      << strerror(errno) << std::endl;
+        }
+    }
+    if (std::count(watches.begin(), watches.end(), -1) ==
+        (ptrdiff_t) watches.size())
+    {
+        return 1;
+    }
+
+    for (;;)
+    {
+        vector<string> changed;
+        ssize_t count;
+
+        // Editors often save in several steps, so gather events until the
+        // directory has been quiet for a moment
+        pending.fd = fd;
+        pending.events = POLLIN;
+        do
+        {
+            count = read(fd, buffer, sizeof(buffer));
+            for (char *p = buffer; count > 0 && p < buffer + count; )
+            {
+                struct inotify_event *event = (struct inotify_event *) p;
+                string name = (event->len > 0) ? event->name : "";
+
+                if (name.length() > 5 &&
+                    name.compare(name.length() - 5, 5, ".jack") == 0)
+                {
+                    for (size_t i = 0; i < watches.size(); i++)
+                    {
+                        if (watches[i] == event->wd)
+                            changed.push_back(directories[i] + "/" + name);
+                    }
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        } while (poll(&pending, 1, 20) > 0);
+
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()),
+                      changed.end());
+        if (changed.empty())
+            continue;
+
+        report.clear();
+        int failed = compile(changed, report);
+        std::cerr << report;
+        std::cout << "compiled " << changed.size() << " files, " << failed
+                  << " with errors" << std::endl;
+    }
+#else
+    vector<time_t> modified(files.size(), 0);
+    struct stat info;
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (stat(files[i].c_str(), &info) == 0)
+            modified[i] = info.st_mtime;
+    }
+
+    for (;;)
+    {
+        vector<string> changed;
+
+        usleep(250 * 1000);
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (stat(files[i].c_str(), &info) == 0 &&
+                info.st_mtime != modified[i])
+            {
+                modified[i] = info.st_mtime;
+                changed.push_back(files[i]);
+            }
+        }
+        if (changed.empty())
+            continue;
+
+        report.clear();
+        int failed = compile(changed, report);
+        std::cerr << report;
+        std::cout << "compiled " << changed.size() << " files, " << failed
+                  << " with errors" << std::endl;
+    }
+#endif
+}
+
+/*
+ Client side: asks the server listening on a socket to compile the files and
+ prints its diagnostics. Paths are sent in absolute form, since the server
+ may be running in another directory. Returns the process exit status.
+ */
+int CompileServer::request(string socketName, vector<string> &files)
+{
+    struct sockaddr_un address;
+    char resolved[PATH_MAX];
+    string message;
+    string pending;
+    string line;
+    int failed = -1;
+    int fd;
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        message += (realpath(files[i].c_str(), resolved) != NULL) ? resolved :
+                                                                    files[i];
+        message += "\n";
+    }
+    message += "\n";
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketName.c_str(), sizeof(address.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 ||
+        connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0)
+    {
+        std::cerr << socketName << ": no server is listening" << std::endl;
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    writeAll(fd, message);
+    while (readLine(fd, line, pending))
+    {
+        if (line.compare(0, 7, "status ") == 0)
+            failed = atoi(line.c_str() + 7);
+        else
+            std::cerr << line << std::endl;
+    }
+    close(fd);
+
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+/*
+ CompileServer.hpp
+ CodeGenerator
+
+ Keeps the compiler running between builds. The server remembers the
+ contents hash, output and diagnostics of every file it has compiled, so a
+ file that has not changed since the last request costs one read and one
+ hash, and only changed files are compiled again.
+
+ Requests arrive on a local Unix socket as one path per line, ended by an
+ empty line. The reply is the diagnostics for those files followed by a
+ final line "status N", where N is the number of files with errors. In watch
+ mode the server instead recompiles .jack files as soon as they are saved.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef CompileServer_hpp
+#define CompileServer_hpp
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "BuildCache.hpp"
+#include "CompilationEngine.hpp"
+#include "ThreadPool.hpp"
+
+using std::string;
+using std::vector;
+
+class CompileServer
+{
+private:
+    /*
+     What the last compile of a file left: its contents hash, its
+     diagnostics and, if it compiled without errors, the output it wrote.
+     */
+    struct Entry
+    {
+        unsigned long long key;
+        bool hasOutput;
+        string output;
+        string diagnostics;
+    };
+
+    std::map<string, Entry> entries;
+    std::mutex entriesLock;
+    ThreadPool pool;
+    BuildCache *cache;
+    CompileOptions options;
+
+private:
+    bool compileFile(string fileName, const CompileOptions &batchOptions,
+                     string &diagnostics);
+    void handleClient(int fd);
+    static bool readLine(int fd, string &line, string &pending);
+    static bool writeAll(int fd, const string &text);
+    static bool hasContents(const string &fileName, const string &text);
+
+public:
+    CompileServer(int threadCount, BuildCache *cache,
+                  const CompileOptions &options);
+    int compile(vector<string> &files, string &report);
+    int serve(string socketName);
+    int watch(vector<string> &directories);
+    static int request(string socketName, vector<string> &files);
+};
+
+#endif /* CompileServer_hpp */
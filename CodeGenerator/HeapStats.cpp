@@ -0,0 +1,126 @@
+/*
+ HeapStats.cpp
+ CodeGenerator
+
+ Counts the heap allocations each thread makes, so that a phase of the
+ compiler can tell how many it made by reading the count before and after.
+ Every operator new in the program is counted, and so is each block the
+ Arena takes from malloc. Files are compiled one per thread at a time, so
+ a thread's count is also the count for the file it is compiling.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "HeapStats.hpp"
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+
+static thread_local HeapCount threadCount = { 0, 0 };
+
+void HeapStats::recordAllocation(size_t size)
+{
+    threadCount.allocations++;
+    threadCount.bytes += size;
+}
+
+/*
+ Returns the allocations the calling thread has made so far.
+ */
+HeapCount HeapStats::getThreadCount()
+{
+    return threadCount;
+}
+
+/*
+ Returns the most memory the process has had resident at once.
+ */
+size_t HeapStats::getPeakResidentBytes()
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#if defined(__APPLE__)
+    return (size_t) usage.ru_maxrss;
+#else
+    return (size_t) usage.ru_maxrss * 1024;
+#endif
+}
+
+/*
+ The replacement allocation functions, which count each allocation and
+ otherwise behave as the standard ones do. The sized forms of delete, which
+ C++14 calls where it knows the size, free the block as the others do. The
+ forms for over-aligned types are left to the library: nothing in the
+ compiler is over-aligned, and the library's aligned new and delete only
+ ever free the blocks they allocated themselves.
+ */
+static void *allocate(size_t size)
+{
+    void *block;
+
+    HeapStats::recordAllocation(size);
+    while ((block = malloc(size != 0 ? size : 1)) == NULL)
+    {
+        std::new_handler handler = std::get_new_handler();
+
+        if (handler == NULL)
+            throw std::bad_alloc();
+        handler();
+    }
+    return block;
+}
+
+void *operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    HeapStats::recordAllocation(size);
+    return malloc(size != 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    HeapStats::recordAllocation(size);
+    return malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void *block) noexcept
+{
+    free(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+    free(block);
+}
+
+void operator delete(void *block, const std::nothrow_t &) noexcept
+{
+    free(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept
+{
+    free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    operator delete(block);
+}
+
+void operator delete[](void *block, size_t) noexcept
+{
+    operator delete[](block);
+}
@@ -0,0 +1,36 @@
+/*
+ HeapStats.hpp
+ CodeGenerator
+
+ Counts the heap allocations each thread makes, so that a phase of the
+ compiler can tell how many it made by reading the count before and after.
+ Every operator new in the program is counted, and so is each block the
+ Arena takes from malloc. Files are compiled one per thread at a time, so
+ a thread's count is also the count for the file it is compiling.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef HeapStats_hpp
+#define HeapStats_hpp
+
+#include <cstddef>
+
+/*
+ A running total of allocations and the bytes they asked for.
+ */
+struct HeapCount
+{
+    unsigned long long allocations;
+    unsigned long long bytes;
+};
+
+class HeapStats
+{
+public:
+    static void recordAllocation(size_t size);
+    static HeapCount getThreadCount();
+    static size_t getPeakResidentBytes();
+};
+
+#endif /* HeapStats_hpp */
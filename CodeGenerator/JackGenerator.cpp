@@ -0,0 +1,252 @@
+/*
+ JackGenerator.cpp
+ CodeGenerator
+
+ Writes synthetic Jack classes of any requested size, for benchmarking the
+ compiler on inputs far larger than real programs. The classes are valid
+ Jack that also compiles to VM code: every variable is declared and every
+ call names a subroutine that exists. The same seed always gives the same
+ text, so timings taken at different times compare like with like.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "JackGenerator.hpp"
+
+/*
+ The variables every generated subroutine can use: its two parameters, its
+ locals and the class's static.
+ */
+static const char *variables[] =
+{
+    "x", "y", "i", "j", "k", "count"
+};
+
+static const char *operators[] =
+{
+    " + ", " - ", " * ", " / ", " & ", " | ", " < ", " > ", " = "
+};
+
+static const char *words[] =
+{
+    "alpha", "beta", "gamma", "delta", "Score: ", "Game Over", "x = "
+};
+
+JackGenerator::JackGenerator(unsigned int seed)
+{
+    state = seed * 2654435761ULL + 1;
+    subroutineCount = 0;
+}
+
+/*
+ Returns a pseudo-random number below range. A fixed xorshift generator is
+ used rather than rand() so the text is the same on every platform.
+ */
+int JackGenerator::next(int range)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (int) (state % (unsigned long long) range);
+}
+
+void JackGenerator::indent(int depth)
+{
+    text.append(4 * (depth + 2), ' ');
+}
+
+/*
+ Returns a class of at least size bytes: a static, and then functions until
+ the text is long enough.
+ */
+string JackGenerator::generate(string className, size_t size)
+{
+    this->className = className;
+    text.clear();
+    text.reserve(size + 4096);
+    subroutineCount = 0;
+
+    text += "// Generated for benchmarking\n";
+    text += "class " + className + " {\n";
+    text += "    static int count;\n\n";
+    while (text.length() < size)
+        generateSubroutine();
+    text += "}\n";
+
+    return text;
+}
+
+/*
+ function int fN(int x, int y) { varDec* statements return expression; }
+ */
+void JackGenerator::generateSubroutine()
+{
+    text += "    function int f" + std::to_string(subroutineCount) +
+            "(int x, int y) {\n";
+    text += "        var int i, j, k;\n";
+    text += "        var Array a;\n";
+    text += "        var String s;\n";
+    text += "        let a = Array.new(8);\n";
+    generateStatements(0, 3 + next(6));
+    indent(0);
+    text += "return ";
+    generateExpression(0);
+    text += ";\n";
+    text += "    }\n\n";
+    subroutineCount++;
+}
+
+void JackGenerator::generateStatements(int depth, int count)
+{
+    for (int i = 0; i < count; i++)
+        generateStatement(depth);
+}
+
+/*
+ One let, if, while or do statement, with nested statements up to
+ MAX_DEPTH deep.
+ */
+void JackGenerator::generateStatement(int depth)
+{
+    int kind = next(depth < MAX_DEPTH ? 8 : 5);
+
+    indent(depth);
+    switch (kind)
+    {
+        case 0:
+        case 1:
+            text += "let ";
+            generateVariable();
+            text += " = ";
+            generateExpression(0);
+            text += ";\n";
+            break;
+
+        case 2:
+            text += "let a[";
+            generateVariable();
+            text += " & 7] = ";
+            generateExpression(0);
+            text += ";\n";
+            break;
+
+        case 3:
+            text += "let s = \"";
+            text += words[next(sizeof(words) / sizeof(words[0]))];
+            text += "\";\n";
+            break;
+
+        case 4:
+            text += "do Output.printInt(";
+            generateExpression(0);
+            text += ");\n";
+            break;
+
+        case 5:
+        case 6:
+            text += "if (";
+            generateExpression(0);
+            text += ") {\n";
+            generateStatements(depth + 1, 1 + next(3));
+            indent(depth);
+            if (next(2) == 0)
+            {
+                text += "}\n";
+                break;
+            }
+            text += "} else {\n";
+            generateStatements(depth + 1, 1 + next(3));
+            indent(depth);
+            text += "}\n";
+            break;
+
+        default:
+            text += "while (";
+            generateExpression(0);
+            text += ") {\n";
+            generateStatements(depth + 1, 1 + next(3));
+            indent(depth);
+            text += "}\n";
+            break;
+    }
+}
+
+/*
+ term (op term)*, with up to two operators.
+ */
+void JackGenerator::generateExpression(int depth)
+{
+    int operatorCount = next(3);
+
+    generateTerm(depth);
+    for (int i = 0; i < operatorCount; i++)
+    {
+        text += operators[next(sizeof(operators) / sizeof(operators[0]))];
+        generateTerm(depth);
+    }
+}
+
+/*
+ A constant, variable, array element, call, unary term or parenthesized
+ expression. Terms that nest expressions stop at MAX_DEPTH.
+ */
+void JackGenerator::generateTerm(int depth)
+{
+    int kind = next(depth < MAX_DEPTH ? 9 : 4);
+
+    switch (kind)
+    {
+        case 0:
+        case 1:
+            text += std::to_string(next(1000));
+            break;
+
+        case 2:
+        case 3:
+            generateVariable();
+            break;
+
+        case 4:
+            text += (next(2) == 0) ? "-" : "~";
+            generateTerm(depth + 1);
+            break;
+
+        case 5:
+            text += "a[";
+            generateExpression(depth + 1);
+            text += "]";
+            break;
+
+        case 6:
+            text += "(";
+            generateExpression(depth + 1);
+            text += ")";
+            break;
+
+        case 7:
+            // Only functions already written can be called
+            if (subroutineCount == 0)
+            {
+                text += "s.length()";
+                break;
+            }
+            text += className + ".f" +
+                    std::to_string(next(subroutineCount)) + "(";
+            generateExpression(depth + 1);
+            text += ", ";
+            generateExpression(depth + 1);
+            text += ")";
+            break;
+
+        default:
+            text += "Math.abs(";
+            generateExpression(depth + 1);
+            text += ")";
+            break;
+    }
+}
+
+void JackGenerator::generateVariable()
+{
+    text += variables[next(sizeof(variables) / sizeof(variables[0]))];
+}
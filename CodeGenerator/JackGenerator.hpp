@@ -0,0 +1,46 @@
+/*
+ JackGenerator.hpp
+ CodeGenerator
+
+ Writes synthetic Jack classes of any requested size, for benchmarking the
+ compiler on inputs far larger than real programs. The classes are valid
+ Jack that also compiles to VM code: every variable is declared and every
+ call names a subroutine that exists. The same seed always gives the same
+ text, so timings taken at different times compare like with like.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef JackGenerator_hpp
+#define JackGenerator_hpp
+
+#include <iostream>
+
+using std::string;
+
+class JackGenerator
+{
+private:
+    unsigned long long state;
+    string className;
+    string text;
+    int subroutineCount;
+
+    static const int MAX_DEPTH = 3;
+
+private:
+    int next(int range);
+    void indent(int depth);
+    void generateSubroutine();
+    void generateStatements(int depth, int count);
+    void generateStatement(int depth);
+    void generateExpression(int depth);
+    void generateTerm(int depth);
+    void generateVariable();
+
+public:
+    JackGenerator(unsigned int seed);
+    string generate(string className, size_t size);
+};
+
+#endif /* JackGenerator_hpp */
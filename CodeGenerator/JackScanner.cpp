@@ -0,0 +1,389 @@
+/*
+ JackScanner.cpp
+ CodeGenerator
+
+ Finds the ends of the long character runs in Jack source (identifiers, white
+ space, string constants and comments) for the JackTokenizer. On x86-64 the
+ runs are scanned 16 or 32 bytes at a time with SSE4.2 or AVX2, whichever the
+ CPU supports, and everywhere else one byte at a time. Every engine returns
+ exactly the same positions.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "JackScanner.hpp"
+#include <cstddef>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define JACK_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+constexpr unsigned char JackScanner::charClass[256];
+
+/*
+ Scalar engine. Also finishes the last few bytes of input for the vector
+ engines, which never read past the end of the buffer.
+ */
+static const char *scalarWordEnd(const char *p, const char *end)
+{
+    while (p < end && (JackScanner::charClass[(unsigned char) *p] & CC_WORD))
+        p++;
+    return p;
+}
+
+static const char *scalarSpaceEnd(const char *p, const char *end)
+{
+    while (p < end && (JackScanner::charClass[(unsigned char) *p] & CC_SPACE))
+        p++;
+    return p;
+}
+
+static const char *scalarLineEnd(const char *p, const char *end)
+{
+    while (p < end && *p != '\n')
+        p++;
+    return p;
+}
+
+static const char *scalarStringEnd(const char *p, const char *end)
+{
+    while (p < end && *p != '\"' && *p != '\n')
+        p++;
+    return p;
+}
+
+static const char *scalarCommentEnd(const char *p, const char *end)
+{
+    while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+        p++;
+    return (p + 1 < end) ? p : end;
+}
+
+#ifdef JACK_SCANNER_X86
+
+/*
+ SSE4.2 engine. The string compare instructions match a 16 byte block against
+ a set of byte ranges or characters, or search it for a substring, and return
+ the index of the first hit (16 if there is none).
+ */
+#define SSE42_FLAGS (_SIDD_UBYTE_OPS | _SIDD_LEAST_SIGNIFICANT)
+
+__attribute__((target("sse4.2")))
+static const char *sse42WordEnd(const char *p, const char *end)
+{
+    const __m128i ranges = _mm_setr_epi8('a', 'z', 'A', 'Z', '0', '9', '_', '_',
+                                         0, 0, 0, 0, 0, 0, 0, 0);
+    int index;
+
+    while (end - p >= 16)
+    {
+        index = _mm_cmpestri(ranges, 8, _mm_loadu_si128((const __m128i *) p),
+                             16, SSE42_FLAGS | _SIDD_CMP_RANGES |
+                             _SIDD_NEGATIVE_POLARITY);
+        if (index < 16)
+            return p + index;
+        p += 16;
+    }
+    return scalarWordEnd(p, end);
+}
+
+__attribute__((target("sse4.2")))
+static const char *sse42SpaceEnd(const char *p, const char *end)
+{
+    const __m128i ranges = _mm_setr_epi8('\t', '\r', ' ', ' ', 0, 0, 0, 0,
+                                         0, 0, 0, 0, 0, 0, 0, 0);
+    int index;
+
+    while (end - p >= 16)
+    {
+        index = _mm_cmpestri(ranges, 4, _mm_loadu_si128((const __m128i *) p),
+                             16, SSE42_FLAGS | _SIDD_CMP_RANGES |
+                             _SIDD_NEGATIVE_POLARITY);
+        if (index < 16)
+            return p + index;
+        p += 16;
+    }
+    return scalarSpaceEnd(p, end);
+}
+
+__attribute__((target("sse4.2")))
+static const char *sse42LineEnd(const char *p, const char *end)
+{
+    const __m128i set = _mm_setr_epi8('\n', 0, 0, 0, 0, 0, 0, 0,
+                                      0, 0, 0, 0, 0, 0, 0, 0);
+    int index;
+
+    while (end - p >= 16)
+    {
+        index = _mm_cmpestri(set, 1, _mm_loadu_si128((const __m128i *) p),
+                             16, SSE42_FLAGS | _SIDD_CMP_EQUAL_ANY);
+        if (index < 16)
+            return p + index;
+        p += 16;
+    }
+    return scalarLineEnd(p, end);
+}
+
+__attribute__((target("sse4.2")))
+static const char *sse42StringEnd(const char *p, const char *end)
+{
+    const __m128i set = _mm_setr_epi8('\"', '\n', 0, 0, 0, 0, 0, 0,
+                                      0, 0, 0, 0, 0, 0, 0, 0);
+    int index;
+
+    while (end - p >= 16)
+    {
+        index = _mm_cmpestri(set, 2, _mm_loadu_si128((const __m128i *) p),
+                             16, SSE42_FLAGS | _SIDD_CMP_EQUAL_ANY);
+        if (index < 16)
+            return p + index;
+        p += 16;
+    }
+    return scalarStringEnd(p, end);
+}
+
+/*
+ An ordered compare also reports a '*' in the last byte of the block as a
+ partial match, so that one position is confirmed by hand.
+ */
+__attribute__((target("sse4.2")))
+static const char *sse42CommentEnd(const char *p, const char *end)
+{
+    const __m128i needle = _mm_setr_epi8('*', '/', 0, 0, 0, 0, 0, 0,
+                                         0, 0, 0, 0, 0, 0, 0, 0);
+    int index;
+
+    while (end - p >= 17)
+    {
+        index = _mm_cmpestri(needle, 2, _mm_loadu_si128((const __m128i *) p),
+                             16, SSE42_FLAGS | _SIDD_CMP_EQUAL_ORDERED);
+        if (index < 15 || (index == 15 && p[16] == '/'))
+            return p + index;
+        p += 16;
+    }
+    return scalarCommentEnd(p, end);
+}
+
+/*
+ AVX2 engine. Each class test is a few byte compares over a 32 byte block,
+ reduced to a bit mask whose lowest set bit is the first hit. The compares are
+ signed, so bytes outside 7-bit ASCII never fall in a range.
+ */
+__attribute__((target("avx2")))
+static const char *avx2WordEnd(const char *p, const char *end)
+{
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i belowA = _mm256_set1_epi8('a' - 1);
+    const __m256i aboveZ = _mm256_set1_epi8('z' + 1);
+    const __m256i below0 = _mm256_set1_epi8('0' - 1);
+    const __m256i above9 = _mm256_set1_epi8('9' + 1);
+    const __m256i underscore = _mm256_set1_epi8('_');
+    __m256i block, lower, letter, digit;
+    unsigned int mask;
+
+    while (end - p >= 32)
+    {
+        block = _mm256_loadu_si256((const __m256i *) p);
+        lower = _mm256_or_si256(block, caseBit);
+        letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, belowA),
+                                  _mm256_cmpgt_epi8(aboveZ, lower));
+        digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, below0),
+                                 _mm256_cmpgt_epi8(above9, block));
+        mask = ~(unsigned int) _mm256_movemask_epi8(
+                   _mm256_or_si256(_mm256_or_si256(letter, digit),
+                                   _mm256_cmpeq_epi8(block, underscore)));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scalarWordEnd(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2SpaceEnd(const char *p, const char *end)
+{
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i belowTab = _mm256_set1_epi8('\t' - 1);
+    const __m256i aboveReturn = _mm256_set1_epi8('\r' + 1);
+    __m256i block, space;
+    unsigned int mask;
+
+    while (end - p >= 32)
+    {
+        block = _mm256_loadu_si256((const __m256i *) p);
+        space = _mm256_or_si256(_mm256_cmpeq_epi8(block, blank),
+                    _mm256_and_si256(_mm256_cmpgt_epi8(block, belowTab),
+                                     _mm256_cmpgt_epi8(aboveReturn, block)));
+        mask = ~(unsigned int) _mm256_movemask_epi8(space);
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scalarSpaceEnd(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2LineEnd(const char *p, const char *end)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    unsigned int mask;
+
+    while (end - p >= 32)
+    {
+        mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                   _mm256_loadu_si256((const __m256i *) p), newline));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scalarLineEnd(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2StringEnd(const char *p, const char *end)
+{
+    const __m256i quote = _mm256_set1_epi8('\"');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i block;
+    unsigned int mask;
+
+    while (end - p >= 32)
+    {
+        block = _mm256_loadu_si256((const __m256i *) p);
+        mask = (unsigned int) _mm256_movemask_epi8(
+                   _mm256_or_si256(_mm256_cmpeq_epi8(block, quote),
+                                   _mm256_cmpeq_epi8(block, newline)));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scalarStringEnd(p, end);
+}
+
+/*
+ Compares the block against '*' and the block one byte on against '/', so a
+ set bit marks a '*' that is followed by a '/'.
+ */
+__attribute__((target("avx2")))
+static const char *avx2CommentEnd(const char *p, const char *end)
+{
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i slash = _mm256_set1_epi8('/');
+    unsigned int mask;
+
+    while (end - p >= 33)
+    {
+        mask = (unsigned int) _mm256_movemask_epi8(_mm256_and_si256(
+                   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p),
+                                     star),
+                   _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                                         (const __m256i *) (p + 1)), slash)));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scalarCommentEnd(p, end);
+}
+
+#endif /* JACK_SCANNER_X86 */
+
+/*
+ Starts with the fastest engine the CPU supports.
+ */
+JackScanner::JackScanner()
+{
+    setEngine(bestEngine());
+}
+
+/*
+ Returns the fastest engine the CPU supports. The CPU is only queried once.
+ */
+int JackScanner::bestEngine()
+{
+    static const int best = isSupported(SCAN_AVX2) ? SCAN_AVX2 :
+                            isSupported(SCAN_SSE42) ? SCAN_SSE42 : SCAN_SCALAR;
+    return best;
+}
+
+/*
+ Determines whether an engine can run on this CPU.
+ */
+bool JackScanner::isSupported(int engine)
+{
+    if (engine == SCAN_SCALAR)
+        return true;
+
+#ifdef JACK_SCANNER_X86
+    __builtin_cpu_init();
+    if (engine == SCAN_SSE42)
+        return __builtin_cpu_supports("sse4.2");
+    if (engine == SCAN_AVX2)
+        return __builtin_cpu_supports("avx2");
+#endif
+
+    return false;
+}
+
+/*
+ Returns the name of an engine, for diagnostics.
+ */
+const char *JackScanner::getEngineName(int engine)
+{
+    switch (engine)
+    {
+        case SCAN_SCALAR:
+            return "scalar";
+        case SCAN_SSE42:
+            return "sse4.2";
+        case SCAN_AVX2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+/*
+ Switches to another engine. Returns false, leaving the current engine in
+ place, if this CPU cannot run it.
+ */
+bool JackScanner::setEngine(int engine)
+{
+    if (!isSupported(engine))
+        return false;
+
+    wordEnd = scalarWordEnd;
+    spaceEnd = scalarSpaceEnd;
+    lineEnd = scalarLineEnd;
+    stringEnd = scalarStringEnd;
+    commentEnd = scalarCommentEnd;
+
+#ifdef JACK_SCANNER_X86
+    if (engine == SCAN_SSE42)
+    {
+        wordEnd = sse42WordEnd;
+        spaceEnd = sse42SpaceEnd;
+        lineEnd = sse42LineEnd;
+        stringEnd = sse42StringEnd;
+        commentEnd = sse42CommentEnd;
+    }
+    else if (engine == SCAN_AVX2)
+    {
+        wordEnd = avx2WordEnd;
+        spaceEnd = avx2SpaceEnd;
+        lineEnd = avx2LineEnd;
+        stringEnd = avx2StringEnd;
+        commentEnd = avx2CommentEnd;
+    }
+#endif
+
+    this->engine = engine;
+    return true;
+}
+
+/*
+ Returns the engine in use.
+ */
+int JackScanner::getEngine()
+{
+    return engine;
+}
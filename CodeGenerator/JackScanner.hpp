@@ -0,0 +1,113 @@
+/*
+ JackScanner.hpp
+ CodeGenerator
+
+ Finds the ends of the long character runs in Jack source (identifiers, white
+ space, string constants and comments) for the JackTokenizer. On x86-64 the
+ runs are scanned 16 or 32 bytes at a time with SSE4.2 or AVX2, whichever the
+ CPU supports, and everywhere else one byte at a time. Every engine returns
+ exactly the same positions.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef JackScanner_hpp
+#define JackScanner_hpp
+
+enum ScanEngine
+{
+    SCAN_SCALAR = 0,
+    SCAN_SSE42,
+    SCAN_AVX2
+};
+
+/*
+ Character classes used to scan the input. Each input byte is classified with
+ a single load from charClass; bytes outside 7-bit ASCII belong to no class.
+ */
+enum CharClass
+{
+    CC_SPACE = 1,
+    CC_SYMBOL = 2,
+    CC_DIGIT = 4,
+    CC_LETTER = 8,
+    CC_QUOTE = 16,
+    CC_WORD = CC_DIGIT | CC_LETTER
+};
+
+class JackScanner
+{
+public:
+    static constexpr unsigned char charClass[256] =
+    {
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, CC_SPACE, CC_SPACE, CC_SPACE, CC_SPACE, CC_SPACE, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        CC_SPACE, 0, CC_QUOTE, 0, 0, 0, CC_SYMBOL, 0,
+        CC_SYMBOL, CC_SYMBOL, CC_SYMBOL, CC_SYMBOL,
+        CC_SYMBOL, CC_SYMBOL, CC_SYMBOL, CC_SYMBOL,
+        CC_DIGIT, CC_DIGIT, CC_DIGIT, CC_DIGIT,
+        CC_DIGIT, CC_DIGIT, CC_DIGIT, CC_DIGIT,
+        CC_DIGIT, CC_DIGIT, 0, CC_SYMBOL, CC_SYMBOL, CC_SYMBOL, CC_SYMBOL, 0,
+        0, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_SYMBOL, 0, CC_SYMBOL, 0, CC_LETTER,
+        0, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+        CC_LETTER, CC_LETTER, CC_LETTER, CC_SYMBOL,
+        CC_SYMBOL, CC_SYMBOL, CC_SYMBOL, 0
+    };
+
+private:
+    const char *(*wordEnd)(const char *p, const char *end);
+    const char *(*spaceEnd)(const char *p, const char *end);
+    const char *(*lineEnd)(const char *p, const char *end);
+    const char *(*stringEnd)(const char *p, const char *end);
+    const char *(*commentEnd)(const char *p, const char *end);
+    int engine;
+
+public:
+    JackScanner();
+    static int bestEngine();
+    static bool isSupported(int engine);
+    static const char *getEngineName(int engine);
+    bool setEngine(int engine);
+    int getEngine();
+
+    // Each returns the first position at or after p that ends the run, or end
+    const char *skipWord(const char *p, const char *end)
+    {
+        return wordEnd(p, end);
+    }
+
+    const char *skipSpace(const char *p, const char *end)
+    {
+        return spaceEnd(p, end);
+    }
+
+    const char *findLineEnd(const char *p, const char *end)
+    {
+        return lineEnd(p, end);
+    }
+
+    const char *findStringEnd(const char *p, const char *end)
+    {
+        return stringEnd(p, end);
+    }
+
+    const char *findCommentEnd(const char *p, const char *end)
+    {
+        return commentEnd(p, end);
+    }
+};
+
+#endif /* JackScanner_hpp */
@@ -15,359 +15,570 @@
 #include "JackTokenizer.hpp"
 
 /*
- Sets the current position in the tokenList vector to 0 and define the preset
- keywords and symbols.
+ The Symbol enum value of each symbol character, or 0 for any other byte.
  */
-JackTokenizer::JackTokenizer()
+static constexpr unsigned char symbolCode[256] =
 {
-    listIndex = 0;
-    defineKeywords();
-    defineSymbols();
-}
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, S_AMPERSAND, 0,
+    S_LEFT_PAREN, S_RIGHT_PAREN, S_ASTERISK, S_PLUS, S_COMMA, S_MINUS, S_PERIOD, S_SLASH,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, S_SEMICOLON, S_LESS_THAN, S_EQUALS, S_GREATER_THAN, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, S_LEFT_BRACKET, 0, S_RIGHT_BRACKET, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, S_LEFT_BRACE, S_PIPE, S_RIGHT_BRACE, S_TILDE, 0,
+};
 
 /*
- Returns the size of the tokenList vector.
+ The keyword and symbol terminal elements, indexed by their enum values in
+ Keyword and Symbol.
  */
-int JackTokenizer::getTokenListSize()
+static constexpr const char *keywordText[22] =
 {
-    return (int) tokenList.size();
-}
+    "", "class", "method", "function", "constructor", "int", "boolean", "char",
+    "void", "var", "static", "field", "let", "do", "if", "else", "while",
+    "return", "true", "false", "null", "this"
+};
+
+static constexpr unsigned char keywordLength[22] =
+{
+    0, 5, 6, 8, 11, 3, 7, 4, 4, 3, 6, 5, 3, 2, 2, 4, 5, 6, 4, 5, 4, 4
+};
+
+static constexpr const char *symbolText[20] =
+{
+    "", "{", "}", "(", ")", "[", "]", ".", ",", ";", "+", "-", "*", "/", "&",
+    "|", "<", ">", "=", "~"
+};
 
 /*
- Returns a token based on its position in the list.
+ A perfect hash of the 21 keywords, computed from a word's length and its first
+ two characters. Every keyword lands in its own slot of keywordSlot, so a word
+ is a keyword only if it matches the single candidate its hash points to.
  */
-string JackTokenizer::getTokenInList(int index)
+static constexpr int keywordHash(const unsigned char *word, int length)
 {
-    return tokenList.at(index);
+    return ((length << 1) + (word[0] << 3) + word[1]) & 63;
 }
 
+static constexpr unsigned char keywordSlot[64] =
+{
+    0, K_RETURN, 0, 0,
+    0, 0, 0, 0,
+    K_CHAR, 0, 0, K_LET,
+    0, K_BOOLEAN, K_CLASS, 0,
+    K_THIS, 0, 0, K_DO,
+    0, 0, 0, K_VAR,
+    K_STATIC, K_METHOD, K_TRUE, K_FALSE,
+    K_ELSE, K_CONSTRUCTOR, 0, 0,
+    0, 0, 0, K_FIELD,
+    0, 0, 0, K_VOID,
+    0, 0, K_WHILE, 0,
+    0, K_NULL, 0, 0,
+    0, 0, K_IF, 0,
+    0, K_FUNCTION, 0, 0,
+    0, 0, 0, 0,
+    K_INT, 0, 0, 0,
+};
+
 /*
- Sets the current token to the next token in the list.
+ The tokenizer keeps no tables of its own, so constructing one is free.
  */
-void JackTokenizer::nextToken()
+JackTokenizer::JackTokenizer()
 {
-    token = tokenList.at(listIndex++);
+    text = NULL;
+    loadedTypes = loadedCodes = NULL;
+    loadedOffsets = loadedLengths = NULL;
+    loadedCount = 0;
+    nameTable = NULL;
+    queue = NULL;
+    scanPosition = scanEnd = NULL;
+    batchEnd = (size_t) -1;
+    sentCount = 0;
+    for (int type = T_NONE; type <= T_STRING_CONST; type++)
+        sentTypeCounts[type] = 0;
 }
 
 /*
- Returns the current token.
+ Starts a cursor on the batches of a queue, waiting for the first one. With
+ a producer, the cursor has it tokenize each batch when it is needed
+ instead of waiting for another thread to.
  */
-string JackTokenizer::getToken()
+TokenCursor::TokenCursor(TokenQueue *queue, JackTokenizer *producer)
 {
-    return token;
+    this->queue = queue;
+    this->producer = producer;
+    if (producer != NULL)
+        producer->scanBatch();
+    useBatch(queue->front());
 }
 
 /*
- Sets the current position in the tokenList to a different value.
+ Reads the tokens of a batch, from the first. The last token of a batch
+ that is not final is followed by its lookahead, which the cursor may peek
+ at but not advance onto.
  */
-void JackTokenizer::setListIndex(int index)
+void TokenCursor::useBatch(const TokenBatch &batch)
 {
-    if (index < 0)
-        return;
-    
-    listIndex = index;
+    types = batch.types;
+    codes = batch.codes;
+    offsets = batch.offsets;
+    lengths = batch.lengths;
+    names = batch.named ? batch.names : NULL;
+    text = batch.text;
+    position = 0;
+    last = batch.count - 1;
+    limit = batch.lastBatch ? last : last + TokenBatch::LOOKAHEAD;
+    if (batch.lastBatch)
+        queue = NULL;
 }
 
 /*
- Returns the current position in the tokenList vector.
+ Gives the batch the cursor has finished back to the tokenizer and moves
+ to the first token of the next, which is the one the cursor looked ahead
+ to at the end of this one.
  */
-int JackTokenizer::getListIndex()
+void TokenCursor::nextBatch()
 {
-    return listIndex;
+    queue->pop();
+    if (producer != NULL)
+        producer->scanBatch();
+    useBatch(queue->front());
 }
 
 /*
- Returns the type of the current token.
+ Returns a cursor positioned at the first token in the token table.
  */
-int JackTokenizer::tokenType()
+TokenCursor JackTokenizer::cursor()
 {
-    if (isKeyword())
-        return T_KEYWORD;
-    if (isSymbol())
-        return T_SYMBOL;
-    if (isIntVal())
-        return T_INT_CONST;
-    if (isStringVal())
-        return T_STRING_CONST;
+    const int *numbers;
+    
+    if (loadedCount > 0)
+    {
+        numbers = (nameTable != NULL) ? names.data() : NULL;
+        return TokenCursor(loadedTypes, loadedCodes, loadedOffsets,
+                           loadedLengths, numbers, text, loadedCount - 1);
+    }
     
-    return T_IDENTIFIER;
+    if (types.empty())
+        addToken(T_NONE, 0, text, text);
+    
+    numbers = (nameTable != NULL) ? names.data() : NULL;
+    return TokenCursor(&types[0], &codes[0], &offsets[0], &lengths[0],
+                       numbers, text, getTokenCount());
 }
 
 /*
- Returns the keyword value which is it's enum value in KeywordType.
+ Returns the number of tokens in the token table, not counting the sentinel.
  */
-int JackTokenizer::keyword()
+int JackTokenizer::getTokenCount()
 {
-    for (int i = 0; i < KW_SIZE; i++)
-    {
-        if (token == keywordList[i])
-        {
-            return (i + 1);
-        }
-    }
-        
-    return 0;
+    if (sentCount > 0)
+        return sentCount - 1;
+    if (loadedCount > 0)
+        return loadedCount - 1;
+    
+    return types.empty() ? 0 : (int) types.size() - 1;
 }
 
 /*
- Determines if the current token is a keyword.
+ Returns the number of tokens of one TokenType.
  */
-bool JackTokenizer::isKeyword()
+int JackTokenizer::getTokenCount(int type)
 {
-    for (int i = 0; i < KW_SIZE; i++)
+    const unsigned char *table = (loadedCount > 0) ? loadedTypes :
+                                 types.data();
+    int count = 0;
+
+    if (sentCount > 0)
+        return (type >= T_KEYWORD && type <= T_STRING_CONST) ?
+               sentTypeCounts[type] : 0;
+
+    for (int i = 0; i < getTokenCount(); i++)
     {
-        if (token == keywordList[i])
-            return true;
+        if (table[i] == type)
+            count++;
     }
-    return false;
+    return count;
 }
 
 /*
- Returns the symbol which is the current token. Should be called only when 
- tokenType() is T_SYMBOL
-*/
-string JackTokenizer::symbol()
+ Returns the text of a keyword given its enum value in Keyword.
+ */
+const char *JackTokenizer::getKeywordText(int keyword)
 {
-    return token;
+    if (keyword < 1 || keyword > KW_SIZE)
+        return "";
+    
+    return keywordText[keyword];
 }
 
 /*
- Returns the identifier which is the current token. Should be called only when 
- tokenType() is T_IDENTIFIER
-*/
-string JackTokenizer::identifier()
+ Returns the text of a symbol given its enum value in Symbol.
+ */
+const char *JackTokenizer::getSymbolText(int symbol)
 {
-    return token;
+    if (symbol < 1 || symbol > SYM_SIZE)
+        return "";
+    
+    return symbolText[symbol];
 }
 
 /*
- Returns the integer value of the current token as a string. Should be called
- only when tokenType() is T_INT_CONST
+ Returns the keyword value of a word, which is its enum value in Keyword, or 0
+ if the word is not a keyword.
  */
-string JackTokenizer::intVal()
+int JackTokenizer::keyword(const char *start, int length)
 {
-    return token;
+    int code;
+    
+    if (length < 2 || length > 11)
+        return 0;
+    
+    code = keywordSlot[keywordHash((const unsigned char *) start, length)];
+    
+    if (code != 0 && keywordLength[code] == length &&
+        memcmp(keywordText[code], start, length) == 0)
+    {
+        return code;
+    }
+    
+    return 0;
 }
 
 /*
- Determines if the current token is an integer constant value by checking if 
- each character in the token is a digit.
-*/
-bool JackTokenizer::isIntVal()
+ Determines if a word is an integer constant value by checking if each
+ character in it is a digit.
+ */
+bool JackTokenizer::isIntVal(const char *start, int length)
 {
-    for (int i = 0; i < token.length(); i++)
+    for (int i = 0; i < length; i++)
     {
-        if (!isdigit(token[i]))
+        if (!(JackScanner::charClass[(unsigned char) start[i]] & CC_DIGIT))
             return false;
     }
     return true;
 }
 
 /*
- Returns the string value of the current token, without the double quotes.
- Should be called only when tokenType() is T_STRING_CONST
- */
-string JackTokenizer::stringVal()
-{
-    token = token.erase(token.front());
-    return token;
-}
-
-/*
- Determines if the current token is a string constant value. A \" is left in the
- string in order to differentiate the string constant value with an identifier.
+ Removes all comments and white space from the input steam and breaks it into
+ Jack-language tokens, as specified by the Jack grammar. Each token is
+ classified as it is found and recorded in the token table as its type, its
+ keyword or symbol code, and its offset and length in the input. The input is
+ not copied, so it must stay alive for as long as the table is used.
  */
-bool JackTokenizer::isStringVal()
+void JackTokenizer::tokenize(const char *begin, const char *end)
 {
-    if (token.find("\"") != std::string::npos)
-    {
-        return true;
-    }
-    return false;
+    const char *p;
+    
+    text = begin;
+    loadedCount = 0;
+    p = scan(begin, end, end);
+    
+    // Sentinel the cursor stops on once the tokens run out
+    addToken(T_NONE, 0, p, p);
 }
 
 /*
- Removes all comments and white space from the input steam and breaks it into
- Jack-language tokens, as specified by the Jack grammar. The tokens are stored
- in the tokenList vector.
+ Adds the tokens that start before stop to the token table, and returns
+ where the next one may start. A token that starts before stop is scanned
+ to its end even if that is past stop, so the input can be tokenized a
+ piece at a time and give the same tokens as all at once.
  */
-void JackTokenizer::tokenize(string line)
+const char *JackTokenizer::scan(const char *p, const char *stop,
+                                const char *end)
 {
-    string currToken;
+    const char *start;
     
-    if (line.find("//") != string::npos)
+    while (p < stop)
     {
-        line.erase(line.find("//"), line.length());
-    }
-    
-    for (int i = 0; i < line.length(); i++)
-    {
-        if (isSymbol(line[i]))
+        unsigned char c = (unsigned char) *p;
+        int cls = JackScanner::charClass[c];
+        
+        if (cls & CC_WORD)
+        {
+            start = p;
+            p = scanner.skipWord(p + 1, end);
+            addToken(start, p);
+        }
+        else if (cls & CC_SPACE)
+        {
+            p = scanner.skipSpace(p + 1, end);
+        }
+        else if (c == '/' && p + 1 < end && p[1] == '/') // Skip to end of line
         {
-            if (!currToken.empty())
-            {
-                tokenList.push_back(currToken);
-                currToken.clear();
-            }
-            currToken += line[i];
-            tokenList.push_back(currToken);
-            currToken.clear();
+            p = scanner.findLineEnd(p + 2, end);
         }
-        else if (line[i] == '\"')
+        else if (c == '/' && p + 1 < end && p[1] == '*') // Skip past "*/"
         {
-            currToken += line[i];
-            i++;
-            while (line[i] != '\"')
-            {
-                currToken += line[i];
-                i++;
-            }
-            tokenList.push_back(currToken);
-            currToken.clear();
+            p = scanner.findCommentEnd(p + 2, end);
+            p = (p < end) ? p + 2 : end;
         }
-        else if (isalpha(line[i]) || isdigit(line[i]) || line[i] == '_')
+        else if (cls & CC_QUOTE)
         {
-            currToken += line[i];
+            start = p + 1;
+            p = scanner.findStringEnd(start, end);
+            addToken(T_STRING_CONST, 0, start, p);
+            if (p < end)
+                p++;
         }
-        else if (!currToken.empty())
+        else
         {
-            tokenList.push_back(currToken);
-            currToken.clear();
+            if (cls & CC_SYMBOL)
+                addToken(T_SYMBOL, symbolCode[c], p, p + 1);
+            p++;
         }
     }
+    return p;
+}
+
+/*
+ As above, but passes the tokens to a parser on another thread in batches
+ through a queue as they are found, rather than keeping them in the token
+ table. The table only ever holds the batch being filled, and the tokens
+ are counted as they are sent.
+ */
+void JackTokenizer::tokenize(const char *begin, const char *end,
+                             TokenQueue *queue)
+{
+    startScan(begin, end, queue);
+    while (this->queue != NULL)
+        scanBatch();
 }
 
 /*
- Determines if the current character being analyzed is a symbol. The
- character is converted into a string in order to compare it to the symbol list
- comiled at the start of the program.
+ Prepares to tokenize the input a batch at a time with scanBatch(), which
+ sends each batch to the queue. A parser on the same thread can call it
+ each time it needs more tokens, so that only a batch or two of the input
+ is ever held as tokens.
  */
-bool JackTokenizer::isSymbol(char token)
+void JackTokenizer::startScan(const char *begin, const char *end,
+                              TokenQueue *queue)
 {
-    string s;
-    s.push_back(token);
+    text = begin;
+    loadedCount = 0;
+    scanPosition = begin;
+    scanEnd = end;
+    this->queue = queue;
+    batchEnd = TokenBatch::SIZE + TokenBatch::LOOKAHEAD;
+}
+
+/*
+ Tokenizes the input a little at a time until at least one more batch has
+ been sent, or the input runs out and the last batch has been. The queue
+ needs room for a few batches.
+ */
+void JackTokenizer::scanBatch()
+{
+    int sent = sentCount;
+    const char *stop;
     
-    for (int i = 0; i < SYM_SIZE; i++)
+    if (queue == NULL)
+        return;
+    
+    while (sentCount == sent && scanPosition < scanEnd)
     {
-        if (s == symbolList[i])
-            return true;
+        stop = (scanEnd - scanPosition > SCAN_CHUNK) ?
+               scanPosition + SCAN_CHUNK : scanEnd;
+        scanPosition = scan(scanPosition, stop, scanEnd);
     }
-    return false;
+    if (sentCount > sent)
+        return;
+    
+    addToken(T_NONE, 0, scanPosition, scanPosition);
+    sendBatch(true);
+    queue = NULL;
+    batchEnd = (size_t) -1;
 }
 
 /*
- Determines if the current token is a symbol. The token is compared to the 
- symbol list compiled at the start of the program.
+ Copies the batch that has been filled to the queue, along with the tokens
+ after it that the parser may look ahead to, and keeps those tokens to
+ start the next batch. The last batch is everything that is left.
  */
-bool JackTokenizer::isSymbol()
+void JackTokenizer::sendBatch(bool lastBatch)
 {
-    for (int i = 0; i < SYM_SIZE; i++)
-    {
-        if (token == symbolList[i])
-            return true;
-    }
-    return false;
+    TokenBatch &batch = queue->reserve();
+    size_t size = types.size();
+    int count = lastBatch ? (int) size : TokenBatch::SIZE;
+
+    memcpy(batch.types, types.data(), size);
+    memcpy(batch.codes, codes.data(), size);
+    memcpy(batch.offsets, offsets.data(), size * sizeof(unsigned int));
+    memcpy(batch.lengths, lengths.data(), size * sizeof(unsigned int));
+    if (nameTable != NULL)
+        memcpy(batch.names, names.data(), size * sizeof(int));
+    batch.text = text;
+    batch.count = count;
+    batch.named = (nameTable != NULL);
+    batch.lastBatch = lastBatch;
+    queue->publish();
+
+    for (int i = 0; i < count; i++)
+        sentTypeCounts[types[i]]++;
+    sentCount += count;
+
+    types.erase(types.begin(), types.begin() + count);
+    codes.erase(codes.begin(), codes.begin() + count);
+    offsets.erase(offsets.begin(), offsets.begin() + count);
+    lengths.erase(lengths.begin(), lengths.begin() + count);
+    if (nameTable != NULL)
+        names.erase(names.begin(), names.begin() + count);
+}
+
+/*
+ Uses a token table built earlier, such as one mapped from a TokenCache, in
+ place of tokenizing. count includes the sentinel, and each token's text is
+ found at its offset in text. Nothing is copied, so the columns and the text
+ must stay alive for as long as the table is used.
+ */
+void JackTokenizer::load(const unsigned char *types,
+                         const unsigned char *codes,
+                         const unsigned int *offsets,
+                         const unsigned int *lengths, const char *text,
+                         int count)
+{
+    this->text = text;
+    loadedTypes = types;
+    loadedCodes = codes;
+    loadedOffsets = offsets;
+    loadedLengths = lengths;
+    loadedCount = count;
+    addNames();
 }
 
 /*
- Determines whether the current line starts or ends a block comment. If the 
- current line starts a block comment, then the program will not analyze another
- line until the end is reached.
+ Numbers the names of a loaded table, which the cache cannot hold because
+ the numbers belong to one build. A loaded table stores each distinct text
+ once, so tokens with the same offset have the same name, and most are
+ found by their offset alone without looking at the text.
  */
-bool JackTokenizer::isBlockComment(string line)
+void JackTokenizer::addNames()
 {
-    if (line.find("*/") != std::string::npos) // If "*/" is found
+    unsigned int seenOffsets[NAME_CACHE_SIZE];
+    int seenNames[NAME_CACHE_SIZE];
+
+    names.clear();
+    if (nameTable == NULL)
+        return;
+
+    for (int i = 0; i < NAME_CACHE_SIZE; i++)
+        seenNames[i] = -1;
+
+    names.resize(loadedCount, -1);
+    for (int i = 0; i < loadedCount; i++)
     {
-        inComment = false;
-        return true;
+        unsigned int offset = loadedOffsets[i];
+        int slot = (int) ((offset * 2654435761u) >> 22) &
+                   (NAME_CACHE_SIZE - 1);
+
+        if (loadedTypes[i] < T_IDENTIFIER)
+            continue;
+
+        if (seenNames[slot] < 0 || seenOffsets[slot] != offset)
+        {
+            seenOffsets[slot] = offset;
+            seenNames[slot] = getName(text + offset, loadedLengths[i]);
+        }
+        names[i] = seenNames[slot];
     }
-    
-    if (line.find("/**") != std::string::npos) // If "/**" is found
+}
+
+/*
+ Has the tokenizer number every identifier and constant in a NameTable as
+ it is found, which the cursor then reports with name(). The table may be
+ shared with tokenizers on other threads.
+ */
+void JackTokenizer::setNameTable(NameTable *table)
+{
+    nameTable = table;
+    for (int i = 0; i < NAME_CACHE_SIZE; i++)
     {
-        inComment = true;
+        nameCache[i].text = NULL;
+        nameCache[i].length = 0;
+        nameCache[i].name = -1;
     }
-    
-    return inComment;
 }
 
 /*
- Determines whether the current line being analyzed is an inline comment.
- If the line is an inline comment, the program refuses to analyze the line.
+ Returns the number of a name. Names seen before by this tokenizer are
+ usually found in its own small cache, which is checked against the text
+ the table holds; the rest go to the shared table.
  */
-bool JackTokenizer::isInLineComment(string line)
+int JackTokenizer::getName(const char *start, size_t length)
 {
-    bool isComment = false;
-    
-    for(int i = 0; i < line.length(); i++)
+    unsigned int hash = NameTable::hash(start, length);
+    CachedName &cached = nameCache[hash & (NAME_CACHE_SIZE - 1)];
+
+    if (cached.name >= 0 && cached.length == length &&
+        memcmp(cached.text, start, length) == 0)
     {
-        if (!isspace(line[i]))
-        {
-            if (line[i] == '/')
-            {
-                isComment = true;
-                break;
-            }
-            else
-            {
-                isComment = false;
-                break;
-            }
-        }
+        return cached.name;
     }
-    
-    return isComment;
+
+    cached.name = nameTable->intern(start, length, hash);
+    cached.text = nameTable->getText(cached.name);
+    cached.length = (unsigned int) length;
+    return cached.name;
+}
+
+/*
+ Selects the engine used to scan runs of characters. Returns false if this CPU
+ cannot run it.
+ */
+bool JackTokenizer::setScanEngine(int engine)
+{
+    return scanner.setEngine(engine);
 }
 
 /*
- Defines the keyword terminal elements.
+ Determines whether another tokenizer produced exactly the same token table.
  */
-void JackTokenizer::defineKeywords()
+bool JackTokenizer::hasSameTokens(JackTokenizer &other)
 {
-    keywordList[0] = "class";
-    keywordList[1] = "method";
-    keywordList[2] = "function";
-    keywordList[3] = "constructor";
-    keywordList[4] = "int";
-    keywordList[5] = "boolean";
-    keywordList[6] = "char";
-    keywordList[7] = "void";
-    keywordList[8] = "var";
-    keywordList[9] = "static";
-    keywordList[10] = "field";
-    keywordList[11] = "let";
-    keywordList[12] = "do";
-    keywordList[13] = "if";
-    keywordList[14] = "else";
-    keywordList[15] = "while";
-    keywordList[16] = "return";
-    keywordList[17] = "true";
-    keywordList[18] = "false";
-    keywordList[19] = "null";
-    keywordList[20] = "this";
+    return (types == other.types && codes == other.codes &&
+            offsets == other.offsets && lengths == other.lengths);
 }
 
 /*
- Defines the symbol terminal elements.
+ Classifies a word (a run of letters, digits and underscores) as a keyword,
+ integer constant or identifier, and appends it to the token table.
  */
-void JackTokenizer::defineSymbols()
+void JackTokenizer::addToken(const char *start, const char *end)
 {
-    symbolList[0] = "{";
-    symbolList[1] = "}";
-    symbolList[2] = "(";
-    symbolList[3] = ")";
-    symbolList[4] = "[";
-    symbolList[5] = "]";
-    symbolList[6] = ".";
-    symbolList[7] = ",";
-    symbolList[8] = ";";
-    symbolList[9] = "+";
-    symbolList[10] = "-";
-    symbolList[11] = "*";
-    symbolList[12] = "/";
-    symbolList[13] = "&";
-    symbolList[14] = "|";
-    symbolList[15] = "<";
-    symbolList[16] = ">";
-    symbolList[17] = "=";
-    symbolList[18] = "~";
-}
\ No newline at end of file
+    int length = (int) (end - start);
+    int code = keyword(start, length);
+    
+    if (code != 0)
+        addToken(T_KEYWORD, code, start, end);
+    else if (isIntVal(start, length))
+        addToken(T_INT_CONST, 0, start, end);
+    else
+        addToken(T_IDENTIFIER, 0, start, end);
+}
+
+/*
+ Appends an already classified token to the token table, numbering its text
+ if it is a name and the tokenizer has a NameTable.
+ */
+void JackTokenizer::addToken(int type, int code, const char *start,
+                             const char *end)
+{
+    types.push_back((unsigned char) type);
+    codes.push_back((unsigned char) code);
+    offsets.push_back((unsigned int) (start - text));
+    lengths.push_back((unsigned int) (end - start));
+    if (nameTable != NULL)
+        names.push_back((type >= T_IDENTIFIER) ?
+                        getName(start, end - start) : -1);
+    if (types.size() == batchEnd)
+        sendBatch(false);
+}
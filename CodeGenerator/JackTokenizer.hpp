@@ -17,13 +17,18 @@
 
 #include <iostream>
 #include <vector>
+#include <cstring>
+#include "JackScanner.hpp"
+#include "NameTable.hpp"
+#include "RingBuffer.hpp"
 
 using std::string;
 using std::vector;
 
 enum TokenType
 {
-    T_KEYWORD = 1,
+    T_NONE = 0,
+    T_KEYWORD,
     T_SYMBOL,
     T_IDENTIFIER,
     T_INT_CONST,
@@ -55,44 +60,244 @@ enum Keyword
     K_THIS
 };
 
+enum Symbol
+{
+    S_LEFT_BRACE = 1,
+    S_RIGHT_BRACE,
+    S_LEFT_PAREN,
+    S_RIGHT_PAREN,
+    S_LEFT_BRACKET,
+    S_RIGHT_BRACKET,
+    S_PERIOD,
+    S_COMMA,
+    S_SEMICOLON,
+    S_PLUS,
+    S_MINUS,
+    S_ASTERISK,
+    S_SLASH,
+    S_AMPERSAND,
+    S_PIPE,
+    S_LESS_THAN,
+    S_GREATER_THAN,
+    S_EQUALS,
+    S_TILDE
+};
+
+/*
+ A run of tokens passed from a tokenizer to a parser as they are found,
+ whether on another thread or the same one, in the same columns as the
+ token table. The first count tokens
+ belong to the batch; the LOOKAHEAD after them are copies of the first
+ tokens of the next batch, so the parser can look ahead across the end. The
+ final batch ends in the T_NONE sentinel instead.
+ */
+struct TokenBatch
+{
+    static const int SIZE = 4096;
+    static const int LOOKAHEAD = 2;
+    
+    unsigned char types[SIZE + LOOKAHEAD];
+    unsigned char codes[SIZE + LOOKAHEAD];
+    unsigned int offsets[SIZE + LOOKAHEAD];
+    unsigned int lengths[SIZE + LOOKAHEAD];
+    int names[SIZE + LOOKAHEAD];
+    const char *text;
+    int count;
+    bool named;
+    bool lastBatch;
+};
+
+typedef RingBuffer<TokenBatch> TokenQueue;
+
+class JackTokenizer;
+
+/*
+ Reads through the token table built by JackTokenizer::tokenize. Each token
+ was classified once when it was scanned, so every query is an array load.
+ The table ends in a T_NONE sentinel and the cursor never advances past it,
+ which makes looking ahead safe without bounds checks. A cursor can also
+ read the batches of a TokenQueue while they are still being tokenized,
+ moving to the next batch when it advances past the end of one.
+ */
+class TokenCursor
+{
+private:
+    const unsigned char *types;
+    const unsigned char *codes;
+    const unsigned int *offsets;
+    const unsigned int *lengths;
+    const int *names;
+    const char *text;
+    int position;
+    int last;
+    int limit;
+    TokenQueue *queue;
+    JackTokenizer *producer;
+    
+private:
+    void useBatch(const TokenBatch &batch);
+    void nextBatch();
+    
+public:
+    TokenCursor()
+    {
+        types = codes = NULL;
+        offsets = lengths = NULL;
+        names = NULL;
+        text = NULL;
+        position = last = limit = 0;
+        queue = NULL;
+        producer = NULL;
+    }
+    
+    TokenCursor(const unsigned char *types, const unsigned char *codes,
+                const unsigned int *offsets, const unsigned int *lengths,
+                const int *names, const char *text, int count)
+    {
+        this->types = types;
+        this->codes = codes;
+        this->offsets = offsets;
+        this->lengths = lengths;
+        this->names = names;
+        this->text = text;
+        position = 0;
+        last = limit = count;
+        queue = NULL;
+        producer = NULL;
+    }
+    
+    TokenCursor(TokenQueue *queue, JackTokenizer *producer);
+    
+    void advance()
+    {
+        if (position < last)
+            position++;
+        else if (queue != NULL)
+            nextBatch();
+    }
+    
+    int getPosition() const
+    {
+        return position;
+    }
+    
+    int tokenType() const
+    {
+        return types[position];
+    }
+    
+    int keyword() const
+    {
+        return (types[position] == T_KEYWORD) ? codes[position] : 0;
+    }
+    
+    int symbol() const
+    {
+        return (types[position] == T_SYMBOL) ? codes[position] : 0;
+    }
+    
+    // The NameTable number of an identifier or constant, or -1 if the
+    // tokenizer had no NameTable
+    int name() const
+    {
+        return (names != NULL) ? names[position] : -1;
+    }
+    
+    int peekType(int n) const
+    {
+        return types[(position + n < limit) ? position + n : limit];
+    }
+    
+    int peekSymbol(int n) const
+    {
+        int i = (position + n < limit) ? position + n : limit;
+        return (types[i] == T_SYMBOL) ? codes[i] : 0;
+    }
+    
+    // The characters of the current token. String constants exclude quotes.
+    const char *start() const
+    {
+        return text + offsets[position];
+    }
+    
+    int length() const
+    {
+        return (int) lengths[position];
+    }
+    
+    string token() const
+    {
+        return string(start(), length());
+    }
+};
+
 class JackTokenizer
 {
 private:
     static const int KW_SIZE = 21;
     static const int SYM_SIZE = 19;
-    int listIndex;
-    string token;
-    vector<string> tokenList;
-    string keywordList[21];
-    string symbolList[19];
-    bool inComment;
+    static const int NAME_CACHE_SIZE = 1024;
+    static const int SCAN_CHUNK = 4096;
+    
+    /*
+     A name this tokenizer has already numbered, so that looking it up
+     again takes no lock.
+     */
+    struct CachedName
+    {
+        const char *text;
+        unsigned int length;
+        int name;
+    };
+    
+    const char *text;
+    JackScanner scanner;
+    vector<unsigned char> types;
+    vector<unsigned char> codes;
+    vector<unsigned int> offsets;
+    vector<unsigned int> lengths;
+    const unsigned char *loadedTypes;
+    const unsigned char *loadedCodes;
+    const unsigned int *loadedOffsets;
+    const unsigned int *loadedLengths;
+    int loadedCount;
+    NameTable *nameTable;
+    vector<int> names;
+    CachedName nameCache[NAME_CACHE_SIZE];
+    TokenQueue *queue;
+    const char *scanPosition;
+    const char *scanEnd;
+    size_t batchEnd;
+    int sentCount;
+    int sentTypeCounts[T_STRING_CONST + 1];
     
 private:
-    bool isKeyword();
-    bool isSymbol(char token);
-    bool isSymbol();
-    bool isIntVal();
-    bool isStringVal();
-    void defineKeywords();
-    void defineSymbols();
+    const char *scan(const char *p, const char *stop, const char *end);
+    void sendBatch(bool lastBatch);
+    int getName(const char *start, size_t length);
+    void addNames();
+    int keyword(const char *start, int length);
+    bool isIntVal(const char *start, int length);
+    void addToken(const char *start, const char *end);
+    void addToken(int type, int code, const char *start, const char *end);
     
 public:
     JackTokenizer();
-    void nextToken();
-    string getTokenInList(int index);
-    int getTokenListSize();
-    string getToken();
-    void setListIndex(int index);
-    int getListIndex();
-    void tokenize(string line);
-    int tokenType();
-    int keyword();
-    string symbol();
-    string identifier();
-    string intVal();
-    string stringVal();
-    bool isBlockComment(string line);
-    bool isInLineComment(string line);
+    void tokenize(const char *begin, const char *end);
+    void tokenize(const char *begin, const char *end, TokenQueue *queue);
+    void startScan(const char *begin, const char *end, TokenQueue *queue);
+    void scanBatch();
+    void load(const unsigned char *types, const unsigned char *codes,
+              const unsigned int *offsets, const unsigned int *lengths,
+              const char *text, int count);
+    bool setScanEngine(int engine);
+    void setNameTable(NameTable *table);
+    bool hasSameTokens(JackTokenizer &other);
+    TokenCursor cursor();
+    int getTokenCount();
+    int getTokenCount(int type);
+    static const char *getKeywordText(int keyword);
+    static const char *getSymbolText(int symbol);
 };
 
 #endif /* JackTokenizer_hpp */
@@ -0,0 +1,406 @@
+/*
+ JsonValue.cpp
+ CodeGenerator
+
+ A value read from JSON text: null, a boolean, a number, a string, an array
+ or an object. It is only as much JSON as the language server needs to read
+ the messages an editor sends, and to write a value such as a request id
+ back unchanged. An object keeps its members in the order they were read.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "JsonValue.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ The value a lookup returns for a member or item that is not there.
+ */
+static const JsonValue nullValue;
+
+JsonValue::JsonValue()
+{
+    type = JSON_NULL;
+    number = 0;
+}
+
+/*
+ Reads a whole JSON text into this value. Returns false if it is not valid
+ JSON, leaving the value null.
+ */
+bool JsonValue::parse(const string &json)
+{
+    const char *p = json.data();
+    const char *end = p + json.length();
+
+    if (parseValue(p, end, 0))
+    {
+        skipSpace(p, end);
+        if (p == end)
+            return true;
+    }
+
+    *this = JsonValue();
+    return false;
+}
+
+void JsonValue::skipSpace(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        p++;
+}
+
+/*
+ Reads one value starting at p, which is left after it.
+ */
+bool JsonValue::parseValue(const char *&p, const char *end, int depth)
+{
+    skipSpace(p, end);
+    if (p == end)
+        return false;
+
+    if (*p == '{' || *p == '[')
+    {
+        char close = (*p == '{') ? '}' : ']';
+
+        if (depth >= MAX_DEPTH)
+            return false;
+
+        type = (*p == '{') ? JSON_OBJECT : JSON_ARRAY;
+        p++;
+        skipSpace(p, end);
+        if (p < end && *p == close)
+        {
+            p++;
+            return true;
+        }
+
+        while (true)
+        {
+            items.push_back(JsonValue());
+            if (type == JSON_OBJECT)
+            {
+                keys.push_back(string());
+                skipSpace(p, end);
+                if (!parseString(p, end, keys.back()))
+                    return false;
+                skipSpace(p, end);
+                if (p == end || *p != ':')
+                    return false;
+                p++;
+            }
+            if (!items.back().parseValue(p, end, depth + 1))
+                return false;
+
+            skipSpace(p, end);
+            if (p == end)
+                return false;
+            if (*p == close)
+            {
+                p++;
+                return true;
+            }
+            if (*p != ',')
+                return false;
+            p++;
+        }
+    }
+
+    if (*p == '"')
+    {
+        type = JSON_STRING;
+        return parseString(p, end, text);
+    }
+
+    if (end - p >= 4 && memcmp(p, "true", 4) == 0)
+    {
+        type = JSON_BOOL;
+        number = 1;
+        p += 4;
+        return true;
+    }
+    if (end - p >= 5 && memcmp(p, "false", 5) == 0)
+    {
+        type = JSON_BOOL;
+        number = 0;
+        p += 5;
+        return true;
+    }
+    if (end - p >= 4 && memcmp(p, "null", 4) == 0)
+    {
+        type = JSON_NULL;
+        p += 4;
+        return true;
+    }
+
+    if (*p == '-' || (*p >= '0' && *p <= '9'))
+    {
+        const char *start = p;
+        string digits;
+        char *stop;
+
+        while (p < end && (strchr("+-.eE", *p) != NULL ||
+                           (*p >= '0' && *p <= '9')))
+            p++;
+
+        digits.assign(start, p);
+        number = strtod(digits.c_str(), &stop);
+        type = JSON_NUMBER;
+        return *stop == '\0';
+    }
+
+    return false;
+}
+
+/*
+ Reads a quoted string starting at p into text, decoding its escapes. A
+ \u escape is written to text as UTF-8, joining a surrogate pair into one
+ character.
+ */
+bool JsonValue::parseString(const char *&p, const char *end, string &text)
+{
+    if (p == end || *p != '"')
+        return false;
+
+    for (p++; p < end && *p != '"'; p++)
+    {
+        unsigned int code, low;
+
+        if (*p != '\\')
+        {
+            text += *p;
+            continue;
+        }
+
+        if (++p == end)
+            return false;
+
+        switch (*p)
+        {
+            case 'b':
+                text += '\b';
+                break;
+            case 'f':
+                text += '\f';
+                break;
+            case 'n':
+                text += '\n';
+                break;
+            case 'r':
+                text += '\r';
+                break;
+            case 't':
+                text += '\t';
+                break;
+            case 'u':
+                if (!parseHex(p + 1, end, code))
+                    return false;
+                p += 4;
+                if (code >= 0xd800 && code < 0xdc00 && end - p >= 7 &&
+                    p[1] == '\\' && p[2] == 'u' &&
+                    parseHex(p + 3, end, low) &&
+                    low >= 0xdc00 && low < 0xe000)
+                {
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    p += 6;
+                }
+                appendUTF8(text, code);
+                break;
+            default:
+                text += *p;
+                break;
+        }
+    }
+
+    if (p == end)
+        return false;
+
+    p++;
+    return true;
+}
+
+/*
+ Reads the four hex digits of a \u escape.
+ */
+bool JsonValue::parseHex(const char *p, const char *end, unsigned int &code)
+{
+    code = 0;
+    if (end - p < 4)
+        return false;
+
+    for (int i = 0; i < 4; i++)
+    {
+        char c = p[i];
+
+        code <<= 4;
+        if (c >= '0' && c <= '9')
+            code |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            code |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            code |= c - 'A' + 10;
+        else
+            return false;
+    }
+    return true;
+}
+
+void JsonValue::appendUTF8(string &text, unsigned int code)
+{
+    if (code < 0x80)
+    {
+        text += (char) code;
+    }
+    else if (code < 0x800)
+    {
+        text += (char) (0xc0 | (code >> 6));
+        text += (char) (0x80 | (code & 0x3f));
+    }
+    else if (code < 0x10000)
+    {
+        text += (char) (0xe0 | (code >> 12));
+        text += (char) (0x80 | ((code >> 6) & 0x3f));
+        text += (char) (0x80 | (code & 0x3f));
+    }
+    else
+    {
+        text += (char) (0xf0 | (code >> 18));
+        text += (char) (0x80 | ((code >> 12) & 0x3f));
+        text += (char) (0x80 | ((code >> 6) & 0x3f));
+        text += (char) (0x80 | (code & 0x3f));
+    }
+}
+
+int JsonValue::getType() const
+{
+    return type;
+}
+
+bool JsonValue::isNull() const
+{
+    return type == JSON_NULL;
+}
+
+bool JsonValue::getBool() const
+{
+    return type == JSON_BOOL && number != 0;
+}
+
+/*
+ Returns the number, or 0 if the value is not one.
+ */
+double JsonValue::getNumber() const
+{
+    return (type == JSON_NUMBER) ? number : 0;
+}
+
+/*
+ Returns the string, or an empty one if the value is not one.
+ */
+const string &JsonValue::getString() const
+{
+    return text;
+}
+
+/*
+ Returns the number of items of an array, or members of an object.
+ */
+size_t JsonValue::size() const
+{
+    return items.size();
+}
+
+/*
+ Returns an item of an array, or a null value if there is no such item.
+ */
+const JsonValue &JsonValue::operator[](size_t index) const
+{
+    return (index < items.size()) ? items[index] : nullValue;
+}
+
+/*
+ Returns the member of an object with the given name, or a null value if
+ there is none, so that lookups can be chained without checking each step.
+ */
+const JsonValue &JsonValue::get(const string &key) const
+{
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == key)
+            return items[i];
+    }
+    return nullValue;
+}
+
+/*
+ Writes the value as JSON.
+ */
+void JsonValue::write(std::ostream &out) const
+{
+    char digits[32];
+
+    switch (type)
+    {
+        case JSON_BOOL:
+            out << (number != 0 ? "true" : "false");
+            break;
+        case JSON_NUMBER:
+            snprintf(digits, sizeof(digits), "%.17g", number);
+            out << digits;
+            break;
+        case JSON_STRING:
+            writeString(out, text);
+            break;
+        case JSON_ARRAY:
+        case JSON_OBJECT:
+            out << (type == JSON_ARRAY ? '[' : '{');
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                if (i > 0)
+                    out << ',';
+                if (type == JSON_OBJECT)
+                {
+                    writeString(out, keys[i]);
+                    out << ':';
+                }
+                items[i].write(out);
+            }
+            out << (type == JSON_ARRAY ? ']' : '}');
+            break;
+        default:
+            out << "null";
+            break;
+    }
+}
+
+/*
+ Writes text as a JSON string, escaping quotes, backslashes and control
+ characters.
+ */
+void JsonValue::writeString(std::ostream &out, const string &text)
+{
+    char escape[8];
+
+    out << '"';
+    for (size_t i = 0; i < text.length(); i++)
+    {
+        unsigned char c = (unsigned char) text[i];
+
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << (char) c;
+        }
+        else if (c < 0x20)
+        {
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out << escape;
+        }
+        else
+        {
+            out << (char) c;
+        }
+    }
+    out << '"';
+}
@@ -0,0 +1,64 @@
+/*
+ JsonValue.hpp
+ CodeGenerator
+
+ A value read from JSON text: null, a boolean, a number, a string, an array
+ or an object. It is only as much JSON as the language server needs to read
+ the messages an editor sends, and to write a value such as a request id
+ back unchanged. An object keeps its members in the order they were read.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef JsonValue_hpp
+#define JsonValue_hpp
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+enum JsonType
+{
+    JSON_NULL = 0, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY,
+    JSON_OBJECT
+};
+
+class JsonValue
+{
+private:
+    // How deeply arrays and objects may nest before the text is refused,
+    // so that hostile input cannot overflow the stack
+    static const int MAX_DEPTH = 64;
+
+    int type;
+    double number;
+    string text;
+    vector<string> keys;
+    vector<JsonValue> items;
+
+private:
+    bool parseValue(const char *&p, const char *end, int depth);
+    static bool parseString(const char *&p, const char *end, string &text);
+    static bool parseHex(const char *p, const char *end, unsigned int &code);
+    static void appendUTF8(string &text, unsigned int code);
+    static void skipSpace(const char *&p, const char *end);
+
+public:
+    JsonValue();
+    bool parse(const string &json);
+    int getType() const;
+    bool isNull() const;
+    bool getBool() const;
+    double getNumber() const;
+    const string &getString() const;
+    size_t size() const;
+    const JsonValue &operator[](size_t index) const;
+    const JsonValue &get(const string &key) const;
+    void write(std::ostream &out) const;
+    static void writeString(std::ostream &out, const string &text);
+};
+
+#endif /* JsonValue_hpp */
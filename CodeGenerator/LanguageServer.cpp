@@ -0,0 +1,640 @@
+/*
+ LanguageServer.cpp
+ CodeGenerator
+
+ Speaks the Language Server Protocol over standard input and output, so
+ that an editor can show the syntax errors of the Jack files open in it as
+ they are typed. The server keeps the text of each open file and the
+ members of its class as last parsed, each with its errors and how far its
+ parse read. After an edit, only the members whose parse read the text it
+ changed are dropped; the class is parsed again from the first of them,
+ and as soon as the parse comes to the start of a member it still has, it
+ takes that member and those that followed it instead of parsing them. An
+ edit inside a subroutine body costs the tokenizing and parsing of that
+ subroutine alone, and members after a syntax error, which ends the parse
+ of the class, are kept to resume into once the error is mended.
+
+ Positions are counted in bytes, which for the ASCII Jack programs are
+ written in are the UTF-16 units the protocol counts.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "LanguageServer.hpp"
+#include "JackScanner.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+LanguageServer::LanguageServer(const CompileOptions &options)
+{
+    this->options = options;
+    this->options.nameTable = NULL;
+    this->options.tokenCache = NULL;
+    shuttingDown = false;
+}
+
+/*
+ Answers messages from in until the editor sends exit or closes the
+ stream. Returns 0 if the editor asked the server to shut down first, as
+ the protocol expects, and 1 if not.
+ */
+int LanguageServer::run(std::istream &in, std::ostream &out)
+{
+    string body;
+
+    while (readMessage(in, body))
+    {
+        JsonValue message;
+
+        if (!message.parse(body))
+        {
+            respondError(out, JsonValue(), PARSE_ERROR,
+                         "cannot parse message");
+            continue;
+        }
+        if (message.get("method").getString() == "exit")
+            break;
+
+        handleMessage(message, out);
+    }
+
+    return shuttingDown ? 0 : 1;
+}
+
+/*
+ Handles one request or notification. Requests the server does not know
+ are answered with an error; notifications it does not know are ignored,
+ as are responses from the editor.
+ */
+void LanguageServer::handleMessage(const JsonValue &message,
+                                   std::ostream &out)
+{
+    const string &method = message.get("method").getString();
+    const JsonValue &id = message.get("id");
+    const JsonValue &params = message.get("params");
+
+    if (method == "initialize")
+    {
+        respond(out, id, "{\"capabilities\":{\"textDocumentSync\":"
+                         "{\"openClose\":true,\"change\":2}},"
+                         "\"serverInfo\":{\"name\":\"CodeGenerator\"}}");
+    }
+    else if (method == "shutdown")
+    {
+        shuttingDown = true;
+        respond(out, id, "null");
+    }
+    else if (method == "textDocument/didOpen")
+    {
+        openDocument(params, out);
+    }
+    else if (method == "textDocument/didChange")
+    {
+        changeDocument(params, out);
+    }
+    else if (method == "textDocument/didClose")
+    {
+        closeDocument(params, out);
+    }
+    else if (!method.empty() && !id.isNull())
+    {
+        respondError(out, id, METHOD_NOT_FOUND, "unknown method " + method);
+    }
+}
+
+void LanguageServer::openDocument(const JsonValue &params, std::ostream &out)
+{
+    const JsonValue &item = params.get("textDocument");
+    const string &uri = item.get("uri").getString();
+    Document &document = documents[uri];
+
+    document.text = item.get("text").getString();
+    document.version = (long long) item.get("version").getNumber();
+    findLines(document);
+    parseDocument(document);
+    publishDiagnostics(out, uri, document);
+}
+
+/*
+ Applies each change of a didChange in turn, then reports the errors of
+ the file as it now is.
+ */
+void LanguageServer::changeDocument(const JsonValue &params,
+                                    std::ostream &out)
+{
+    const JsonValue &item = params.get("textDocument");
+    const JsonValue &changes = params.get("contentChanges");
+    std::map<string, Document>::iterator it =
+        documents.find(item.get("uri").getString());
+
+    if (it == documents.end())
+        return;
+
+    for (size_t i = 0; i < changes.size(); i++)
+        applyChange(it->second, changes[i]);
+    it->second.version = (long long) item.get("version").getNumber();
+    publishDiagnostics(out, it->first, it->second);
+}
+
+/*
+ Forgets a file, and clears its errors from the editor.
+ */
+void LanguageServer::closeDocument(const JsonValue &params,
+                                   std::ostream &out)
+{
+    const string &uri = params.get("textDocument").get("uri").getString();
+    Document closed;
+
+    documents.erase(uri);
+    publishDiagnostics(out, uri, closed);
+}
+
+/*
+ Applies one change, which replaces a range of the text or, with no range,
+ all of it, and brings the parse up to date.
+ */
+void LanguageServer::applyChange(Document &document, const JsonValue &change)
+{
+    const JsonValue &range = change.get("range");
+    const string &text = change.get("text").getString();
+    size_t start, end, chain, position;
+    ptrdiff_t delta;
+    int rule;
+
+    if (range.isNull())
+    {
+        document.text = text;
+        findLines(document);
+        parseDocument(document);
+        return;
+    }
+
+    start = getOffset(document, range.get("start"));
+    end = getOffset(document, range.get("end"));
+    if (end < start)
+        std::swap(start, end);
+    delta = (ptrdiff_t) text.length() - (ptrdiff_t) (end - start);
+
+    document.text.replace(start, end - start, text);
+    replaceLines(document, start, end, text);
+
+    if (document.liveCount == 0 || start < document.headReadEnd)
+        parseDocument(document);
+    else if (keepMembers(document, start, end, delta, chain, position, rule))
+        reparseFrom(document, chain, position, rule);
+}
+
+/*
+ Parses the whole text.
+ */
+void LanguageServer::parseDocument(Document &document)
+{
+    const char *begin = document.text.data();
+    CompilationEngine ce(begin, begin + document.text.length(), N_CLASS,
+                         NULL, options);
+    vector<Member> &members = document.members;
+    vector<SyntaxError> tail;
+    size_t first;
+
+    members.clear();
+    document.headErrors.clear();
+    collectParse(ce, 0, members, document.headErrors, tail);
+    document.liveCount = members.size();
+    if (members.empty())
+    {
+        document.headErrors.insert(document.headErrors.end(), tail.begin(),
+                                   tail.end());
+        return;
+    }
+
+    members.back().endsClass = true;
+    members.back().classReadEnd = ce.getReadLength();
+    members.back().endErrors.swap(tail);
+
+    // The class header is read up to the first token of the first member,
+    // which is a keyword
+    first = members[0].start;
+    while (first < document.text.length() &&
+           (JackScanner::charClass[(unsigned char) document.text[first]] &
+            CC_WORD))
+        first++;
+    document.headReadEnd = first + 2;
+}
+
+/*
+ After an edit that replaced start to end and changed the length of the
+ text by delta, drops each member whose parse read any of the text that
+ was replaced, and moves those after the edit by delta. Returns false if
+ the last parse is unchanged, because none of its members were dropped and
+ the end of the class was not read from the edit. Otherwise the class must
+ be parsed again from position, which follows the first chain members,
+ with rule N_CLASS_VAR_DEC if class variables may still be declared there
+ and N_SUBROUTINE_DEC if not.
+ */
+bool LanguageServer::keepMembers(Document &document, size_t start,
+                                 size_t end, ptrdiff_t delta, size_t &chain,
+                                 size_t &position, int &rule)
+{
+    vector<Member> &members = document.members;
+    size_t live = document.liveCount;
+    size_t kept = 0;
+    bool changed = false;
+
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        Member &member = members[i];
+        bool after = (member.start >= end);
+
+        if (member.readEnd > start && !after)
+        {
+            if (i < live && !changed)
+            {
+                changed = true;
+                chain = kept;
+                position = (kept > 0) ? members[kept - 1].end : member.start;
+                rule = (kept == 0 ||
+                        members[kept - 1].kind == N_CLASS_VAR_DEC) ?
+                       N_CLASS_VAR_DEC : N_SUBROUTINE_DEC;
+            }
+            continue;
+        }
+
+        if (member.endsClass && member.classReadEnd > start &&
+            member.end < end)
+        {
+            member.endsClass = false;
+            member.endErrors.clear();
+            if (i < live && !changed)
+            {
+                changed = true;
+                chain = kept + 1;
+                position = member.end;
+                rule = (member.kind == N_CLASS_VAR_DEC) ?
+                       N_CLASS_VAR_DEC : N_SUBROUTINE_DEC;
+            }
+        }
+
+        if (after)
+            moveMember(member, delta);
+        if (kept != i)
+            members[kept] = std::move(member);
+        kept++;
+    }
+    members.resize(kept);
+
+    return changed;
+}
+
+/*
+ Moves a member that follows an edit by the change in length.
+ */
+void LanguageServer::moveMember(Member &member, ptrdiff_t delta)
+{
+    member.start += delta;
+    member.end += delta;
+    member.readEnd += delta;
+    if (!member.endsClass)
+        return;
+
+    member.classReadEnd += delta;
+    for (size_t i = 0; i < member.endErrors.size(); i++)
+        member.endErrors[i].offset += delta;
+}
+
+/*
+ Parses the class again from position, keeping the first chain members.
+ The rest of the members are the parse's to resume into: whenever it comes
+ to the start of a subroutine it has parsed before, it takes that member
+ and the ones that followed it in place of parsing them, since the parser
+ would read the same text and be in the same state, and carries on
+ parsing only after a member that did not end where another starts. The
+ parse stops at the end of the class. The members it did not reach are
+ kept if they are after all it read.
+ */
+void LanguageServer::reparseFrom(Document &document, size_t chain,
+                                 size_t position, int rule)
+{
+    vector<Member> &members = document.members;
+    vector<Member> rest(std::make_move_iterator(members.begin() + chain),
+                        std::make_move_iterator(members.end()));
+    const char *begin = document.text.data();
+    const char *end = begin + document.text.length();
+    vector<size_t> stops;
+    size_t next = 0;
+
+    members.resize(chain);
+    while (true)
+    {
+        vector<SyntaxError> tail;
+
+        while (next < rest.size() &&
+               (rest[next].start < position ||
+                rest[next].kind != N_SUBROUTINE_DEC))
+            next++;
+
+        if (next < rest.size() && rest[next].start == position)
+        {
+            do
+            {
+                members.push_back(std::move(rest[next++]));
+            } while (!members.back().endsClass && next < rest.size() &&
+                     rest[next].start == members.back().end &&
+                     rest[next].kind == N_SUBROUTINE_DEC);
+
+            if (members.back().endsClass)
+                break;
+
+            position = members.back().end;
+            rule = N_SUBROUTINE_DEC;
+            continue;
+        }
+
+        stops.clear();
+        for (size_t i = next; i < rest.size(); i++)
+        {
+            if (rest[i].kind == N_SUBROUTINE_DEC)
+                stops.push_back(rest[i].start - position);
+        }
+
+        CompilationEngine ce(begin + position, end, rule, &stops, options);
+
+        collectParse(ce, position, members, tail, tail);
+        if (ce.reachedStop())
+        {
+            position = members.back().end;
+            rule = (members.back().kind == N_CLASS_VAR_DEC) ?
+                   N_CLASS_VAR_DEC : N_SUBROUTINE_DEC;
+            continue;
+        }
+
+        // The class ended without reaching a member parsed before
+        if (members.empty())
+        {
+            parseDocument(document);
+            return;
+        }
+        members.back().endsClass = true;
+        members.back().classReadEnd = position + ce.getReadLength();
+        members.back().endErrors.swap(tail);
+        break;
+    }
+
+    document.liveCount = members.size();
+    for (; next < rest.size(); next++)
+    {
+        if (rest[next].start >= members.back().classReadEnd)
+            members.push_back(std::move(rest[next]));
+    }
+}
+
+/*
+ Copies the members an engine parsed, and the errors outside them, with
+ their offsets moved by base. The errors of each member are kept at
+ offsets from its start. Errors before the first member go to head, and
+ the rest to tail.
+ */
+void LanguageServer::collectParse(CompilationEngine &ce, size_t base,
+                                  vector<Member> &members,
+                                  vector<SyntaxError> &head,
+                                  vector<SyntaxError> &tail)
+{
+    const vector<SyntaxError> &errors = ce.getSyntaxErrors();
+    const vector<ClassMember> &found = ce.getMembers();
+    size_t first = members.size();
+    size_t next = 0;
+
+    members.resize(first + found.size());
+    for (size_t i = 0; i < found.size(); i++)
+    {
+        Member &member = members[first + i];
+        size_t end = (size_t) (found[i].firstError + found[i].errorCount);
+
+        for (; next < (size_t) found[i].firstError; next++)
+        {
+            head.push_back(errors[next]);
+            head.back().offset += base;
+        }
+
+        member.kind = found[i].kind;
+        member.start = base + found[i].start;
+        member.end = base + found[i].end;
+        member.readEnd = base + found[i].readEnd;
+        member.endsClass = false;
+        member.classReadEnd = 0;
+        for (; next < end; next++)
+        {
+            member.errors.push_back(errors[next]);
+            member.errors.back().offset -= found[i].start;
+        }
+    }
+    for (; next < errors.size(); next++)
+    {
+        tail.push_back(errors[next]);
+        tail.back().offset += base;
+    }
+}
+
+/*
+ Finds where every line of the text starts.
+ */
+void LanguageServer::findLines(Document &document)
+{
+    const char *begin = document.text.data();
+    const char *end = begin + document.text.length();
+    const char *p = begin;
+
+    document.lineStarts.assign(1, 0);
+    while ((p = (const char *) memchr(p, '\n', end - p)) != NULL)
+    {
+        p++;
+        document.lineStarts.push_back((size_t) (p - begin));
+    }
+}
+
+/*
+ Updates the line starts for text having replaced start to end: the lines
+ that began inside the range are replaced by those that begin inside the
+ new text, and the lines after it move by the change in length.
+ */
+void LanguageServer::replaceLines(Document &document, size_t start,
+                                  size_t end, const string &text)
+{
+    vector<size_t> &lines = document.lineStarts;
+    vector<size_t>::iterator first =
+        std::upper_bound(lines.begin(), lines.end(), start);
+    vector<size_t>::iterator last = std::upper_bound(first, lines.end(), end);
+    ptrdiff_t delta = (ptrdiff_t) text.length() - (ptrdiff_t) (end - start);
+    size_t index = (size_t) (first - lines.begin());
+    vector<size_t> added;
+
+    for (vector<size_t>::iterator it = last; it != lines.end(); ++it)
+        *it += delta;
+    lines.erase(first, last);
+
+    for (size_t i = 0; i < text.length(); i++)
+    {
+        if (text[i] == '\n')
+            added.push_back(start + i + 1);
+    }
+    lines.insert(lines.begin() + index, added.begin(), added.end());
+}
+
+/*
+ Returns the offset in the text of a position, given as a line and a
+ character. A position past the end of its line is taken as the end.
+ */
+size_t LanguageServer::getOffset(const Document &document,
+                                 const JsonValue &position)
+{
+    double line = position.get("line").getNumber();
+    double character = position.get("character").getNumber();
+    size_t lineStart, lineEnd;
+
+    if (line < 0 || line >= (double) document.lineStarts.size())
+        return document.text.length();
+
+    lineStart = document.lineStarts[(size_t) line];
+    lineEnd = ((size_t) line + 1 < document.lineStarts.size()) ?
+              document.lineStarts[(size_t) line + 1] - 1 :
+              document.text.length();
+    if (character <= 0)
+        return lineStart;
+
+    return std::min(lineStart + (size_t) character, lineEnd);
+}
+
+void LanguageServer::writePosition(std::ostream &out,
+                                   const Document &document, size_t offset)
+{
+    const vector<size_t> &lines = document.lineStarts;
+    size_t line = (size_t) (std::upper_bound(lines.begin(), lines.end(),
+                                             offset) - lines.begin()) - 1;
+
+    out << "{\"line\":" << line << ",\"character\":"
+        << offset - lines[line] << "}";
+}
+
+static bool isBefore(const SyntaxError &a, const SyntaxError &b)
+{
+    return a.offset < b.offset;
+}
+
+/*
+ Sends the editor every syntax error in the file, in the order they occur.
+ */
+void LanguageServer::publishDiagnostics(std::ostream &out, const string &uri,
+                                        const Document &document)
+{
+    vector<SyntaxError> errors = document.headErrors;
+    std::ostringstream body;
+
+    for (size_t i = 0; i < document.liveCount; i++)
+    {
+        const Member &member = document.members[i];
+
+        for (size_t j = 0; j < member.errors.size(); j++)
+        {
+            errors.push_back(member.errors[j]);
+            errors.back().offset += member.start;
+        }
+    }
+    if (document.liveCount > 0)
+    {
+        const Member &last = document.members[document.liveCount - 1];
+
+        errors.insert(errors.end(), last.endErrors.begin(),
+                      last.endErrors.end());
+    }
+    std::stable_sort(errors.begin(), errors.end(), isBefore);
+
+    body << "{\"jsonrpc\":\"2.0\",\"method\":"
+            "\"textDocument/publishDiagnostics\",\"params\":{\"uri\":";
+    JsonValue::writeString(body, uri);
+    body << ",\"version\":" << document.version << ",\"diagnostics\":[";
+    for (size_t i = 0; i < errors.size(); i++)
+    {
+        body << ((i > 0) ? ",{" : "{") << "\"range\":{\"start\":";
+        writePosition(body, document, errors[i].offset);
+        body << ",\"end\":";
+        writePosition(body, document, errors[i].offset + errors[i].length);
+        body << "},\"severity\":1,\"source\":\"jack\",\"message\":";
+        JsonValue::writeString(body, errors[i].message);
+        body << "}";
+    }
+    body << "]}}";
+
+    writeMessage(out, body.str());
+}
+
+void LanguageServer::respond(std::ostream &out, const JsonValue &id,
+                             const string &result)
+{
+    std::ostringstream body;
+
+    body << "{\"jsonrpc\":\"2.0\",\"id\":";
+    id.write(body);
+    body << ",\"result\":" << result << "}";
+    writeMessage(out, body.str());
+}
+
+void LanguageServer::respondError(std::ostream &out, const JsonValue &id,
+                                  int code, const string &message)
+{
+    std::ostringstream body;
+
+    body << "{\"jsonrpc\":\"2.0\",\"id\":";
+    id.write(body);
+    body << ",\"error\":{\"code\":" << code << ",\"message\":";
+    JsonValue::writeString(body, message);
+    body << "}}";
+    writeMessage(out, body.str());
+}
+
+/*
+ Reads one message: header lines up to an empty line, of which only
+ Content-Length matters, and then that many bytes of JSON. Returns false at
+ the end of the input.
+ */
+bool LanguageServer::readMessage(std::istream &in, string &body)
+{
+    static const char lengthHeader[] = "content-length:";
+    string line;
+    long length = -1;
+
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line[line.length() - 1] == '\r')
+            line.erase(line.length() - 1);
+
+        if (line.empty())
+        {
+            if (length < 0)
+                continue;
+
+            body.assign((size_t) length, '\0');
+            in.read(&body[0], length);
+            return in.gcount() == length;
+        }
+
+        if (line.length() > sizeof(lengthHeader) - 1)
+        {
+            string name = line.substr(0, sizeof(lengthHeader) - 1);
+
+            for (size_t i = 0; i < name.length(); i++)
+                name[i] = (char) tolower((unsigned char) name[i]);
+            if (name == lengthHeader)
+                length = atol(line.c_str() + sizeof(lengthHeader) - 1);
+        }
+    }
+    return false;
+}
+
+void LanguageServer::writeMessage(std::ostream &out, const string &body)
+{
+    out << "Content-Length: " << body.length() << "\r\n\r\n" << body;
+    out.flush();
+}
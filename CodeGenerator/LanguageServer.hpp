@@ -0,0 +1,125 @@
+/*
+ LanguageServer.hpp
+ CodeGenerator
+
+ Speaks the Language Server Protocol over standard input and output, so
+ that an editor can show the syntax errors of the Jack files open in it as
+ they are typed. The server keeps the text of each open file and the
+ members of its class as last parsed, each with its errors and how far its
+ parse read. After an edit, only the members whose parse read the text it
+ changed are dropped; the class is parsed again from the first of them,
+ and as soon as the parse comes to the start of a member it still has, it
+ takes that member and those that followed it instead of parsing them. An
+ edit inside a subroutine body costs the tokenizing and parsing of that
+ subroutine alone, and members after a syntax error, which ends the parse
+ of the class, are kept to resume into once the error is mended.
+
+ Positions are counted in bytes, which for the ASCII Jack programs are
+ written in are the UTF-16 units the protocol counts.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef LanguageServer_hpp
+#define LanguageServer_hpp
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "CompilationEngine.hpp"
+#include "JsonValue.hpp"
+
+using std::string;
+using std::vector;
+
+class LanguageServer
+{
+private:
+    // JSON-RPC error codes
+    static const int PARSE_ERROR = -32700;
+    static const int METHOD_NOT_FOUND = -32601;
+
+    /*
+     A member of the class, with its errors at offsets from its start so
+     that they stay right when text before it changes. readEnd is how far
+     its parse read. If the class ended after it, endErrors are the errors
+     found there and classReadEnd is how far that parse read.
+     */
+    struct Member
+    {
+        int kind;
+        size_t start;
+        size_t end;
+        size_t readEnd;
+        vector<SyntaxError> errors;
+        bool endsClass;
+        size_t classReadEnd;
+        vector<SyntaxError> endErrors;
+    };
+
+    /*
+     An open file: its text, the offset each line starts at, and the
+     members of its class. The first liveCount members are those of its
+     last parse, and the class ended after the last of them. The rest were
+     parsed earlier from text after that which has not changed since, and
+     are kept for the parse to resume into if it reaches one of them again.
+     headErrors are the errors before the first member, and headReadEnd
+     is how far the parse of the class up to it read.
+     */
+    struct Document
+    {
+        string text;
+        long long version;
+        vector<size_t> lineStarts;
+        vector<Member> members;
+        size_t liveCount;
+        vector<SyntaxError> headErrors;
+        size_t headReadEnd;
+
+        Document() : version(0), liveCount(0), headReadEnd(0) {}
+    };
+
+    std::map<string, Document> documents;
+    CompileOptions options;
+    bool shuttingDown;
+
+private:
+    void handleMessage(const JsonValue &message, std::ostream &out);
+    void openDocument(const JsonValue &params, std::ostream &out);
+    void changeDocument(const JsonValue &params, std::ostream &out);
+    void closeDocument(const JsonValue &params, std::ostream &out);
+    void applyChange(Document &document, const JsonValue &change);
+    void parseDocument(Document &document);
+    void reparseFrom(Document &document, size_t chain, size_t position,
+                     int rule);
+    static bool keepMembers(Document &document, size_t start, size_t end,
+                            ptrdiff_t delta, size_t &chain,
+                            size_t &position, int &rule);
+    static void moveMember(Member &member, ptrdiff_t delta);
+    static void collectParse(CompilationEngine &ce, size_t base,
+                             vector<Member> &members,
+                             vector<SyntaxError> &head,
+                             vector<SyntaxError> &tail);
+    static void findLines(Document &document);
+    static void replaceLines(Document &document, size_t start, size_t end,
+                             const string &text);
+    static size_t getOffset(const Document &document,
+                            const JsonValue &position);
+    static void writePosition(std::ostream &out, const Document &document,
+                              size_t offset);
+    static void publishDiagnostics(std::ostream &out, const string &uri,
+                                   const Document &document);
+    static void respond(std::ostream &out, const JsonValue &id,
+                        const string &result);
+    static void respondError(std::ostream &out, const JsonValue &id,
+                             int code, const string &message);
+    static bool readMessage(std::istream &in, string &body);
+    static void writeMessage(std::ostream &out, const string &body);
+
+public:
+    LanguageServer(const CompileOptions &options);
+    int run(std::istream &in, std::ostream &out);
+};
+
+#endif /* LanguageServer_hpp */
@@ -0,0 +1,176 @@
+/*
+ NameTable.cpp
+ CodeGenerator
+
+ The names of a whole build: every identifier and constant of every class,
+ each given a dense number the first time any thread sees it. The table is
+ split into shards, each with its own lock, so threads compiling different
+ files rarely wait on each other; the text of a numbered name is read
+ without locking at all.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "NameTable.hpp"
+#include <cstring>
+
+static const unsigned int INITIAL_SLOTS = 256;
+
+/*
+ Starts with no names.
+ */
+NameTable::NameTable()
+{
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        Shard &shard = shards[i];
+
+        shard.slotMask = INITIAL_SLOTS - 1;
+        shard.slots = shard.arena.allocateArray<unsigned int>(INITIAL_SLOTS);
+        memset(shard.slots, 0, INITIAL_SLOTS * sizeof(unsigned int));
+        shard.count = 0;
+    }
+    for (int i = 0; i < MAX_BLOCKS; i++)
+        blocks[i].store(NULL, std::memory_order_relaxed);
+    nameCount = 0;
+}
+
+NameTable::~NameTable()
+{
+    for (int i = 0; i < MAX_BLOCKS; i++)
+        delete[] blocks[i].load(std::memory_order_relaxed);
+}
+
+/*
+ The FNV-1a hash of a name. The top bits choose its shard and the bottom
+ bits its slot.
+ */
+unsigned int NameTable::hash(const char *text, size_t length)
+{
+    unsigned int h = 2166136261u;
+
+    for (size_t i = 0; i < length; i++)
+        h = (h ^ (unsigned char) text[i]) * 16777619u;
+
+    return h;
+}
+
+/*
+ Returns the number of a name, numbering it if it is new. Equal text always
+ gets the same number, whichever thread asks.
+ */
+int NameTable::intern(const char *text, size_t length)
+{
+    return intern(text, length, hash(text, length));
+}
+
+/*
+ As above, for a caller that has already hashed the text.
+ */
+int NameTable::intern(const char *text, size_t length, unsigned int hash)
+{
+    Shard &shard = shards[hash >> (32 - SHARD_BITS)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    unsigned int slot;
+    unsigned int name;
+    char *copy;
+
+    for (slot = hash & shard.slotMask; shard.slots[slot] != 0;
+         slot = (slot + 1) & shard.slotMask)
+    {
+        Entry &entry = getEntry((int) shard.slots[slot] - 1);
+
+        if (entry.hash == hash && entry.length == length &&
+            memcmp(entry.text, text, length) == 0)
+        {
+            return (int) shard.slots[slot] - 1;
+        }
+    }
+
+    name = nameCount.fetch_add(1);
+    copy = shard.arena.allocateArray<char>(length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+
+    Entry &entry = addEntry(name);
+    entry.text = copy;
+    entry.length = (unsigned int) length;
+    entry.hash = hash;
+    shard.slots[slot] = name + 1;
+
+    if (++shard.count * 2 > shard.slotMask)
+        rehash(shard);
+
+    return (int) name;
+}
+
+/*
+ Returns the number of names so far. Every number below it has been given
+ out, though a name another thread is adding may not be readable yet.
+ */
+int NameTable::getCount()
+{
+    return (int) nameCount.load();
+}
+
+/*
+ Returns the entry of a numbered name. The block holding it was published
+ before the number was handed out, so no lock is needed.
+ */
+NameTable::Entry &NameTable::getEntry(int name)
+{
+    Entry *block = blocks[name >> BLOCK_BITS].load(std::memory_order_acquire);
+
+    return block[name & (BLOCK_SIZE - 1)];
+}
+
+/*
+ Returns the entry for a new name, allocating the block it falls in if it
+ is the first name there.
+ */
+NameTable::Entry &NameTable::addEntry(unsigned int name)
+{
+    std::atomic<Entry *> &slot = blocks[name >> BLOCK_BITS];
+    Entry *block = slot.load(std::memory_order_acquire);
+
+    if (block == NULL)
+    {
+        std::lock_guard<std::mutex> guard(blockLock);
+
+        block = slot.load(std::memory_order_acquire);
+        if (block == NULL)
+        {
+            block = new Entry[BLOCK_SIZE];
+            slot.store(block, std::memory_order_release);
+        }
+    }
+
+    return block[name & (BLOCK_SIZE - 1)];
+}
+
+/*
+ Doubles a shard's slots once they are half full. The old slots are left
+ in the shard's arena.
+ */
+void NameTable::rehash(Shard &shard)
+{
+    unsigned int oldMask = shard.slotMask;
+    unsigned int *oldSlots = shard.slots;
+    unsigned int slot;
+
+    shard.slotMask = oldMask * 2 + 1;
+    shard.slots = shard.arena.allocateArray<unsigned int>(shard.slotMask + 1);
+    memset(shard.slots, 0, (shard.slotMask + 1) * sizeof(unsigned int));
+
+    for (unsigned int i = 0; i <= oldMask; i++)
+    {
+        if (oldSlots[i] == 0)
+            continue;
+
+        for (slot = getEntry((int) oldSlots[i] - 1).hash & shard.slotMask;
+             shard.slots[slot] != 0; slot = (slot + 1) & shard.slotMask)
+        {
+        }
+        shard.slots[slot] = oldSlots[i];
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ NameTable.hpp
+ CodeGenerator
+
+ The names of a whole build: every identifier and constant of every class,
+ each given a dense number the first time any thread sees it. The
+ tokenizer numbers names as it finds them, so the parser and back ends
+ compare names as integers and never copy their text. The table is split
+ into shards, each with its own lock, so threads compiling different files
+ rarely wait on each other; the text of a numbered name is read without
+ locking at all.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef NameTable_hpp
+#define NameTable_hpp
+
+#include <atomic>
+#include <mutex>
+#include "Arena.hpp"
+
+class NameTable
+{
+private:
+    static const int SHARD_BITS = 6;
+    static const int SHARD_COUNT = 1 << SHARD_BITS;
+    static const int BLOCK_BITS = 12;
+    static const int BLOCK_SIZE = 1 << BLOCK_BITS;
+    static const int MAX_BLOCKS = 1 << 14;
+
+    struct Entry
+    {
+        const char *text;
+        unsigned int length;
+        unsigned int hash;
+    };
+
+    /*
+     The names whose hash falls in one shard: an open-addressed table of
+     name numbers plus one, and an arena for their text.
+     */
+    struct Shard
+    {
+        std::mutex lock;
+        Arena arena;
+        unsigned int *slots;
+        unsigned int slotMask;
+        unsigned int count;
+    };
+
+    Shard shards[SHARD_COUNT];
+    std::atomic<Entry *> blocks[MAX_BLOCKS];
+    std::atomic<unsigned int> nameCount;
+    std::mutex blockLock;
+
+private:
+    Entry &getEntry(int name);
+    Entry &addEntry(unsigned int name);
+    void rehash(Shard &shard);
+
+public:
+    NameTable();
+    ~NameTable();
+    int intern(const char *text, size_t length);
+    int intern(const char *text, size_t length, unsigned int hash);
+    int getCount();
+    static unsigned int hash(const char *text, size_t length);
+
+    /*
+     Returns the text of a name, terminated by a null character.
+     */
+    const char *getText(int name)
+    {
+        return getEntry(name).text;
+    }
+
+    size_t getLength(int name)
+    {
+        return getEntry(name).length;
+    }
+
+private:
+    NameTable(const NameTable &);
+    NameTable &operator=(const NameTable &);
+};
+
+#endif /* NameTable_hpp */
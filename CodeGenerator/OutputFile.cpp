@@ -0,0 +1,170 @@
+/*
+ OutputFile.cpp
+ CodeGenerator
+
+ A buffered output file shared by the writers of each output format. Bytes
+ are appended to a fixed-size buffer that is written out whenever it fills,
+ so memory use does not grow with the size of the output and each write
+ system call carries a whole buffer. Output goes to a temporary file that
+ only replaces the real one if the bytes differ.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "OutputFile.hpp"
+#include "SourceFile.hpp"
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ Numbers temporary files so that no two outputs in a process share one.
+ */
+static std::atomic<unsigned int> tempFileCount(0);
+
+/*
+ Starts with no output open.
+ */
+OutputFile::OutputFile()
+{
+    fd = -1;
+    ownsFile = false;
+    failed = false;
+    used = 0;
+    bytesWritten = 0;
+    buffer = new char[BUFFER_SIZE];
+}
+
+/*
+ Writes out anything still buffered and closes the output.
+ */
+OutputFile::~OutputFile()
+{
+    close();
+    delete[] buffer;
+}
+
+/*
+ Opens the output. The output is written to a temporary file beside the named
+ one until it is closed. An empty name writes to standard output. Returns
+ false if the file could not be created.
+ */
+bool OutputFile::open(string fileName)
+{
+    close();
+
+    failed = false;
+    bytesWritten = 0;
+
+    if (fileName.empty())
+    {
+        fd = STDOUT_FILENO;
+        ownsFile = false;
+        return true;
+    }
+
+    this->fileName = fileName;
+    tempFileName = fileName + ".tmp." + std::to_string(getpid()) + "." +
+                   std::to_string(tempFileCount++);
+
+    fd = ::open(tempFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ownsFile = (fd >= 0);
+
+    return (fd >= 0);
+}
+
+/*
+ Writes out anything still buffered and closes the output. The temporary file
+ then replaces the named file, unless the named file already holds exactly
+ the same bytes, in which case it is left alone (keeping its timestamp).
+ Returns false if any write failed.
+ */
+bool OutputFile::close()
+{
+    bool ok;
+
+    if (fd < 0)
+        return true;
+
+    flush();
+    if (ownsFile)
+    {
+        if (::close(fd) != 0)
+            failed = true;
+
+        if (failed || SourceFile::sameContents(tempFileName, fileName))
+            unlink(tempFileName.c_str());
+        else if (rename(tempFileName.c_str(), fileName.c_str()) != 0)
+            failed = true;
+    }
+
+    fd = -1;
+    ownsFile = false;
+    ok = !failed;
+    failed = false;
+
+    return ok;
+}
+
+/*
+ Writes the buffer out and empties it.
+ */
+void OutputFile::flush()
+{
+    size_t done = 0;
+    ssize_t count;
+
+    while (done < used && fd >= 0 && !failed)
+    {
+        count = write(fd, buffer + done, used - done);
+        if (count < 0)
+            failed = true;
+        else
+            done += (size_t) count;
+    }
+
+    bytesWritten += done;
+    used = 0;
+}
+
+/*
+ Returns the number of bytes written since the output was opened, not
+ counting any still in the buffer.
+ */
+size_t OutputFile::getBytesWritten()
+{
+    return bytesWritten;
+}
+
+/*
+ Appends text that does not fit in what is left of the buffer, flushing as
+ often as needed.
+ */
+void OutputFile::appendLong(const char *text, size_t length)
+{
+    size_t room;
+
+    while (length > 0)
+    {
+        if (used == BUFFER_SIZE)
+            flush();
+
+        room = BUFFER_SIZE - used;
+        if (room > length)
+            room = length;
+
+        memcpy(buffer + used, text, room);
+        used += room;
+        text += room;
+        length -= room;
+    }
+}
+
+/*
+ Writes bytes as they are.
+ */
+void OutputFile::writeRaw(const char *text, size_t length)
+{
+    append(text, length);
+}
@@ -0,0 +1,71 @@
+/*
+ OutputFile.hpp
+ CodeGenerator
+
+ A buffered output file shared by the writers of each output format. Bytes
+ are appended to a fixed-size buffer that is written out whenever it fills,
+ so memory use does not grow with the size of the output and each write
+ system call carries a whole buffer. Output goes to a temporary file that
+ only replaces the real one if the bytes differ.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef OutputFile_hpp
+#define OutputFile_hpp
+
+#include <iostream>
+#include <cstring>
+
+using std::string;
+
+class OutputFile
+{
+private:
+    static const size_t BUFFER_SIZE = 64 * 1024;
+    int fd;
+    bool ownsFile;
+    string fileName;
+    string tempFileName;
+    bool failed;
+    size_t used;
+    size_t bytesWritten;
+    char *buffer;
+
+private:
+    void appendLong(const char *text, size_t length);
+
+public:
+    OutputFile();
+    ~OutputFile();
+    bool open(string fileName);
+    bool close();
+    void flush();
+    size_t getBytesWritten();
+    void writeRaw(const char *text, size_t length);
+
+    /*
+     Appends bytes to the buffer, flushing it first if they do not fit.
+     */
+    void append(const char *text, size_t length)
+    {
+        if (BUFFER_SIZE - used < length)
+        {
+            appendLong(text, length);
+            return;
+        }
+        memcpy(buffer + used, text, length);
+        used += length;
+    }
+
+    void append(const char *text)
+    {
+        append(text, strlen(text));
+    }
+
+private:
+    OutputFile(const OutputFile &);
+    OutputFile &operator=(const OutputFile &);
+};
+
+#endif /* OutputFile_hpp */
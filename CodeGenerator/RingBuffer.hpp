@@ -0,0 +1,106 @@
+/*
+ RingBuffer.hpp
+ CodeGenerator
+
+ A fixed-size queue between exactly one producer thread and one consumer
+ thread, for passing work from one stage of a pipelined compile to the
+ next. It takes no locks: each side owns one index and only reads the
+ other's, so a slot is filled and emptied in place without copying. A side
+ that finds the queue full or empty yields its thread until the other side
+ catches up.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef RingBuffer_hpp
+#define RingBuffer_hpp
+
+#include <atomic>
+#include <thread>
+
+template <typename T>
+class RingBuffer
+{
+private:
+    T *slots;
+    unsigned int mask;
+
+    // The next slot to read and to write. They count up without wrapping
+    // to the capacity, so full and empty differ; each is on its own cache
+    // line so the two threads do not contend for one.
+    alignas(64) std::atomic<unsigned int> head;
+    alignas(64) std::atomic<unsigned int> tail;
+
+public:
+    /*
+     Makes a queue of capacity slots, which must be a power of two.
+     */
+    explicit RingBuffer(unsigned int capacity)
+    {
+        slots = new T[capacity];
+        mask = capacity - 1;
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    ~RingBuffer()
+    {
+        delete[] slots;
+    }
+
+    /*
+     Producer: returns the next slot to fill, waiting until the consumer has
+     emptied one. The slot is not seen by the consumer until publish().
+     */
+    T &reserve()
+    {
+        unsigned int next = tail.load(std::memory_order_relaxed);
+
+        while (next - head.load(std::memory_order_acquire) > mask)
+            std::this_thread::yield();
+        return slots[next & mask];
+    }
+
+    /*
+     Producer: hands the slot from reserve() to the consumer.
+     */
+    void publish()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+    void push(const T &value)
+    {
+        reserve() = value;
+        publish();
+    }
+
+    /*
+     Consumer: returns the oldest published slot, waiting until there is
+     one. It stays valid until pop().
+     */
+    T &front()
+    {
+        unsigned int next = head.load(std::memory_order_relaxed);
+
+        while (next == tail.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        return slots[next & mask];
+    }
+
+    /*
+     Consumer: gives the slot from front() back to the producer.
+     */
+    void pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+private:
+    RingBuffer(const RingBuffer &);
+    RingBuffer &operator=(const RingBuffer &);
+};
+
+#endif /* RingBuffer_hpp */
@@ -0,0 +1,260 @@
+/*
+ SourceFile.cpp
+ CodeGenerator
+
+ Provides read-only access to the bytes of a .jack source file. Regular files
+ are memory-mapped so the tokenizer can scan them in place; standard input and
+ other streams that cannot be mapped are read into an owned buffer instead.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "SourceFile.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+
+/*
+ Starts with no file open.
+ */
+SourceFile::SourceFile()
+{
+    data = NULL;
+    length = 0;
+    opened = false;
+    mapped = false;
+    released = 0;
+}
+
+/*
+ Releases the mapping or buffer, if any.
+ */
+SourceFile::~SourceFile()
+{
+    close();
+}
+
+/*
+ Opens a source file. An empty name or "-" reads standard input. Regular files
+ are memory-mapped; anything that cannot be mapped (pipes, terminals, empty
+ files) falls back to being read into memory. Returns false if the file could
+ not be opened or read.
+ */
+bool SourceFile::open(string fileName)
+{
+    int fd;
+    bool ok;
+
+    close();
+
+    if (fileName.empty() || fileName == "-")
+    {
+        opened = readStream(STDIN_FILENO);
+        return opened;
+    }
+
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    ok = mapFile(fd) || readStream(fd);
+    ::close(fd);
+
+    opened = ok;
+    return ok;
+}
+
+/*
+ Unmaps the file or frees the fallback buffer.
+ */
+void SourceFile::close()
+{
+    if (mapped)
+        munmap((void *) data, length);
+
+    vector<char>().swap(buffer);
+    data = NULL;
+    length = 0;
+    opened = false;
+    mapped = false;
+    released = 0;
+}
+
+/*
+ Maps a regular, non-empty file into memory. The mapping is read-only and is
+ only ever scanned front to back, so the kernel is told to read ahead.
+ */
+bool SourceFile::mapFile(int fd)
+{
+    struct stat info;
+    void *addr;
+
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+        return false;
+
+    addr = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+        return false;
+
+    madvise(addr, (size_t) info.st_size, MADV_SEQUENTIAL);
+
+    data = (const char *) addr;
+    length = (size_t) info.st_size;
+    mapped = true;
+
+    return true;
+}
+
+/*
+ Reads a stream to its end into the owned buffer.
+ */
+bool SourceFile::readStream(int fd)
+{
+    const size_t CHUNK = 64 * 1024;
+    size_t used = 0;
+    ssize_t count;
+
+    for (;;)
+    {
+        buffer.resize(used + CHUNK);
+        count = read(fd, &buffer[used], CHUNK);
+        if (count < 0)
+        {
+            buffer.clear();
+            return false;
+        }
+        if (count == 0)
+            break;
+        used += (size_t) count;
+    }
+
+    buffer.resize(used);
+    data = buffer.empty() ? NULL : &buffer[0];
+    length = used;
+
+    return true;
+}
+
+/*
+ Lets the system drop the pages of a mapped file before offset, which have
+ been read and are not needed again, so that scanning a very large file
+ does not keep all of it in memory. A page dropped is read from the file
+ again if it is touched. Sources read from a stream are left alone.
+ */
+void SourceFile::release(size_t offset)
+{
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t end = (offset < length ? offset : length) & ~(pageSize - 1);
+
+    if (!mapped || end <= released)
+        return;
+
+    madvise((void *) (data + released), end - released, MADV_DONTNEED);
+    released = end;
+}
+
+/*
+ Returns a pointer to the first byte of the source.
+ */
+const char *SourceFile::begin()
+{
+    return data;
+}
+
+/*
+ Returns a pointer one past the last byte of the source.
+ */
+const char *SourceFile::end()
+{
+    return data + length;
+}
+
+/*
+ Returns the number of bytes in the source.
+ */
+size_t SourceFile::size()
+{
+    return length;
+}
+
+/*
+ Determines whether a source has been opened successfully.
+ */
+bool SourceFile::isOpen()
+{
+    return opened;
+}
+
+/*
+ Determines whether the source is backed by a memory mapping.
+ */
+bool SourceFile::isMapped()
+{
+    return mapped;
+}
+
+/*
+ Determines whether two files exist and hold exactly the same bytes.
+ */
+bool SourceFile::sameContents(string fileName, string otherFileName)
+{
+    const size_t CHUNK = 64 * 1024;
+    vector<char> block(CHUNK);
+    vector<char> otherBlock(CHUNK);
+    struct stat info;
+    struct stat otherInfo;
+    int fd;
+    int otherFd;
+    bool same;
+    ssize_t count = 0;
+
+    if (stat(fileName.c_str(), &info) != 0 ||
+        stat(otherFileName.c_str(), &otherInfo) != 0 ||
+        info.st_size != otherInfo.st_size)
+    {
+        return false;
+    }
+
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    otherFd = ::open(otherFileName.c_str(), O_RDONLY);
+
+    // Compared a block at a time, so that large outputs are not held in
+    // memory
+    same = (fd >= 0 && otherFd >= 0);
+    while (same && (count = readBlock(fd, &block[0], CHUNK)) > 0)
+    {
+        same = (readBlock(otherFd, &otherBlock[0], CHUNK) == count &&
+                memcmp(&block[0], &otherBlock[0], (size_t) count) == 0);
+    }
+    if (same && (count < 0 || readBlock(otherFd, &otherBlock[0], 1) != 0))
+        same = false;
+
+    if (fd >= 0)
+        ::close(fd);
+    if (otherFd >= 0)
+        ::close(otherFd);
+    return same;
+}
+
+/*
+ Reads up to size bytes, stopping short only at the end of the file.
+ Returns the number read, or -1 on an error.
+ */
+ssize_t SourceFile::readBlock(int fd, char *block, size_t size)
+{
+    size_t done = 0;
+    ssize_t count;
+
+    while (done < size)
+    {
+        count = read(fd, block + done, size - done);
+        if (count < 0)
+            return -1;
+        if (count == 0)
+            break;
+        done += (size_t) count;
+    }
+    return (ssize_t) done;
+}
@@ -0,0 +1,55 @@
+/*
+ SourceFile.hpp
+ CodeGenerator
+
+ Provides read-only access to the bytes of a .jack source file. Regular files
+ are memory-mapped so the tokenizer can scan them in place; standard input and
+ other streams that cannot be mapped are read into an owned buffer instead.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef SourceFile_hpp
+#define SourceFile_hpp
+
+#include <iostream>
+#include <vector>
+#include <sys/types.h>
+
+using std::string;
+using std::vector;
+
+class SourceFile
+{
+private:
+    const char *data;
+    size_t length;
+    bool opened;
+    bool mapped;
+    size_t released;
+    vector<char> buffer;
+
+private:
+    bool mapFile(int fd);
+    bool readStream(int fd);
+    static ssize_t readBlock(int fd, char *block, size_t size);
+
+public:
+    SourceFile();
+    ~SourceFile();
+    bool open(string fileName);
+    void close();
+    void release(size_t offset);
+    const char *begin();
+    const char *end();
+    size_t size();
+    bool isOpen();
+    bool isMapped();
+    static bool sameContents(string fileName, string otherFileName);
+
+private:
+    SourceFile(const SourceFile &);
+    SourceFile &operator=(const SourceFile &);
+};
+
+#endif /* SourceFile_hpp */
@@ -0,0 +1,130 @@
+/*
+ SymbolTable.cpp
+ CodeGenerator
+
+ The variables in scope while a class is compiled to VM code: the class's
+ static and field variables, and the current subroutine's arguments and
+ locals. Variables are looked up by their interned name from the SyntaxTree,
+ so every lookup is an array index rather than a string compare.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "SymbolTable.hpp"
+
+/*
+ Starts with both scopes empty.
+ */
+SymbolTable::SymbolTable()
+{
+    startClass();
+}
+
+/*
+ Empties both scopes, ready for a new class.
+ */
+void SymbolTable::startClass()
+{
+    classScope.clear();
+    subroutineScope.clear();
+    subroutineNames.clear();
+
+    for (int kind = 0; kind <= VAR_LOCAL; kind++)
+        counts[kind] = 0;
+}
+
+/*
+ Empties the subroutine scope, ready for a new subroutine.
+ */
+void SymbolTable::startSubroutine()
+{
+    for (size_t i = 0; i < subroutineNames.size(); i++)
+        subroutineScope[subroutineNames[i]].kind = VAR_NONE;
+
+    subroutineNames.clear();
+    counts[VAR_ARGUMENT] = 0;
+    counts[VAR_LOCAL] = 0;
+}
+
+/*
+ Defines a variable of the given type and kind, giving it the next index of
+ its kind. Statics and fields go in the class scope, arguments and locals in
+ the subroutine scope. Returns false if the name is already defined in that
+ scope.
+ */
+bool SymbolTable::define(int name, int type, int kind)
+{
+    bool inClass = (kind == VAR_STATIC || kind == VAR_FIELD);
+    vector<Symbol> &scope = inClass ? classScope : subroutineScope;
+    Symbol none = { VAR_NONE, -1, -1 };
+
+    if ((int) scope.size() <= name)
+        scope.resize(name + 1, none);
+
+    if (scope[name].kind != VAR_NONE)
+        return false;
+
+    scope[name].kind = kind;
+    scope[name].type = type;
+    scope[name].index = counts[kind]++;
+
+    if (!inClass)
+        subroutineNames.push_back(name);
+
+    return true;
+}
+
+/*
+ Finds a variable, looking in the subroutine scope first.
+ */
+const SymbolTable::Symbol *SymbolTable::find(int name)
+{
+    if (name < (int) subroutineScope.size() &&
+        subroutineScope[name].kind != VAR_NONE)
+    {
+        return &subroutineScope[name];
+    }
+
+    if (name < (int) classScope.size() && classScope[name].kind != VAR_NONE)
+        return &classScope[name];
+
+    return NULL;
+}
+
+/*
+ Returns the kind of a variable, or VAR_NONE if it is not defined.
+ */
+int SymbolTable::kindOf(int name)
+{
+    const Symbol *symbol = find(name);
+
+    return (symbol != NULL) ? symbol->kind : VAR_NONE;
+}
+
+/*
+ Returns the interned name of a variable's type.
+ */
+int SymbolTable::typeOf(int name)
+{
+    const Symbol *symbol = find(name);
+
+    return (symbol != NULL) ? symbol->type : -1;
+}
+
+/*
+ Returns a variable's index within its segment.
+ */
+int SymbolTable::indexOf(int name)
+{
+    const Symbol *symbol = find(name);
+
+    return (symbol != NULL) ? symbol->index : -1;
+}
+
+/*
+ Returns the number of variables of a kind defined so far in its scope.
+ */
+int SymbolTable::varCount(int kind)
+{
+    return counts[kind];
+}
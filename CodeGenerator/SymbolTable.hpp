@@ -0,0 +1,55 @@
+/*
+ SymbolTable.hpp
+ CodeGenerator
+
+ The variables in scope while a class is compiled to VM code: the class's
+ static and field variables, and the current subroutine's arguments and
+ locals. Variables are looked up by their interned name from the SyntaxTree,
+ so every lookup is an array index rather than a string compare.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef SymbolTable_hpp
+#define SymbolTable_hpp
+
+#include <cstddef>
+#include <vector>
+
+using std::vector;
+
+enum VarKind
+{
+    VAR_NONE = 0, VAR_STATIC, VAR_FIELD, VAR_ARGUMENT, VAR_LOCAL
+};
+
+class SymbolTable
+{
+private:
+    struct Symbol
+    {
+        int kind;
+        int type;
+        int index;
+    };
+
+    vector<Symbol> classScope;
+    vector<Symbol> subroutineScope;
+    vector<int> subroutineNames;
+    int counts[VAR_LOCAL + 1];
+
+private:
+    const Symbol *find(int name);
+
+public:
+    SymbolTable();
+    void startClass();
+    void startSubroutine();
+    bool define(int name, int type, int kind);
+    int kindOf(int name);
+    int typeOf(int name);
+    int indexOf(int name);
+    int varCount(int kind);
+};
+
+#endif /* SymbolTable_hpp */
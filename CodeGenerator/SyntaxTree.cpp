@@ -0,0 +1,343 @@
+/*
+ SyntaxTree.cpp
+ CodeGenerator
+
+ The parse tree of one class, built by the CompilationEngine and read by the
+ back ends. Nodes are fixed-size records kept in a single array and referred
+ to by index; a node's children are a contiguous range of a second index
+ array. Identifiers and constants are interned, so a node holds a small name
+ number instead of text. Everything lives in one Arena, so building the tree
+ takes no allocation per node and the whole tree is freed at once.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "SyntaxTree.hpp"
+#include <algorithm>
+
+/*
+ XML tag of each node kind, indexed by NodeKind.
+ */
+static const char *kindName[] =
+{
+    "", "keyword", "symbol", "identifier", "integerConstant", "stringConstant",
+    "error", "class", "classVarDec", "subroutineDec", "parameterList",
+    "subroutineBody", "varDec", "statements", "letStatement", "ifStatement",
+    "whileStatement", "doStatement", "returnStatement", "expression", "term",
+    "expressionList"
+};
+
+static const int KIND_COUNT = sizeof(kindName) / sizeof(kindName[0]);
+
+/*
+ Starts with an empty tree.
+ */
+SyntaxTree::SyntaxTree()
+{
+    nameTable = NULL;
+    clear();
+}
+
+/*
+ Makes the tree take its names from a NameTable shared by the build, so
+ they are numbered the same as the tokenizer's. Call it before adding
+ nodes.
+ */
+void SyntaxTree::setNameTable(NameTable *table)
+{
+    nameTable = table;
+}
+
+/*
+ Frees the whole tree and its names in one go, leaving an empty tree.
+ */
+void SyntaxTree::clear()
+{
+    arena.release();
+
+    nodeCount = 0;
+    nodeCapacity = 1024;
+    nodes = arena.allocateArray<SyntaxNode>(nodeCapacity);
+    childCount = 0;
+    childCapacity = 1024;
+    children = arena.allocateArray<unsigned int>(childCapacity);
+    stackSize = 0;
+    stackCapacity = 256;
+    stack = arena.allocateArray<unsigned int>(stackCapacity);
+    depth = 0;
+    markCapacity = 64;
+    marks = arena.allocateArray<unsigned int>(markCapacity);
+    nameCount = 0;
+    nameCapacity = 256;
+    names = arena.allocateArray<Name>(nameCapacity);
+    slotMask = 511;
+    slots = arena.allocateArray<unsigned int>(slotMask + 1);
+    memset(slots, 0, (slotMask + 1) * sizeof(unsigned int));
+}
+
+/*
+ Starts a nonterminal. Nodes added until the matching endNode() become its
+ children.
+ */
+void SyntaxTree::beginNode()
+{
+    if (depth == markCapacity)
+        grow(marks, markCapacity, depth);
+    marks[depth++] = stackSize;
+}
+
+/*
+ Finishes the nonterminal started by the matching beginNode(). Its children
+ are moved off the stack of unfinished nodes into one range of the child
+ array. Returns the new node.
+ */
+int SyntaxTree::endNode(int kind)
+{
+    return wrapNode((depth > 0) ? (int) marks[--depth] : 0, kind);
+}
+
+/*
+ Returns a mark for the next node to be added at the current level. Passing
+ it to wrapNode() later makes that node and the ones after it children of a
+ new nonterminal, for a parser that only learns it needed one afterwards.
+ */
+int SyntaxTree::getMark()
+{
+    return (int) stackSize;
+}
+
+/*
+ Makes the nodes added at the current level since a mark the children of a
+ new nonterminal. Returns the new node.
+ */
+int SyntaxTree::wrapNode(int mark, int kind)
+{
+    unsigned int count = stackSize - (unsigned int) mark;
+    unsigned int node;
+
+    while (childCapacity - childCount < count)
+        grow(children, childCapacity, childCount);
+
+    if (count > 0)
+        memcpy(children + childCount, stack + mark,
+               count * sizeof(unsigned int));
+    stackSize = (unsigned int) mark;
+
+    node = addNode(kind, 0, 0);
+    nodes[node].first = childCount;
+    nodes[node].count = count;
+    childCount += count;
+
+    return (int) node;
+}
+
+/*
+ Adds a keyword or symbol, identified by its tokenizer code.
+ */
+int SyntaxTree::addTerminal(int kind, int code)
+{
+    return (int) addNode(kind, code, 0);
+}
+
+/*
+ Adds an identifier, constant or error, interning its text.
+ */
+int SyntaxTree::addTerminal(int kind, const char *text, size_t length)
+{
+    return (int) addNode(kind, 0, (unsigned int) intern(text, length));
+}
+
+/*
+ Adds an identifier or constant whose name was numbered already.
+ */
+int SyntaxTree::addName(int kind, int name)
+{
+    return (int) addNode(kind, 0, (unsigned int) name);
+}
+
+/*
+ Adds a node with no children and pushes it as a child of the innermost
+ unfinished nonterminal.
+ */
+unsigned int SyntaxTree::addNode(int kind, int code, unsigned int name)
+{
+    SyntaxNode *node;
+
+    if (nodeCount == nodeCapacity)
+        grow(nodes, nodeCapacity, nodeCount);
+    if (stackSize == stackCapacity)
+        grow(stack, stackCapacity, stackSize);
+
+    node = &nodes[nodeCount];
+    node->kind = (unsigned char) kind;
+    node->code = (unsigned char) code;
+    node->name = name;
+    node->first = 0;
+    node->count = 0;
+
+    stack[stackSize++] = nodeCount;
+    return nodeCount++;
+}
+
+/*
+ Returns the last node finished at the outermost level, which is the class
+ once it has been parsed, or -1 if the tree is empty.
+ */
+int SyntaxTree::getRoot()
+{
+    return (stackSize > 0) ? (int) stack[stackSize - 1] : -1;
+}
+
+/*
+ Exchanges the contents of two trees, nodes, names and unfinished
+ nonterminals alike, so a tree that is partly built can be handed off and
+ building carried on in another.
+ */
+void SyntaxTree::swap(SyntaxTree &other)
+{
+    arena.swap(other.arena);
+    std::swap(nodes, other.nodes);
+    std::swap(nodeCount, other.nodeCount);
+    std::swap(nodeCapacity, other.nodeCapacity);
+    std::swap(children, other.children);
+    std::swap(childCount, other.childCount);
+    std::swap(childCapacity, other.childCapacity);
+    std::swap(stack, other.stack);
+    std::swap(stackSize, other.stackSize);
+    std::swap(stackCapacity, other.stackCapacity);
+    std::swap(marks, other.marks);
+    std::swap(depth, other.depth);
+    std::swap(markCapacity, other.markCapacity);
+    std::swap(names, other.names);
+    std::swap(nameCount, other.nameCount);
+    std::swap(nameCapacity, other.nameCapacity);
+    std::swap(slots, other.slots);
+    std::swap(slotMask, other.slotMask);
+    std::swap(nameTable, other.nameTable);
+}
+
+/*
+ Returns the number of nodes in the tree.
+ */
+int SyntaxTree::getNodeCount()
+{
+    return (int) nodeCount;
+}
+
+/*
+ Returns the number of bytes the tree has taken from the general heap.
+ */
+size_t SyntaxTree::getBytesAllocated()
+{
+    return arena.getBytesAllocated();
+}
+
+/*
+ Returns the name of a piece of text, adding it if it is new. Equal text
+ always gets the same name, so names can be compared as numbers.
+ */
+int SyntaxTree::intern(const char *text, size_t length)
+{
+    unsigned int hash = 2166136261u;
+    unsigned int slot;
+    char *copy;
+
+    if (nameTable != NULL)
+        return nameTable->intern(text, length);
+
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char) text[i]) * 16777619u;
+
+    for (slot = hash & slotMask; slots[slot] != 0; slot = (slot + 1) & slotMask)
+    {
+        Name &name = names[slots[slot] - 1];
+
+        if (name.hash == hash && name.length == length &&
+            memcmp(name.text, text, length) == 0)
+        {
+            return (int) slots[slot] - 1;
+        }
+    }
+
+    if (nameCount == nameCapacity)
+        grow(names, nameCapacity, nameCount);
+
+    copy = arena.allocateArray<char>(length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+
+    names[nameCount].text = copy;
+    names[nameCount].length = (unsigned int) length;
+    names[nameCount].hash = hash;
+    slots[slot] = ++nameCount;
+
+    if (nameCount * 2 > slotMask)
+        rehash();
+
+    return (int) nameCount - 1;
+}
+
+/*
+ Doubles the table of name slots once it is half full.
+ */
+void SyntaxTree::rehash()
+{
+    unsigned int slot;
+
+    slotMask = slotMask * 2 + 1;
+    slots = arena.allocateArray<unsigned int>(slotMask + 1);
+    memset(slots, 0, (slotMask + 1) * sizeof(unsigned int));
+
+    for (unsigned int i = 0; i < nameCount; i++)
+    {
+        for (slot = names[i].hash & slotMask; slots[slot] != 0;
+             slot = (slot + 1) & slotMask)
+        {
+        }
+        slots[slot] = i + 1;
+    }
+}
+
+/*
+ Returns the number of distinct names.
+ */
+int SyntaxTree::getNameCount()
+{
+    if (nameTable != NULL)
+        return nameTable->getCount();
+
+    return (int) nameCount;
+}
+
+/*
+ Returns the text of a name, terminated by a null character.
+ */
+const char *SyntaxTree::getNameText(int name)
+{
+    if (nameTable != NULL)
+        return nameTable->getText(name);
+
+    return names[name].text;
+}
+
+/*
+ Returns the length of the text of a name.
+ */
+size_t SyntaxTree::getNameLength(int name)
+{
+    if (nameTable != NULL)
+        return nameTable->getLength(name);
+
+    return names[name].length;
+}
+
+/*
+ Returns the XML tag a node kind is written as.
+ */
+const char *SyntaxTree::getKindName(int kind)
+{
+    if (kind < 1 || kind >= KIND_COUNT)
+        return "";
+
+    return kindName[kind];
+}
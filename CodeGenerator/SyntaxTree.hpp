@@ -0,0 +1,158 @@
+/*
+ SyntaxTree.hpp
+ CodeGenerator
+
+ The parse tree of one class, built by the CompilationEngine and read by the
+ back ends. Nodes are fixed-size records kept in a single array and referred
+ to by index; a node's children are a contiguous range of a second index
+ array. Identifiers and constants are interned, so a node holds a small name
+ number instead of text. The names are the tree's own unless it is given
+ the NameTable of the build, in which case it uses that table's numbers.
+ Everything else lives in one Arena, so building the tree takes no
+ allocation per node and the whole tree is freed at once.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef SyntaxTree_hpp
+#define SyntaxTree_hpp
+
+#include <cstring>
+#include "Arena.hpp"
+#include "NameTable.hpp"
+
+/*
+ The kinds of node. Terminals come first; the rest correspond to the rules of
+ the Jack grammar and are named after the XML tags they are written as.
+ */
+enum NodeKind
+{
+    N_KEYWORD = 1, N_SYMBOL, N_IDENTIFIER, N_INT_CONST, N_STRING_CONST,
+    N_ERROR, N_CLASS, N_CLASS_VAR_DEC, N_SUBROUTINE_DEC, N_PARAMETER_LIST,
+    N_SUBROUTINE_BODY, N_VAR_DEC, N_STATEMENTS, N_LET_STATEMENT,
+    N_IF_STATEMENT, N_WHILE_STATEMENT, N_DO_STATEMENT, N_RETURN_STATEMENT,
+    N_EXPRESSION, N_TERM, N_EXPRESSION_LIST
+};
+
+/*
+ One node of the tree. Keywords and symbols keep their code from the
+ tokenizer; identifiers, constants and errors keep their interned name.
+ Children are children[first] to children[first + count - 1].
+ */
+struct SyntaxNode
+{
+    unsigned char kind;
+    unsigned char code;
+    unsigned int name;
+    unsigned int first;
+    unsigned int count;
+};
+
+class SyntaxTree
+{
+private:
+    struct Name
+    {
+        const char *text;
+        unsigned int length;
+        unsigned int hash;
+    };
+
+    Arena arena;
+    SyntaxNode *nodes;
+    unsigned int nodeCount;
+    unsigned int nodeCapacity;
+    unsigned int *children;
+    unsigned int childCount;
+    unsigned int childCapacity;
+    unsigned int *stack;
+    unsigned int stackSize;
+    unsigned int stackCapacity;
+    unsigned int *marks;
+    unsigned int depth;
+    unsigned int markCapacity;
+    Name *names;
+    unsigned int nameCount;
+    unsigned int nameCapacity;
+    unsigned int *slots;
+    unsigned int slotMask;
+    NameTable *nameTable;
+
+private:
+    unsigned int addNode(int kind, int code, unsigned int name);
+    void rehash();
+
+    /*
+     Doubles an array allocated from the arena. The old copy is left in the
+     arena until the tree is cleared.
+     */
+    template <typename T>
+    void grow(T *&array, unsigned int &capacity, unsigned int used)
+    {
+        T *bigger = arena.allocateArray<T>(capacity * 2);
+
+        if (used > 0)
+            memcpy(bigger, array, used * sizeof(T));
+        array = bigger;
+        capacity *= 2;
+    }
+
+public:
+    SyntaxTree();
+    void clear();
+    void swap(SyntaxTree &other);
+    void setNameTable(NameTable *table);
+    void beginNode();
+    int endNode(int kind);
+    int getMark();
+    int wrapNode(int mark, int kind);
+    int addTerminal(int kind, int code);
+    int addTerminal(int kind, const char *text, size_t length);
+    int addName(int kind, int name);
+    int getRoot();
+    int getNodeCount();
+    size_t getBytesAllocated();
+    int intern(const char *text, size_t length);
+    int getNameCount();
+    const char *getNameText(int name);
+    size_t getNameLength(int name);
+    static const char *getKindName(int kind);
+
+    /*
+     Returns a node by index.
+     */
+    const SyntaxNode &getNode(int node)
+    {
+        return nodes[node];
+    }
+
+    /*
+     Returns the number of children of a node.
+     */
+    int getChildCount(int node)
+    {
+        return (int) nodes[node].count;
+    }
+
+    /*
+     Returns the index of the i'th child of a node.
+     */
+    int getChild(int node, int i)
+    {
+        return (int) children[nodes[node].first + i];
+    }
+
+    /*
+     Determines whether a node kind is a terminal.
+     */
+    static bool isTerminal(int kind)
+    {
+        return (kind >= N_KEYWORD && kind <= N_ERROR);
+    }
+
+private:
+    SyntaxTree(const SyntaxTree &);
+    SyntaxTree &operator=(const SyntaxTree &);
+};
+
+#endif /* SyntaxTree_hpp */
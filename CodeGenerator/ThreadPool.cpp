@@ -0,0 +1,160 @@
+/*
+ ThreadPool.cpp
+ CodeGenerator
+
+ A fixed set of worker threads that run independent tasks. Each worker has
+ its own queue of tasks: it takes new work from the back of its own queue, and
+ when that runs dry it steals from the front of the other workers' queues, so
+ no worker sits idle while there is work queued anywhere.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "ThreadPool.hpp"
+
+/*
+ Starts the worker threads, each with an empty queue.
+ */
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount < 1)
+        threadCount = 1;
+
+    queued = 0;
+    pending = 0;
+    stopping = false;
+    nextQueue = 0;
+
+    for (int i = 0; i < threadCount; i++)
+        queues.push_back(new WorkQueue);
+
+    for (int i = 0; i < threadCount; i++)
+        threads.push_back(std::thread(&ThreadPool::run, this, i));
+}
+
+/*
+ Finishes the queued tasks, then stops and joins the worker threads.
+ */
+ThreadPool::~ThreadPool()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    for (size_t i = 0; i < queues.size(); i++)
+        delete queues[i];
+}
+
+/*
+ Queues a task. Tasks are dealt out to the workers' queues in turn.
+ */
+void ThreadPool::submit(std::function<void()> task)
+{
+    WorkQueue *queue = queues[nextQueue++ % queues.size()];
+
+    pending++;
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+/*
+ Blocks until every submitted task has finished.
+ */
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> guard(idleLock);
+    done.wait(guard, [this] { return pending == 0; });
+}
+
+/*
+ Returns the number of worker threads.
+ */
+int ThreadPool::getThreadCount()
+{
+    return (int) threads.size();
+}
+
+/*
+ Returns one thread per hardware thread, or 1 if that is unknown.
+ */
+int ThreadPool::defaultThreadCount()
+{
+    unsigned int count = std::thread::hardware_concurrency();
+    return (count == 0) ? 1 : (int) count;
+}
+
+/*
+ Takes a task for a worker: the newest task on its own queue, or failing
+ that the oldest task on another worker's queue.
+ */
+bool ThreadPool::takeTask(int index, std::function<void()> &task)
+{
+    size_t count = queues.size();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        WorkQueue *queue = queues[(index + i) % count];
+        std::lock_guard<std::mutex> guard(queue->lock);
+
+        if (queue->tasks.empty())
+            continue;
+
+        if (i == 0)
+        {
+            task = queue->tasks.back();
+            queue->tasks.pop_back();
+        }
+        else
+        {
+            task = queue->tasks.front();
+            queue->tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ Worker loop: runs tasks while there are any, and sleeps when there are none.
+ */
+void ThreadPool::run(int index)
+{
+    std::function<void()> task;
+
+    for (;;)
+    {
+        if (takeTask(index, task))
+        {
+            task();
+            task = nullptr;
+
+            if (--pending == 0)
+            {
+                std::lock_guard<std::mutex> guard(idleLock);
+                done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(idleLock);
+        wake.wait(guard, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+            return;
+    }
+}
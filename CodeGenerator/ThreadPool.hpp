@@ -0,0 +1,62 @@
+/*
+ ThreadPool.hpp
+ CodeGenerator
+
+ A fixed set of worker threads that run independent tasks. Each worker has
+ its own queue of tasks: it takes new work from the back of its own queue, and
+ when that runs dry it steals from the front of the other workers' queues, so
+ no worker sits idle while there is work queued anywhere.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+class ThreadPool
+{
+private:
+    struct WorkQueue
+    {
+        std::mutex lock;
+        std::deque< std::function<void()> > tasks;
+    };
+
+    vector<WorkQueue *> queues;
+    vector<std::thread> threads;
+    std::mutex idleLock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::atomic<int> queued;
+    std::atomic<int> pending;
+    bool stopping;
+    unsigned int nextQueue;
+
+private:
+    void run(int index);
+    bool takeTask(int index, std::function<void()> &task);
+
+public:
+    ThreadPool(int threadCount);
+    ~ThreadPool();
+    void submit(std::function<void()> task);
+    void wait();
+    int getThreadCount();
+    static int defaultThreadCount();
+
+private:
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+};
+
+#endif /* ThreadPool_hpp */
@@ -0,0 +1,246 @@
+/*
+ TokenCache.cpp
+ CodeGenerator
+
+ Saves the token table JackTokenizer builds for a source file, so that the
+ next compile of an unchanged file can map the table back in instead of
+ scanning the source again. Each entry records a hash of the source it was
+ made from and is ignored once the source changes. Entries are written
+ beside the sources, or into a directory of their own.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "TokenCache.hpp"
+#include "BuildCache.hpp"
+#include "OutputFile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+
+/*
+ Part of every source hash, and written into every entry. Change it
+ whenever the tokenizer or the entry layout changes.
+ */
+static const char *const TOKEN_FORMAT = "CodeGenerator tokens 1";
+static const unsigned int TOKEN_VERSION = 1;
+
+/*
+ Uses the directory for entries, creating it if needed. An empty directory
+ puts each entry beside its source instead.
+ */
+TokenCache::TokenCache(string directory)
+{
+    struct stat info;
+
+    this->directory = directory;
+    seed = BuildCache::hash(TOKEN_FORMAT, strlen(TOKEN_FORMAT), 0);
+    hits = 0;
+    misses = 0;
+
+    if (directory.empty())
+        usable = true;
+    else if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        usable = false;
+    else
+        usable = (stat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode));
+}
+
+/*
+ Determines whether the cache directory exists and can be used.
+ */
+bool TokenCache::isUsable()
+{
+    return usable;
+}
+
+/*
+ Returns the hash of a source's contents that its entry is checked against.
+ */
+unsigned long long TokenCache::makeKey(const char *data, size_t length)
+{
+    return BuildCache::hash(data, length, seed);
+}
+
+/*
+ Returns the path of the entry for a source: the source's name with a .tok
+ extension (Pong/Ball.jack has Pong/Ball.tok), or the key in the cache
+ directory.
+ */
+string TokenCache::getEntryName(string sourceName, unsigned long long key)
+{
+    size_t nameStart = sourceName.find_last_of('/') + 1;
+    char name[32];
+
+    if (directory.empty())
+    {
+        return sourceName.substr(0, sourceName.find('.', nameStart)) +
+               ".tok";
+    }
+
+    snprintf(name, sizeof(name), "/%016llx.tok", key);
+    return directory + name;
+}
+
+/*
+ Determines whether a header belongs to an entry of this format and its
+ size matches the file's.
+ */
+bool TokenCache::isValid(const Header &header, size_t size)
+{
+    unsigned long long expected = sizeof(Header) +
+        (unsigned long long) header.tokenCount * 10 + header.poolSize;
+
+    return (memcmp(header.magic, "JTOK", 4) == 0 &&
+            header.version == TOKEN_VERSION && header.tokenCount > 0 &&
+            expected == size);
+}
+
+/*
+ Maps the entry for a source into entry and has the tokenizer use the table
+ in it. The table is read straight from the mapping, so entry must stay open
+ for as long as the tokenizer is used. Returns false, leaving the tokenizer
+ alone, if there is no entry or it was made from other contents than the key
+ and size describe.
+ */
+bool TokenCache::load(string sourceName, unsigned long long key,
+                      size_t sourceSize, SourceFile &entry,
+                      JackTokenizer &tokenizer)
+{
+    Header header;
+    const unsigned int *offsets;
+    const unsigned int *lengths;
+    const unsigned char *types;
+    const unsigned char *codes;
+    const char *pool;
+    int count;
+
+    if (!usable || !entry.open(getEntryName(sourceName, key)) ||
+        entry.size() < sizeof(Header))
+    {
+        misses++;
+        return false;
+    }
+
+    memcpy(&header, entry.begin(), sizeof(Header));
+    if (!isValid(header, entry.size()) || header.sourceHash != key ||
+        header.sourceSize != sourceSize)
+    {
+        entry.close();
+        misses++;
+        return false;
+    }
+
+    count = (int) header.tokenCount;
+    offsets = (const unsigned int *) (entry.begin() + sizeof(Header));
+    lengths = offsets + count;
+    types = (const unsigned char *) (lengths + count);
+    codes = types + count;
+    pool = (const char *) (codes + count);
+
+    // A damaged entry must not send the parser outside the pool, or give a
+    // token a keyword or symbol that does not exist
+    for (int i = 0; i < count; i++)
+    {
+        int highest = (types[i] == T_KEYWORD) ? K_THIS :
+                      (types[i] == T_SYMBOL) ? S_TILDE : 0;
+        int lowest = (highest > 0) ? 1 : 0;
+
+        if (types[i] > T_STRING_CONST || offsets[i] > header.poolSize ||
+            lengths[i] > header.poolSize - offsets[i] ||
+            codes[i] < lowest || codes[i] > highest)
+        {
+            entry.close();
+            misses++;
+            return false;
+        }
+    }
+    if (types[count - 1] != T_NONE)
+    {
+        entry.close();
+        misses++;
+        return false;
+    }
+
+    tokenizer.load(types, codes, offsets, lengths, pool, count);
+    hits++;
+    return true;
+}
+
+/*
+ Writes the entry for a source that was just tokenized. Each distinct token
+ text is stored once in the pool. Returns false if the entry could not be
+ written.
+ */
+bool TokenCache::store(string sourceName, unsigned long long key,
+                       size_t sourceSize, JackTokenizer &tokenizer)
+{
+    TokenCursor tc = tokenizer.cursor();
+    int count = tokenizer.getTokenCount() + 1;
+    std::unordered_map<string, unsigned int> pooled;
+    std::vector<unsigned int> offsets(count);
+    std::vector<unsigned int> lengths(count);
+    std::vector<unsigned char> types(count);
+    std::vector<unsigned char> codes(count);
+    string pool;
+    Header header;
+    OutputFile out;
+
+    if (!usable)
+        return false;
+
+    for (int i = 0; i < count; i++, tc.advance())
+    {
+        string text = tc.token();
+        std::unordered_map<string, unsigned int>::iterator it =
+            pooled.find(text);
+
+        if (it == pooled.end())
+        {
+            it = pooled.insert(std::make_pair(text,
+                                              (unsigned int) pool.size())).first;
+            pool += text;
+        }
+        types[i] = (unsigned char) tc.tokenType();
+        codes[i] = (unsigned char) (tc.keyword() | tc.symbol());
+        offsets[i] = it->second;
+        lengths[i] = (unsigned int) text.length();
+    }
+
+    memcpy(header.magic, "JTOK", 4);
+    header.version = TOKEN_VERSION;
+    header.sourceHash = key;
+    header.sourceSize = sourceSize;
+    header.tokenCount = (unsigned int) count;
+    header.poolSize = (unsigned int) pool.size();
+
+    if (!out.open(getEntryName(sourceName, key)))
+        return false;
+
+    out.append((const char *) &header, sizeof(Header));
+    out.append((const char *) &offsets[0], count * sizeof(unsigned int));
+    out.append((const char *) &lengths[0], count * sizeof(unsigned int));
+    out.append((const char *) &types[0], count);
+    out.append((const char *) &codes[0], count);
+    out.append(pool.data(), pool.size());
+    return out.close();
+}
+
+/*
+ Returns the number of sources whose tokens were loaded from the cache.
+ */
+int TokenCache::getHits()
+{
+    return hits;
+}
+
+/*
+ Returns the number of sources that had to be tokenized.
+ */
+int TokenCache::getMisses()
+{
+    return misses;
+}
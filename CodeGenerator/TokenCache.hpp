@@ -0,0 +1,80 @@
+/*
+ TokenCache.hpp
+ CodeGenerator
+
+ Saves the token table JackTokenizer builds for a source file, so that the
+ next compile of an unchanged file can map the table back in instead of
+ scanning the source again. Each entry records a hash of the source it was
+ made from and is ignored once the source changes. Entries are written
+ beside the sources, or into a directory of their own.
+
+ An entry is a header followed by the table's four columns and a pool of
+ the distinct token texts:
+
+   magic "JTOK", format version, source hash, source size,
+   token count (with the sentinel), pool size     32 bytes
+   offset of each token's text in the pool        4 bytes per token
+   length of each token's text                    4 bytes per token
+   TokenType of each token                        1 byte per token
+   Keyword or Symbol code of each token           1 byte per token
+   pool                                           pool size bytes
+
+ Numbers are in the byte order of the machine that wrote them; an entry
+ from a machine of the other order fails the magic check and is rewritten.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef TokenCache_hpp
+#define TokenCache_hpp
+
+#include <iostream>
+#include <atomic>
+#include "JackTokenizer.hpp"
+#include "SourceFile.hpp"
+
+using std::string;
+
+class TokenCache
+{
+private:
+    /*
+     The header at the start of every entry.
+     */
+    struct Header
+    {
+        char magic[4];
+        unsigned int version;
+        unsigned long long sourceHash;
+        unsigned long long sourceSize;
+        unsigned int tokenCount;
+        unsigned int poolSize;
+    };
+
+    string directory;
+    unsigned long long seed;
+    bool usable;
+    std::atomic<int> hits;
+    std::atomic<int> misses;
+
+private:
+    string getEntryName(string sourceName, unsigned long long key);
+    static bool isValid(const Header &header, size_t size);
+
+public:
+    TokenCache(string directory);
+    bool isUsable();
+    unsigned long long makeKey(const char *data, size_t length);
+    bool load(string sourceName, unsigned long long key, size_t sourceSize,
+              SourceFile &entry, JackTokenizer &tokenizer);
+    bool store(string sourceName, unsigned long long key, size_t sourceSize,
+               JackTokenizer &tokenizer);
+    int getHits();
+    int getMisses();
+
+private:
+    TokenCache(const TokenCache &);
+    TokenCache &operator=(const TokenCache &);
+};
+
+#endif /* TokenCache_hpp */
@@ -0,0 +1,160 @@
+/*
+ TreeReader.cpp
+ CodeGenerator
+
+ Reads the binary parse trees written by TreeWriter. A tree file is mapped
+ into memory and used where it lies: tools walk the node array directly
+ instead of parsing XML.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "TreeReader.hpp"
+
+/*
+ Starts with no tree open.
+ */
+TreeReader::TreeReader()
+{
+    nodes = NULL;
+    strings = NULL;
+    bytes = NULL;
+    nodeCount = 0;
+    stringCount = 0;
+}
+
+/*
+ Maps a tree file and checks that every node and string lies inside it and
+ that the nodes form one tree, so walking it can never leave the mapping.
+ Returns false if the file cannot be read or is not a tree file.
+ */
+bool TreeReader::open(string fileName)
+{
+    TreeHeader header;
+    const char *data;
+
+    close();
+
+    if (!file.open(fileName) || file.size() < sizeof(TreeHeader))
+    {
+        close();
+        return false;
+    }
+
+    data = file.begin();
+    memcpy(&header, data, sizeof(TreeHeader));
+    if (!isValid(header, file.size()))
+    {
+        close();
+        return false;
+    }
+
+    nodes = (const TreeNode *) (data + sizeof(TreeHeader));
+    strings = (const TreeString *) (nodes + header.nodeCount);
+    bytes = (const char *) (strings + header.stringCount);
+    nodeCount = (int) header.nodeCount;
+    stringCount = (int) header.stringCount;
+
+    for (unsigned int i = 0; i < header.stringCount; i++)
+    {
+        if (strings[i].offset >= header.stringBytes ||
+            strings[i].length >= header.stringBytes - strings[i].offset ||
+            bytes[strings[i].offset + strings[i].length] != '\0')
+        {
+            close();
+            return false;
+        }
+    }
+
+    if (nodeCount > 0 && getEnd(0) != nodeCount)
+    {
+        close();
+        return false;
+    }
+    for (int i = 0; i < nodeCount; i++)
+    {
+        if (!isValidNode(i))
+        {
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ Determines whether a header belongs to a tree file of this version and
+ the sizes it gives add up to the file's.
+ */
+bool TreeReader::isValid(const TreeHeader &header, size_t size)
+{
+    unsigned long long expected = sizeof(TreeHeader) +
+        (unsigned long long) header.nodeCount * sizeof(TreeNode) +
+        (unsigned long long) header.stringCount * sizeof(TreeString) +
+        header.stringBytes;
+
+    return (memcmp(header.magic, "JTRE", 4) == 0 &&
+            header.version == TREE_VERSION && expected == size);
+}
+
+/*
+ Checks one node: its kind and text, and that its children, stepped through
+ by their ends, exactly fill the range up to its own end.
+ */
+bool TreeReader::isValidNode(int node)
+{
+    const TreeNode &n = nodes[node];
+    int end = (int) n.end;
+    int count = 0;
+    int child;
+
+    if (n.kind < N_KEYWORD || n.kind > N_EXPRESSION_LIST ||
+        end <= node || end > nodeCount)
+    {
+        return false;
+    }
+
+    if (SyntaxTree::isTerminal(n.kind))
+    {
+        return (n.text < (unsigned int) stringCount && end == node + 1 &&
+                n.childCount == 0);
+    }
+
+    for (child = node + 1; child < end; child = getEnd(child))
+    {
+        if (getEnd(child) <= child || getEnd(child) > end)
+            return false;
+        count++;
+    }
+    return (n.text == NO_TEXT && count == (int) n.childCount);
+}
+
+/*
+ Unmaps the tree.
+ */
+void TreeReader::close()
+{
+    file.close();
+    nodes = NULL;
+    strings = NULL;
+    bytes = NULL;
+    nodeCount = 0;
+    stringCount = 0;
+}
+
+/*
+ Returns the root node, the class, or -1 if no tree is open.
+ */
+int TreeReader::getRoot()
+{
+    return (nodeCount > 0) ? 0 : -1;
+}
+
+/*
+ Returns the number of nodes in the tree.
+ */
+int TreeReader::getNodeCount()
+{
+    return nodeCount;
+}
@@ -0,0 +1,133 @@
+/*
+ TreeReader.hpp
+ CodeGenerator
+
+ Reads the binary parse trees written by TreeWriter. A tree file is mapped
+ into memory and used where it lies: tools walk the node array directly
+ instead of parsing XML. The layout is
+
+   header    magic "JTRE", version, node count, string count,
+             string bytes                                   20 bytes
+   nodes     one TreeNode per node, in preorder            16 bytes each
+   strings   one TreeString per string                      8 bytes each
+   bytes     the text of every string, each ending in '\0'
+
+ The root, the class, is node 0. A node's first child directly follows it,
+ and end is the index one past its last descendant, which is also where its
+ next sibling starts, so the children of node n are visited with
+
+   for (c = n + 1; c < end(n); c = end(c))
+
+ kind is the node's NodeKind, which names its XML tag. Keywords and symbols
+ keep their tokenizer code in code. Every terminal's text is in the string
+ table; nonterminals have NO_TEXT. Numbers are in the byte order of the
+ machine that wrote them.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef TreeReader_hpp
+#define TreeReader_hpp
+
+#include <iostream>
+#include "SourceFile.hpp"
+#include "SyntaxTree.hpp"
+
+using std::string;
+
+static const unsigned int TREE_VERSION = 1;
+static const unsigned int NO_TEXT = 0xFFFFFFFF;
+
+struct TreeHeader
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int nodeCount;
+    unsigned int stringCount;
+    unsigned int stringBytes;
+};
+
+struct TreeNode
+{
+    unsigned char kind;
+    unsigned char code;
+    unsigned short reserved;
+    unsigned int text;
+    unsigned int childCount;
+    unsigned int end;
+};
+
+struct TreeString
+{
+    unsigned int offset;
+    unsigned int length;
+};
+
+class TreeReader
+{
+private:
+    SourceFile file;
+    const TreeNode *nodes;
+    const TreeString *strings;
+    const char *bytes;
+    int nodeCount;
+    int stringCount;
+
+private:
+    bool isValid(const TreeHeader &header, size_t size);
+    bool isValidNode(int node);
+
+public:
+    TreeReader();
+    bool open(string fileName);
+    void close();
+    int getRoot();
+    int getNodeCount();
+
+    /*
+     Returns a node by index.
+     */
+    const TreeNode &getNode(int node)
+    {
+        return nodes[node];
+    }
+
+    /*
+     Returns the number of children of a node.
+     */
+    int getChildCount(int node)
+    {
+        return (int) nodes[node].childCount;
+    }
+
+    /*
+     Returns the index one past a node's last descendant.
+     */
+    int getEnd(int node)
+    {
+        return (int) nodes[node].end;
+    }
+
+    /*
+     Returns a terminal's text, or "" for a nonterminal.
+     */
+    const char *getText(int node)
+    {
+        unsigned int text = nodes[node].text;
+
+        return (text == NO_TEXT) ? "" : bytes + strings[text].offset;
+    }
+
+    size_t getTextLength(int node)
+    {
+        unsigned int text = nodes[node].text;
+
+        return (text == NO_TEXT) ? 0 : strings[text].length;
+    }
+
+private:
+    TreeReader(const TreeReader &);
+    TreeReader &operator=(const TreeReader &);
+};
+
+#endif /* TreeReader_hpp */
@@ -0,0 +1,146 @@
+/*
+ TreeWriter.cpp
+ CodeGenerator
+
+ Writes a parse tree in the binary format TreeReader maps, for tools that
+ want the tree without parsing XML. The nodes are written in preorder with
+ the end of each one's subtree, and every terminal's text goes into a
+ string table shared by the whole tree.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "TreeWriter.hpp"
+#include "JackTokenizer.hpp"
+
+/*
+ Opens the output. An empty name writes to standard output. Returns false if
+ the file could not be created.
+ */
+bool TreeWriter::open(string fileName)
+{
+    return out.open(fileName);
+}
+
+/*
+ Writes out anything still buffered and closes the output. Returns false if
+ any write failed.
+ */
+bool TreeWriter::close()
+{
+    return out.close();
+}
+
+size_t TreeWriter::getBytesWritten()
+{
+    return out.getBytesWritten();
+}
+
+/*
+ Adds a string to the table and returns its index.
+ */
+unsigned int TreeWriter::addString(const char *text, size_t length)
+{
+    TreeString entry;
+
+    entry.offset = (unsigned int) bytes.size();
+    entry.length = (unsigned int) length;
+    bytes.append(text, length);
+    bytes += '\0';
+    strings.push_back(entry);
+
+    return (unsigned int) strings.size() - 1;
+}
+
+/*
+ Returns the string holding a terminal's text, adding it the first time it
+ is needed. Interned names map one to one onto strings, and each keyword
+ and symbol is added once.
+ */
+unsigned int TreeWriter::getString(SyntaxTree &tree, const SyntaxNode &node)
+{
+    unsigned int *slot;
+    const char *text;
+
+    if (node.kind == N_KEYWORD)
+    {
+        slot = &keywordStrings[node.code];
+        text = JackTokenizer::getKeywordText(node.code);
+    }
+    else if (node.kind == N_SYMBOL)
+    {
+        slot = &symbolStrings[node.code];
+        text = JackTokenizer::getSymbolText(node.code);
+    }
+    else
+    {
+        slot = &nameStrings[node.name];
+        if (*slot == NO_TEXT)
+            *slot = addString(tree.getNameText(node.name),
+                              tree.getNameLength(node.name));
+        return *slot;
+    }
+
+    if (*slot == NO_TEXT)
+        *slot = addString(text, strlen(text));
+    return *slot;
+}
+
+/*
+ Appends a node and then its subtree in preorder, and fills in its end once
+ the subtree is written.
+ */
+void TreeWriter::addNode(SyntaxTree &tree, int node)
+{
+    const SyntaxNode &n = tree.getNode(node);
+    size_t index = nodes.size();
+    TreeNode record;
+
+    record.kind = n.kind;
+    record.code = n.code;
+    record.reserved = 0;
+    record.childCount = 0;
+    record.end = 0;
+    record.text = SyntaxTree::isTerminal(n.kind) ? getString(tree, n) :
+                                                   NO_TEXT;
+    if (!SyntaxTree::isTerminal(n.kind))
+        record.childCount = (unsigned int) tree.getChildCount(node);
+    nodes.push_back(record);
+
+    for (int i = 0; i < (int) record.childCount; i++)
+        addNode(tree, tree.getChild(node, i));
+
+    nodes[index].end = (unsigned int) nodes.size();
+}
+
+/*
+ Writes a whole parse tree, starting from its root.
+ */
+void TreeWriter::writeTree(SyntaxTree &tree)
+{
+    TreeHeader header;
+
+    nodes.clear();
+    strings.clear();
+    bytes.clear();
+    nameStrings.assign(tree.getNameCount(), NO_TEXT);
+    for (int i = 0; i < 32; i++)
+        keywordStrings[i] = symbolStrings[i] = NO_TEXT;
+
+    if (tree.getRoot() >= 0)
+        addNode(tree, tree.getRoot());
+
+    memcpy(header.magic, "JTRE", 4);
+    header.version = TREE_VERSION;
+    header.nodeCount = (unsigned int) nodes.size();
+    header.stringCount = (unsigned int) strings.size();
+    header.stringBytes = (unsigned int) bytes.size();
+
+    out.append((const char *) &header, sizeof(TreeHeader));
+    if (!nodes.empty())
+        out.append((const char *) &nodes[0], nodes.size() * sizeof(TreeNode));
+    if (!strings.empty())
+        out.append((const char *) &strings[0],
+                   strings.size() * sizeof(TreeString));
+    out.append(bytes.data(), bytes.size());
+}
@@ -0,0 +1,48 @@
+/*
+ TreeWriter.hpp
+ CodeGenerator
+
+ Writes a parse tree in the binary format TreeReader maps, for tools that
+ want the tree without parsing XML. The nodes are written in preorder with
+ the end of each one's subtree, and every terminal's text goes into a
+ string table shared by the whole tree. See TreeReader.hpp for the layout.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef TreeWriter_hpp
+#define TreeWriter_hpp
+
+#include <iostream>
+#include <vector>
+#include "OutputFile.hpp"
+#include "SyntaxTree.hpp"
+#include "TreeReader.hpp"
+
+using std::string;
+using std::vector;
+
+class TreeWriter
+{
+private:
+    OutputFile out;
+    vector<TreeNode> nodes;
+    vector<TreeString> strings;
+    string bytes;
+    vector<unsigned int> nameStrings;
+    unsigned int keywordStrings[32];
+    unsigned int symbolStrings[32];
+
+private:
+    unsigned int addString(const char *text, size_t length);
+    unsigned int getString(SyntaxTree &tree, const SyntaxNode &node);
+    void addNode(SyntaxTree &tree, int node);
+
+public:
+    bool open(string fileName);
+    bool close();
+    size_t getBytesWritten();
+    void writeTree(SyntaxTree &tree);
+};
+
+#endif /* TreeWriter_hpp */
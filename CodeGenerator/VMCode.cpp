@@ -0,0 +1,183 @@
+/*
+ VMCode.cpp
+ CodeGenerator
+
+ An in-memory list of Hack VM instructions. The VM back end builds one per
+ class and the VMWriter turns it into a .vm file. Instructions are
+ fixed-size records; function names and labels are kept once in a table of
+ names and referred to by number.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "VMCode.hpp"
+
+/*
+ Text of each operation, indexed by VMOp.
+ */
+static const char *opText[] =
+{
+    "", "push", "pop", "add", "sub", "neg", "eq", "gt", "lt", "and", "or",
+    "not", "label", "goto", "if-goto", "function", "call", "return"
+};
+
+/*
+ Text of each segment, indexed by VMSegment.
+ */
+static const char *segmentText[] =
+{
+    "", "constant", "argument", "local", "static", "this", "that", "pointer",
+    "temp"
+};
+
+/*
+ Appends an instruction.
+ */
+void VMCode::add(int op, int segment, int value, int name)
+{
+    VMInstruction instruction;
+
+    instruction.op = (unsigned char) op;
+    instruction.segment = (unsigned char) segment;
+    instruction.value = value;
+    instruction.name = name;
+    code.push_back(instruction);
+}
+
+void VMCode::push(int segment, int index)
+{
+    add(VM_PUSH, segment, index, -1);
+}
+
+void VMCode::pop(int segment, int index)
+{
+    add(VM_POP, segment, index, -1);
+}
+
+/*
+ Appends one of the arithmetic and logical operations, which take no
+ arguments.
+ */
+void VMCode::arithmetic(int op)
+{
+    add(op, 0, 0, -1);
+}
+
+void VMCode::label(int name)
+{
+    add(VM_LABEL, 0, 0, name);
+}
+
+void VMCode::gotoLabel(int name)
+{
+    add(VM_GOTO, 0, 0, name);
+}
+
+void VMCode::ifGoto(int name)
+{
+    add(VM_IF_GOTO, 0, 0, name);
+}
+
+void VMCode::function(const string &name, int localCount)
+{
+    add(VM_FUNCTION, 0, localCount, addName(name));
+}
+
+void VMCode::call(const string &name, int argumentCount)
+{
+    add(VM_CALL, 0, argumentCount, addName(name));
+}
+
+void VMCode::ret()
+{
+    add(VM_RETURN, 0, 0, -1);
+}
+
+/*
+ Returns the number of a function name or label, adding it if it is new.
+ */
+int VMCode::addName(const string &name)
+{
+    std::unordered_map<string, int>::iterator it = nameIndex.find(name);
+
+    if (it != nameIndex.end())
+        return it->second;
+
+    names.push_back(name);
+    nameIndex[name] = (int) names.size() - 1;
+    return (int) names.size() - 1;
+}
+
+/*
+ Returns the text of a function name or label.
+ */
+const string &VMCode::getName(int name)
+{
+    return names[name];
+}
+
+int VMCode::getNameCount()
+{
+    return (int) names.size();
+}
+
+/*
+ Returns the number of instructions.
+ */
+int VMCode::getSize()
+{
+    return (int) code.size();
+}
+
+/*
+ Removes the instructions after the first size, undoing code that turned out
+ not to be needed.
+ */
+void VMCode::truncate(int size)
+{
+    code.resize(size);
+}
+
+/*
+ Removes all instructions and names.
+ */
+void VMCode::clear()
+{
+    code.clear();
+    names.clear();
+    nameIndex.clear();
+}
+
+/*
+ Exchanges the contents of two VMCodes without copying them.
+ */
+void VMCode::swap(VMCode &other)
+{
+    code.swap(other.code);
+    names.swap(other.names);
+    nameIndex.swap(other.nameIndex);
+}
+
+/*
+ Returns the instructions, for the passes that rewrite them in place.
+ */
+vector<VMInstruction> &VMCode::getInstructions()
+{
+    return code;
+}
+
+const char *VMCode::getOpText(int op)
+{
+    if (op < VM_PUSH || op > VM_RETURN)
+        return "";
+
+    return opText[op];
+}
+
+const char *VMCode::getSegmentText(int segment)
+{
+    if (segment < SEG_CONSTANT || segment > SEG_TEMP)
+        return "";
+
+    return segmentText[segment];
+}
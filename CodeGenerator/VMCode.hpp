@@ -0,0 +1,79 @@
+/*
+ VMCode.hpp
+ CodeGenerator
+
+ An in-memory list of Hack VM instructions. The VM back end builds one per
+ class and the VMWriter turns it into a .vm file. Instructions are
+ fixed-size records; function names and labels are kept once in a table of
+ names and referred to by number.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef VMCode_hpp
+#define VMCode_hpp
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+enum VMOp
+{
+    VM_PUSH = 1, VM_POP, VM_ADD, VM_SUB, VM_NEG, VM_EQ, VM_GT, VM_LT, VM_AND,
+    VM_OR, VM_NOT, VM_LABEL, VM_GOTO, VM_IF_GOTO, VM_FUNCTION, VM_CALL,
+    VM_RETURN
+};
+
+enum VMSegment
+{
+    SEG_CONSTANT = 1, SEG_ARGUMENT, SEG_LOCAL, SEG_STATIC, SEG_THIS, SEG_THAT,
+    SEG_POINTER, SEG_TEMP
+};
+
+/*
+ One instruction. Push and pop use segment and value (the index); function
+ uses name and value (the number of locals); call uses name and value (the
+ number of arguments); the label and goto instructions use name.
+ */
+struct VMInstruction
+{
+    unsigned char op;
+    unsigned char segment;
+    int value;
+    int name;
+};
+
+class VMCode
+{
+private:
+    vector<VMInstruction> code;
+    vector<string> names;
+    std::unordered_map<string, int> nameIndex;
+
+public:
+    void add(int op, int segment, int value, int name);
+    void push(int segment, int index);
+    void pop(int segment, int index);
+    void arithmetic(int op);
+    void label(int name);
+    void gotoLabel(int name);
+    void ifGoto(int name);
+    void function(const string &name, int localCount);
+    void call(const string &name, int argumentCount);
+    void ret();
+    int addName(const string &name);
+    const string &getName(int name);
+    int getNameCount();
+    int getSize();
+    void truncate(int size);
+    void clear();
+    void swap(VMCode &other);
+    vector<VMInstruction> &getInstructions();
+    static const char *getOpText(int op);
+    static const char *getSegmentText(int segment);
+};
+
+#endif /* VMCode_hpp */
@@ -0,0 +1,1126 @@
+/*
+ VMGenerator.cpp
+ CodeGenerator
+
+ Project 11: Compiler II, Code Generation
+
+ Translates the parse tree of a class into Hack VM code. The tree is walked
+ once, from the class down; variables are resolved through a SymbolTable and
+ the instructions are collected in a VMCode for the VMWriter to write out.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "VMGenerator.hpp"
+#include "JackTokenizer.hpp"
+#include <cstdlib>
+
+/*
+ Prepares to translate a parse tree into the given VMCode.
+ */
+VMGenerator::VMGenerator(SyntaxTree &tree, VMCode &code)
+    : tree(tree), code(code)
+{
+    classNameId = -1;
+    labelCount = 0;
+    optimize = false;
+    pruneUnreachable = false;
+}
+
+/*
+ Turns the expression optimizations on or off. They are off by default.
+ */
+void VMGenerator::setOptimize(bool optimize)
+{
+    this->optimize = optimize;
+}
+
+/*
+ Turns the removal of statements that can never run on or off. It is off by
+ default.
+ */
+void VMGenerator::setPruneUnreachable(bool prune)
+{
+    pruneUnreachable = prune;
+}
+
+/*
+ Translates the whole class. The tree must be free of syntax errors. Returns
+ false if the class has semantic errors, such as undefined variables.
+ */
+bool VMGenerator::generate()
+{
+    errors.clear();
+
+    if (tree.getRoot() >= 0)
+        compileClass(tree.getRoot());
+
+    return errors.empty();
+}
+
+/*
+ Returns the errors found by generate().
+ */
+const vector<string> &VMGenerator::getErrors()
+{
+    return errors;
+}
+
+/*
+ 'class' className '{' classVarDec* subroutineDec* '}'
+ */
+void VMGenerator::compileClass(int node)
+{
+    symbols.startClass();
+    classNameId = tree.getNode(child(node, 1)).name;
+    className = getText(child(node, 1));
+
+    for (int i = 3; i < tree.getChildCount(node); i++)
+    {
+        int member = child(node, i);
+
+        if (kindOf(member) == N_CLASS_VAR_DEC)
+            compileClassVarDec(member);
+        else if (kindOf(member) == N_SUBROUTINE_DEC)
+            compileSubroutine(member);
+    }
+}
+
+/*
+ ('static' | 'field') type varName (',' varName)* ';'
+ Only defines the variables; no code is generated.
+ */
+void VMGenerator::compileClassVarDec(int node)
+{
+    int kind = (tree.getNode(child(node, 0)).code == K_STATIC) ? VAR_STATIC :
+                                                                 VAR_FIELD;
+    int type = getTypeName(child(node, 1));
+
+    for (int i = 2; i < tree.getChildCount(node); i++)
+    {
+        int name = child(node, i);
+
+        if (kindOf(name) == N_IDENTIFIER &&
+            !symbols.define(tree.getNode(name).name, type, kind))
+        {
+            addError("'" + getText(name) + "' is already defined");
+        }
+    }
+}
+
+/*
+ ('constructor' | 'function' | 'method') ('void' | type) subroutineName
+ '(' parameterList ')' subroutineBody
+
+ A constructor allocates the object's fields and a method sets 'this' from
+ its hidden first argument before the body runs.
+ */
+void VMGenerator::compileSubroutine(int node)
+{
+    int subroutineKind = tree.getNode(child(node, 0)).code;
+    int body = child(node, 6);
+    int statements = -1;
+
+    symbols.startSubroutine();
+    labelCount = 0;
+
+    if (subroutineKind == K_METHOD)
+        symbols.define(tree.intern("this", 4), classNameId, VAR_ARGUMENT);
+    compileParameterList(child(node, 4));
+
+    for (int i = 1; i < tree.getChildCount(body); i++)
+    {
+        int part = child(body, i);
+
+        if (kindOf(part) == N_VAR_DEC)
+            compileVarDec(part);
+        else if (kindOf(part) == N_STATEMENTS)
+            statements = part;
+    }
+
+    code.function(className + "." + getText(child(node, 2)),
+                  symbols.varCount(VAR_LOCAL));
+
+    if (subroutineKind == K_CONSTRUCTOR)
+    {
+        code.push(SEG_CONSTANT, symbols.varCount(VAR_FIELD));
+        code.call("Memory.alloc", 1);
+        code.pop(SEG_POINTER, 0);
+    }
+    else if (subroutineKind == K_METHOD)
+    {
+        code.push(SEG_ARGUMENT, 0);
+        code.pop(SEG_POINTER, 0);
+    }
+
+    if (statements >= 0)
+        compileStatements(statements);
+}
+
+/*
+ ((type varName) (',' type varName)*)?
+ */
+void VMGenerator::compileParameterList(int node)
+{
+    for (int i = 0; i + 1 < tree.getChildCount(node); i += 3)
+    {
+        int name = child(node, i + 1);
+
+        if (!symbols.define(tree.getNode(name).name,
+                            getTypeName(child(node, i)), VAR_ARGUMENT))
+        {
+            addError("'" + getText(name) + "' is already defined");
+        }
+    }
+}
+
+/*
+ 'var' type varName (',' varName)* ';'
+ */
+void VMGenerator::compileVarDec(int node)
+{
+    int type = getTypeName(child(node, 1));
+
+    for (int i = 2; i < tree.getChildCount(node); i++)
+    {
+        int name = child(node, i);
+
+        if (kindOf(name) == N_IDENTIFIER &&
+            !symbols.define(tree.getNode(name).name, type, VAR_LOCAL))
+        {
+            addError("'" + getText(name) + "' is already defined");
+        }
+    }
+}
+
+/*
+ (letStatement | ifStatement | whileStatement | doStatement | returnStatement)*
+ When pruning, the code for statements after one that always returns is
+ thrown away. They are still compiled, so their errors are reported.
+ */
+void VMGenerator::compileStatements(int node)
+{
+    int unreachable = -1;
+
+    for (int i = 0; i < tree.getChildCount(node); i++)
+    {
+        int statement = child(node, i);
+
+        if (pruneUnreachable && unreachable < 0 && i > 0 &&
+            alwaysReturns(child(node, i - 1)))
+        {
+            unreachable = code.getSize();
+        }
+
+        switch (kindOf(statement))
+        {
+            case N_LET_STATEMENT:
+                compileLet(statement);
+                break;
+            case N_IF_STATEMENT:
+                compileIf(statement);
+                break;
+            case N_WHILE_STATEMENT:
+                compileWhile(statement);
+                break;
+            case N_DO_STATEMENT:
+                compileDo(statement);
+                break;
+            case N_RETURN_STATEMENT:
+                compileReturn(statement);
+                break;
+        }
+    }
+
+    if (unreachable >= 0)
+        code.truncate(unreachable);
+}
+
+/*
+ Determines whether a statement always returns: a return, or an if whose
+ branches both end in one. A while may run its body no times, so it never
+ counts.
+ */
+bool VMGenerator::alwaysReturns(int statement)
+{
+    if (kindOf(statement) == N_RETURN_STATEMENT)
+        return true;
+
+    if (kindOf(statement) == N_IF_STATEMENT &&
+        tree.getChildCount(statement) > 7)
+    {
+        return (blockReturns(child(statement, 5)) &&
+                blockReturns(child(statement, 9)));
+    }
+    return false;
+}
+
+/*
+ Determines whether a block of statements always returns, which it does if
+ any of its statements does.
+ */
+bool VMGenerator::blockReturns(int statements)
+{
+    for (int i = 0; i < tree.getChildCount(statements); i++)
+    {
+        if (alwaysReturns(child(statements, i)))
+            return true;
+    }
+    return false;
+}
+
+/*
+ 'let' varName ('[' expression ']')? '=' expression ';'
+
+ For an array element the address is computed before the value, and the
+ value is parked in temp 0 while 'that' is pointed at the element.
+ */
+void VMGenerator::compileLet(int node)
+{
+    int name = child(node, 1);
+
+    if (isSymbol(child(node, 2), S_LEFT_BRACKET))
+    {
+        compileArrayAddress(name, child(node, 3));
+        compileExpression(child(node, 6));
+        code.pop(SEG_TEMP, 0);
+        code.pop(SEG_POINTER, 1);
+        code.push(SEG_TEMP, 0);
+        code.pop(SEG_THAT, 0);
+    }
+    else
+    {
+        compileExpression(child(node, 3));
+        popVariable(name);
+    }
+}
+
+/*
+ 'if' '(' expression ')' '{' statements '}' ('else' '{' statements '}')?
+ */
+void VMGenerator::compileIf(int node)
+{
+    int elseLabel = newLabel("IF_ELSE");
+    int endLabel;
+
+    compileExpression(child(node, 2));
+    code.arithmetic(VM_NOT);
+    code.ifGoto(elseLabel);
+    compileStatements(child(node, 5));
+
+    if (tree.getChildCount(node) > 7)
+    {
+        endLabel = newLabel("IF_END");
+        code.gotoLabel(endLabel);
+        code.label(elseLabel);
+        compileStatements(child(node, 9));
+        code.label(endLabel);
+    }
+    else
+    {
+        code.label(elseLabel);
+    }
+}
+
+/*
+ 'while' '(' expression ')' '{' statements '}'
+ */
+void VMGenerator::compileWhile(int node)
+{
+    int topLabel = newLabel("WHILE_EXP");
+    int endLabel = newLabel("WHILE_END");
+
+    code.label(topLabel);
+    compileExpression(child(node, 2));
+    code.arithmetic(VM_NOT);
+    code.ifGoto(endLabel);
+    compileStatements(child(node, 5));
+    code.gotoLabel(topLabel);
+    code.label(endLabel);
+}
+
+/*
+ 'do' subroutineCall ';'
+ The value every subroutine returns is discarded.
+ */
+void VMGenerator::compileDo(int node)
+{
+    compileSubroutineCall(node, 1);
+    code.pop(SEG_TEMP, 0);
+}
+
+/*
+ 'return' expression? ';'
+ A void subroutine returns 0.
+ */
+void VMGenerator::compileReturn(int node)
+{
+    if (kindOf(child(node, 1)) == N_EXPRESSION)
+        compileExpression(child(node, 1));
+    else
+        code.push(SEG_CONSTANT, 0);
+
+    code.ret();
+}
+
+/*
+ term (op term)*
+ Operators are applied left to right, as the Jack language specifies.
+ */
+void VMGenerator::compileExpression(int node)
+{
+    if (optimize)
+    {
+        compileOptimizedExpression(node);
+        return;
+    }
+    
+    compileTerm(child(node, 0));
+
+    for (int i = 1; i + 1 < tree.getChildCount(node); i += 2)
+    {
+        compileTerm(child(node, i + 1));
+        compileOp(tree.getNode(child(node, i)).code);
+    }
+}
+
+/*
+ As compileExpression, but works out as much of the value as it can at
+ compile time. While the terms seen so far are all constant nothing is
+ emitted, and their value is carried along instead. A constant operand is
+ applied by applyConstant, which drops identities and avoids the calls to
+ Math.multiply and Math.divide where it can. Commutative operators with a
+ constant on the left are applied with the constant on the right instead.
+ */
+void VMGenerator::compileOptimizedExpression(int node)
+{
+    int start = code.getSize();
+    int value = 0;
+    int operand;
+    bool constant = getConstant(child(node, 0), value);
+
+    if (!constant)
+        compileTerm(child(node, 0));
+
+    for (int i = 1; i + 1 < tree.getChildCount(node); i += 2)
+    {
+        int op = tree.getNode(child(node, i)).code;
+        int term = child(node, i + 1);
+
+        if (getConstant(term, operand))
+        {
+            if (constant && foldConstant(op, value, operand, value))
+                continue;
+
+            if (constant)
+                pushConstant(value);
+            constant = applyConstant(op, operand, start, value);
+        }
+        else if (constant && (op == S_PLUS || op == S_ASTERISK ||
+                              op == S_AMPERSAND || op == S_PIPE ||
+                              op == S_EQUALS))
+        {
+            compileTerm(term);
+            constant = applyConstant(op, value, start, value);
+        }
+        else
+        {
+            if (constant)
+                pushConstant(value);
+            constant = false;
+            compileTerm(term);
+            compileOp(op);
+        }
+    }
+
+    if (constant)
+        pushConstant(value);
+}
+
+/*
+ Works out the value of an expression or term made only of constants,
+ following the 16-bit arithmetic of the Hack machine. Returns false if the
+ value depends on anything only known when the program runs.
+ */
+bool VMGenerator::getConstant(int node, int &value)
+{
+    int first = child(node, 0);
+    int operand;
+
+    if (kindOf(node) == N_EXPRESSION)
+    {
+        if (!getConstant(first, value))
+            return false;
+
+        for (int i = 1; i + 1 < tree.getChildCount(node); i += 2)
+        {
+            if (!getConstant(child(node, i + 1), operand) ||
+                !foldConstant(tree.getNode(child(node, i)).code, value,
+                              operand, value))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    switch (kindOf(first))
+    {
+        case N_INT_CONST:
+            value = atoi(getText(first).c_str());
+            return (getText(first).length() <= 5 && value <= 32767);
+
+        case N_KEYWORD:
+            value = (tree.getNode(first).code == K_TRUE) ? -1 : 0;
+            return (tree.getNode(first).code != K_THIS);
+
+        case N_EXPRESSION:
+            return getConstant(first, value);
+
+        case N_SYMBOL:
+            if (!getConstant(child(node, 1), value))
+                return false;
+            if (isSymbol(first, S_MINUS))
+                value = toWord(-(long) value);
+            else if (isSymbol(first, S_TILDE))
+                value = ~value;
+            return true;
+    }
+    return false;
+}
+
+/*
+ Applies an operator to two constants. Returns false if the result cannot be
+ known at compile time, which is only the case for division by zero.
+ */
+bool VMGenerator::foldConstant(int op, int left, int right, int &value)
+{
+    switch (op)
+    {
+        case S_PLUS:
+            value = toWord((long) left + right);
+            return true;
+        case S_MINUS:
+            value = toWord((long) left - right);
+            return true;
+        case S_ASTERISK:
+            value = toWord((long) left * right);
+            return true;
+        case S_SLASH:
+            if (right == 0)
+                return false;
+            value = toWord((long) left / right);
+            return true;
+        case S_AMPERSAND:
+            value = left & right;
+            return true;
+        case S_PIPE:
+            value = left | right;
+            return true;
+        case S_LESS_THAN:
+            value = (left < right) ? -1 : 0;
+            return true;
+        case S_GREATER_THAN:
+            value = (left > right) ? -1 : 0;
+            return true;
+        case S_EQUALS:
+            value = (left == right) ? -1 : 0;
+            return true;
+    }
+    return false;
+}
+
+/*
+ Applies an operator to the value on top of the stack, whose code starts at
+ start, and a constant. Identities such as x + 0 emit nothing, and a result
+ that no longer depends on x, such as x * 0, removes x's code if it has no
+ calls in it. Returns true in that case, with the constant result in value.
+ */
+bool VMGenerator::applyConstant(int op, int operand, int start, int &value)
+{
+    switch (op)
+    {
+        case S_PLUS:
+        case S_MINUS:
+            if (operand == 0)
+                return false;
+            if (operand == -32768)
+                break;
+            if (operand < 0)
+            {
+                code.push(SEG_CONSTANT, -operand);
+                compileOp((op == S_PLUS) ? S_MINUS : S_PLUS);
+                return false;
+            }
+            code.push(SEG_CONSTANT, operand);
+            compileOp(op);
+            return false;
+
+        case S_ASTERISK:
+            if (operand == 0)
+                return replaceWithConstant(start, 0, value);
+            multiplyByConstant(operand);
+            return false;
+
+        case S_SLASH:
+            if (operand == 1)
+                return false;
+            if (operand == -1)
+            {
+                code.arithmetic(VM_NEG);
+                return false;
+            }
+            if (operand != -32768 && isPowerOfTwo(std::abs(operand)))
+            {
+                divideByPowerOfTwo(std::abs(operand));
+                if (operand < 0)
+                    code.arithmetic(VM_NEG);
+                return false;
+            }
+            break;
+
+        case S_AMPERSAND:
+            if (operand == -1)
+                return false;
+            if (operand == 0)
+                return replaceWithConstant(start, 0, value);
+            break;
+
+        case S_PIPE:
+            if (operand == 0)
+                return false;
+            if (operand == -1)
+                return replaceWithConstant(start, -1, value);
+            break;
+    }
+
+    pushConstant(operand);
+    compileOp(op);
+    return false;
+}
+
+/*
+ Replaces the value on top of the stack, whose code starts at start, by a
+ constant. The code is removed if it calls nothing, since then it has no
+ other effect; otherwise it must still run, and its result is masked off.
+ */
+bool VMGenerator::replaceWithConstant(int start, int constant, int &value)
+{
+    vector<VMInstruction> &instructions = code.getInstructions();
+
+    for (size_t i = start; i < instructions.size(); i++)
+    {
+        if (instructions[i].op == VM_CALL)
+        {
+            pushConstant(constant);
+            code.arithmetic(constant == 0 ? VM_AND : VM_OR);
+            return false;
+        }
+    }
+
+    code.truncate(start);
+    value = constant;
+    return true;
+}
+
+/*
+ Multiplies the value on top of the stack by a constant other than 0. A
+ constant with few bits set is done with doublings and additions (Horner's
+ rule over its bits, most significant first) rather than a call to
+ Math.multiply, which loops over all 16 bits.
+ */
+void VMGenerator::multiplyByConstant(int operand)
+{
+    unsigned int magnitude = (operand < 0) ? 0u - (unsigned int) operand :
+                                             (unsigned int) operand;
+    int highBit = 0;
+    int bitCount = 0;
+
+    magnitude &= 0xFFFF;
+    for (int bit = 0; bit < 16; bit++)
+    {
+        if (magnitude & (1u << bit))
+        {
+            highBit = bit;
+            bitCount++;
+        }
+    }
+
+    if (magnitude == 1)
+    {
+        if (operand < 0)
+            code.arithmetic(VM_NEG);
+        return;
+    }
+
+    if (bitCount == 1)
+    {
+        for (int bit = 0; bit < highBit; bit++)
+            doubleTop();
+    }
+    else if (4 * highBit + 2 * bitCount <= MAX_SHIFT_ADD)
+    {
+        code.pop(SEG_TEMP, 1);
+        code.push(SEG_TEMP, 1);
+        for (int bit = highBit - 1; bit >= 0; bit--)
+        {
+            doubleTop();
+            if (magnitude & (1u << bit))
+            {
+                code.push(SEG_TEMP, 1);
+                code.arithmetic(VM_ADD);
+            }
+        }
+    }
+    else
+    {
+        pushConstant(operand);
+        code.call("Math.multiply", 2);
+        return;
+    }
+
+    if (operand < 0 && operand != -32768)
+        code.arithmetic(VM_NEG);
+}
+
+/*
+ Doubles the value on top of the stack. A value that was just pushed is
+ pushed again; anything else is copied through temp 2.
+ */
+void VMGenerator::doubleTop()
+{
+    vector<VMInstruction> &instructions = code.getInstructions();
+
+    if (!instructions.empty() && instructions.back().op == VM_PUSH)
+    {
+        code.push(instructions.back().segment, instructions.back().value);
+    }
+    else
+    {
+        code.pop(SEG_TEMP, 2);
+        code.push(SEG_TEMP, 2);
+        code.push(SEG_TEMP, 2);
+    }
+    code.arithmetic(VM_ADD);
+}
+
+/*
+ Divides the value on top of the stack by 2^k, rounding toward zero as
+ Math.divide does. The VM has no shift, so the magnitude is taken apart a
+ bit at a time: each bit i >= k that is set contributes 2^(i-k). The sign is
+ removed first and put back last using (x ^ s) - s, where s is -1 for a
+ negative value and 0 otherwise, and xor is built from and, or and not.
+ Bit 15 of the magnitude is only set for -32768.
+ */
+void VMGenerator::divideByPowerOfTwo(int divisor)
+{
+    int shift = 0;
+
+    while ((1 << shift) < divisor)
+        shift++;
+
+    code.pop(SEG_TEMP, 1);
+    code.push(SEG_TEMP, 1);
+    code.push(SEG_CONSTANT, 0);
+    code.arithmetic(VM_LT);
+    code.pop(SEG_TEMP, 2);
+    applySign();
+    code.pop(SEG_TEMP, 1);
+
+    code.push(SEG_TEMP, 1);
+    code.push(SEG_CONSTANT, 0);
+    code.arithmetic(VM_LT);
+    code.push(SEG_CONSTANT, 1 << (15 - shift));
+    code.arithmetic(VM_AND);
+
+    for (int bit = shift; bit < 15; bit++)
+    {
+        code.push(SEG_TEMP, 1);
+        code.push(SEG_CONSTANT, 1 << bit);
+        code.arithmetic(VM_AND);
+        code.push(SEG_CONSTANT, 0);
+        code.arithmetic(VM_GT);
+        code.push(SEG_CONSTANT, 1 << (bit - shift));
+        code.arithmetic(VM_AND);
+        code.arithmetic(VM_ADD);
+    }
+
+    code.pop(SEG_TEMP, 1);
+    applySign();
+}
+
+/*
+ Pushes (temp 1 ^ temp 2) - temp 2, which is temp 1 when temp 2 is 0 and
+ -temp 1 when temp 2 is -1.
+ */
+void VMGenerator::applySign()
+{
+    code.push(SEG_TEMP, 1);
+    code.push(SEG_TEMP, 2);
+    code.arithmetic(VM_OR);
+    code.push(SEG_TEMP, 1);
+    code.push(SEG_TEMP, 2);
+    code.arithmetic(VM_AND);
+    code.arithmetic(VM_NOT);
+    code.arithmetic(VM_AND);
+    code.push(SEG_TEMP, 2);
+    code.arithmetic(VM_SUB);
+}
+
+/*
+ Pushes any 16-bit value. Only 0 to 32767 can be pushed directly.
+ */
+void VMGenerator::pushConstant(int value)
+{
+    if (value >= 0)
+    {
+        code.push(SEG_CONSTANT, value);
+    }
+    else if (value == -32768)
+    {
+        code.push(SEG_CONSTANT, 32767);
+        code.arithmetic(VM_NOT);
+    }
+    else
+    {
+        code.push(SEG_CONSTANT, -value);
+        code.arithmetic(VM_NEG);
+    }
+}
+
+/*
+ Pushes the address of an array element, the array's base plus the index.
+ */
+void VMGenerator::compileArrayAddress(int name, int index)
+{
+    int value;
+
+    pushVariable(name);
+    if (optimize && getConstant(index, value))
+    {
+        applyConstant(S_PLUS, value, code.getSize(), value);
+        return;
+    }
+    compileExpression(index);
+    code.arithmetic(VM_ADD);
+}
+
+/*
+ integerConstant | stringConstant | keywordConstant | varName |
+ varName '[' expression ']' | subroutineCall | '(' expression ')' |
+ unaryOp term
+ A term the parser left empty has no code, so it is an error here even if
+ the parser did not report one.
+ */
+void VMGenerator::compileTerm(int node)
+{
+    int count = tree.getChildCount(node);
+    int first;
+
+    if (count == 0)
+    {
+        addError("Expected term");
+        return;
+    }
+    first = child(node, 0);
+
+    switch (kindOf(first))
+    {
+        case N_INT_CONST:
+            compileIntVal(first);
+            break;
+
+        case N_STRING_CONST:
+            compileStringVal(first);
+            break;
+
+        case N_KEYWORD:
+            compileKeywordConstant(first);
+            break;
+
+        case N_IDENTIFIER:
+            if (count == 1)
+            {
+                pushVariable(first);
+            }
+            else if (isSymbol(child(node, 1), S_LEFT_BRACKET))
+            {
+                compileArrayAddress(first, child(node, 2));
+                code.pop(SEG_POINTER, 1);
+                code.push(SEG_THAT, 0);
+            }
+            else
+            {
+                compileSubroutineCall(node, 0);
+            }
+            break;
+
+        // An operation that binds more tightly, parsed with precedence
+        case N_EXPRESSION:
+            compileExpression(first);
+            break;
+
+        case N_SYMBOL:
+            if (isSymbol(first, S_LEFT_PAREN))
+            {
+                compileExpression(child(node, 1));
+            }
+            else
+            {
+                compileTerm(child(node, 1));
+                code.arithmetic(isSymbol(first, S_MINUS) ? VM_NEG : VM_NOT);
+            }
+            break;
+    }
+}
+
+/*
+ Pushes an integer constant, which must fit in 15 bits.
+ */
+void VMGenerator::compileIntVal(int node)
+{
+    string text = getText(node);
+    long value = strtol(text.c_str(), NULL, 10);
+
+    if (value > 32767)
+    {
+        addError("Integer constant " + text + " is too large");
+        value = 0;
+    }
+    code.push(SEG_CONSTANT, (int) value);
+}
+
+/*
+ Builds a String object holding a string constant, a character at a time.
+ */
+void VMGenerator::compileStringVal(int node)
+{
+    const char *text = tree.getNameText(tree.getNode(node).name);
+    size_t length = tree.getNameLength(tree.getNode(node).name);
+
+    code.push(SEG_CONSTANT, (int) length);
+    code.call("String.new", 1);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        code.push(SEG_CONSTANT, (unsigned char) text[i]);
+        code.call("String.appendChar", 2);
+    }
+}
+
+/*
+ 'true' | 'false' | 'null' | 'this'
+ True is all ones, which is not 0.
+ */
+void VMGenerator::compileKeywordConstant(int node)
+{
+    switch (tree.getNode(node).code)
+    {
+        case K_TRUE:
+            code.push(SEG_CONSTANT, 0);
+            code.arithmetic(VM_NOT);
+            break;
+        case K_THIS:
+            code.push(SEG_POINTER, 0);
+            break;
+        default:
+            code.push(SEG_CONSTANT, 0);
+            break;
+    }
+}
+
+/*
+ subroutineName '(' expressionList ')' |
+ (className | varName) '.' subroutineName '(' expressionList ')'
+
+ The call starts at the given child of the node. A method is passed the
+ object it is called on as a hidden first argument: 'this' for an unqualified
+ call, or the variable for a call through one.
+ */
+void VMGenerator::compileSubroutineCall(int node, int first)
+{
+    int name = child(node, first);
+    int argumentCount = 0;
+    string target;
+
+    if (isSymbol(child(node, first + 1), S_PERIOD))
+    {
+        int variable = tree.getNode(name).name;
+
+        if (symbols.kindOf(variable) != VAR_NONE)
+        {
+            pushVariable(name);
+            argumentCount = 1;
+            target = tree.getNameText(symbols.typeOf(variable));
+        }
+        else
+        {
+            target = getText(name);
+        }
+        target += ".";
+        target += getText(child(node, first + 2));
+        argumentCount += compileExpressionList(child(node, first + 4));
+    }
+    else
+    {
+        code.push(SEG_POINTER, 0);
+        argumentCount = 1;
+        target = className + "." + getText(name);
+        argumentCount += compileExpressionList(child(node, first + 2));
+    }
+
+    code.call(target, argumentCount);
+}
+
+/*
+ (expression (',' expression)*)?
+ Returns the number of expressions.
+ */
+int VMGenerator::compileExpressionList(int node)
+{
+    int count = 0;
+
+    for (int i = 0; i < tree.getChildCount(node); i++)
+    {
+        if (kindOf(child(node, i)) == N_EXPRESSION)
+        {
+            compileExpression(child(node, i));
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*
+ Applies a binary operator to the top two values on the stack. The VM has no
+ multiply or divide, so those call the OS.
+ */
+void VMGenerator::compileOp(int symbol)
+{
+    switch (symbol)
+    {
+        case S_PLUS:
+            code.arithmetic(VM_ADD);
+            break;
+        case S_MINUS:
+            code.arithmetic(VM_SUB);
+            break;
+        case S_ASTERISK:
+            code.call("Math.multiply", 2);
+            break;
+        case S_SLASH:
+            code.call("Math.divide", 2);
+            break;
+        case S_AMPERSAND:
+            code.arithmetic(VM_AND);
+            break;
+        case S_PIPE:
+            code.arithmetic(VM_OR);
+            break;
+        case S_LESS_THAN:
+            code.arithmetic(VM_LT);
+            break;
+        case S_GREATER_THAN:
+            code.arithmetic(VM_GT);
+            break;
+        case S_EQUALS:
+            code.arithmetic(VM_EQ);
+            break;
+    }
+}
+
+/*
+ Pushes the value of the variable named by an identifier node.
+ */
+void VMGenerator::pushVariable(int node)
+{
+    int name = tree.getNode(node).name;
+    int segment = getSegment(name);
+
+    if (segment == 0)
+    {
+        addError("'" + getText(node) + "' is not defined");
+        code.push(SEG_CONSTANT, 0);
+        return;
+    }
+    code.push(segment, symbols.indexOf(name));
+}
+
+/*
+ Pops the top of the stack into the variable named by an identifier node.
+ */
+void VMGenerator::popVariable(int node)
+{
+    int name = tree.getNode(node).name;
+    int segment = getSegment(name);
+
+    if (segment == 0)
+    {
+        addError("'" + getText(node) + "' is not defined");
+        code.pop(SEG_TEMP, 0);
+        return;
+    }
+    code.pop(segment, symbols.indexOf(name));
+}
+
+/*
+ Returns the segment a variable lives in, or 0 if it is not defined.
+ */
+int VMGenerator::getSegment(int name)
+{
+    switch (symbols.kindOf(name))
+    {
+        case VAR_STATIC:
+            return SEG_STATIC;
+        case VAR_FIELD:
+            return SEG_THIS;
+        case VAR_ARGUMENT:
+            return SEG_ARGUMENT;
+        case VAR_LOCAL:
+            return SEG_LOCAL;
+    }
+    return 0;
+}
+
+/*
+ Returns the interned name of a type, which is either a keyword ('int',
+ 'char' or 'boolean') or a class name.
+ */
+int VMGenerator::getTypeName(int node)
+{
+    const SyntaxNode &type = tree.getNode(node);
+
+    if (type.kind == N_KEYWORD)
+    {
+        const char *text = JackTokenizer::getKeywordText(type.code);
+        return tree.intern(text, strlen(text));
+    }
+    return type.name;
+}
+
+/*
+ Returns a label unique within the current subroutine, e.g. WHILE_EXP3.
+ */
+int VMGenerator::newLabel(const char *prefix)
+{
+    return code.addName(prefix + std::to_string(labelCount++));
+}
+
+/*
+ Returns the text of an identifier or constant node.
+ */
+string VMGenerator::getText(int node)
+{
+    int name = tree.getNode(node).name;
+
+    return string(tree.getNameText(name), tree.getNameLength(name));
+}
+
+/*
+ Records a semantic error.
+ */
+void VMGenerator::addError(string message)
+{
+    errors.push_back(message);
+}
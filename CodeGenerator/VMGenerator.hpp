@@ -0,0 +1,130 @@
+/*
+ VMGenerator.hpp
+ CodeGenerator
+
+ Project 11: Compiler II, Code Generation
+
+ Translates the parse tree of a class into Hack VM code. The tree is walked
+ once, from the class down; variables are resolved through a SymbolTable and
+ the instructions are collected in a VMCode for the VMWriter to write out.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef VMGenerator_hpp
+#define VMGenerator_hpp
+
+#include <iostream>
+#include <vector>
+#include "SyntaxTree.hpp"
+#include "SymbolTable.hpp"
+#include "VMCode.hpp"
+
+using std::string;
+using std::vector;
+
+class VMGenerator
+{
+private:
+    SyntaxTree &tree;
+    VMCode &code;
+    SymbolTable symbols;
+    string className;
+    int classNameId;
+    int labelCount;
+    bool optimize;
+    bool pruneUnreachable;
+    vector<string> errors;
+
+    // Longest doubling-and-adding sequence used in place of Math.multiply
+    static const int MAX_SHIFT_ADD = 40;
+
+private:
+    void compileClass(int node);
+    void compileClassVarDec(int node);
+    void compileSubroutine(int node);
+    void compileParameterList(int node);
+    void compileVarDec(int node);
+    void compileStatements(int node);
+    bool alwaysReturns(int statement);
+    bool blockReturns(int statements);
+    void compileLet(int node);
+    void compileIf(int node);
+    void compileWhile(int node);
+    void compileDo(int node);
+    void compileReturn(int node);
+    void compileExpression(int node);
+    void compileOptimizedExpression(int node);
+    bool getConstant(int node, int &value);
+    bool foldConstant(int op, int left, int right, int &value);
+    bool applyConstant(int op, int operand, int start, int &value);
+    bool replaceWithConstant(int start, int constant, int &value);
+    void multiplyByConstant(int operand);
+    void doubleTop();
+    void divideByPowerOfTwo(int divisor);
+    void applySign();
+    void pushConstant(int value);
+    void compileArrayAddress(int name, int index);
+    void compileTerm(int node);
+    void compileIntVal(int node);
+    void compileStringVal(int node);
+    void compileKeywordConstant(int node);
+    void compileSubroutineCall(int node, int first);
+    int compileExpressionList(int node);
+    void compileOp(int symbol);
+    void pushVariable(int node);
+    void popVariable(int node);
+    int getSegment(int name);
+    int getTypeName(int node);
+    int newLabel(const char *prefix);
+    string getText(int node);
+    void addError(string message);
+
+    /*
+     Returns the i'th child of a node.
+     */
+    int child(int node, int i)
+    {
+        return tree.getChild(node, i);
+    }
+
+    /*
+     Returns the kind of a node.
+     */
+    int kindOf(int node)
+    {
+        return tree.getNode(node).kind;
+    }
+
+    /*
+     Determines whether a node is the given symbol.
+     */
+    bool isSymbol(int node, int symbol)
+    {
+        return (tree.getNode(node).kind == N_SYMBOL &&
+                tree.getNode(node).code == symbol);
+    }
+
+    /*
+     Wraps a value to 16 bits, as the Hack machine's arithmetic does.
+     */
+    static int toWord(long value)
+    {
+        value &= 0xFFFF;
+        return (int) ((value >= 0x8000) ? value - 0x10000 : value);
+    }
+
+    static bool isPowerOfTwo(int value)
+    {
+        return (value > 0 && (value & (value - 1)) == 0);
+    }
+
+public:
+    VMGenerator(SyntaxTree &tree, VMCode &code);
+    void setOptimize(bool optimize);
+    void setPruneUnreachable(bool prune);
+    bool generate();
+    const vector<string> &getErrors();
+};
+
+#endif /* VMGenerator_hpp */
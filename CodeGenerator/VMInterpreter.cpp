@@ -0,0 +1,1264 @@
+/*
+ VMInterpreter.cpp
+ CodeGenerator
+
+ Runs a compiled program on a model of the Hack machine, so that the code
+ the compiler generates can be measured without an external emulator. The
+ VM code is first translated into a flat array of operations with every
+ segment, label and call resolved, and then run by a dispatch loop that
+ jumps straight from one operation's handler to the next. The OS classes
+ are implemented natively, on the same RAM the program sees, and the screen
+ is an ordinary block of that RAM with nothing to display it.
+
+ Every operation counts how often it runs. Afterwards the counts are
+ turned into the VM instructions executed and the Hack machine cycles
+ spent in each subroutine, estimated from the length of the assembly a
+ straightforward VM translator produces for each instruction and of the
+ standard OS's subroutines.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "VMInterpreter.hpp"
+#include "OutputFile.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+/*
+ The operations of the translated program. Pushes and pops of the static,
+ temp and pointer segments all become direct RAM accesses, since their
+ addresses are known before the program runs.
+ */
+enum Operations
+{
+    OP_PUSH_CONSTANT = 0, OP_PUSH_LOCAL, OP_PUSH_ARGUMENT, OP_PUSH_THIS,
+    OP_PUSH_THAT, OP_PUSH_DIRECT, OP_POP_LOCAL, OP_POP_ARGUMENT, OP_POP_THIS,
+    OP_POP_THAT, OP_POP_DIRECT, OP_ADD, OP_SUB, OP_NEG, OP_EQ, OP_GT, OP_LT,
+    OP_AND, OP_OR, OP_NOT, OP_GOTO, OP_IF_GOTO, OP_FUNCTION, OP_CALL,
+    OP_CALL_NATIVE, OP_RETURN, OP_HALT
+};
+
+/*
+ Estimated Hack instructions for each operation, indexed by Operations.
+ function adds FUNCTION_LOCAL_CYCLES for each local it clears.
+ */
+static const int operationCycles[] =
+{
+    7, 11, 11, 11, 11, 6, 14, 14, 14, 14, 6, 5, 5, 3, 15, 15, 15, 5, 5, 3,
+    2, 5, 2, 45, 45, 40, 0
+};
+
+static const int FUNCTION_LOCAL_CYCLES = 5;
+
+/*
+ The OS subroutines, indexed by Natives.
+ */
+enum Natives
+{
+    MATH_MULTIPLY = 0, MATH_DIVIDE, MATH_MIN, MATH_MAX, MATH_SQRT, MATH_ABS,
+    MEMORY_PEEK, MEMORY_POKE, MEMORY_ALLOC, MEMORY_DEALLOC, ARRAY_NEW,
+    ARRAY_DISPOSE, STRING_NEW, STRING_DISPOSE, STRING_LENGTH, STRING_CHAR_AT,
+    STRING_SET_CHAR_AT, STRING_APPEND_CHAR, STRING_ERASE_LAST_CHAR,
+    STRING_INT_VALUE, STRING_SET_INT, STRING_BACK_SPACE,
+    STRING_DOUBLE_QUOTE, STRING_NEW_LINE, OUTPUT_MOVE_CURSOR,
+    OUTPUT_PRINT_CHAR, OUTPUT_PRINT_STRING, OUTPUT_PRINT_INT,
+    OUTPUT_PRINTLN, OUTPUT_BACK_SPACE, SCREEN_CLEAR_SCREEN, SCREEN_SET_COLOR,
+    SCREEN_DRAW_PIXEL, SCREEN_DRAW_LINE, SCREEN_DRAW_RECTANGLE,
+    SCREEN_DRAW_CIRCLE, KEYBOARD_KEY_PRESSED, KEYBOARD_READ_CHAR,
+    KEYBOARD_READ_LINE, KEYBOARD_READ_INT, SYS_HALT, SYS_ERROR, SYS_WAIT,
+    NATIVE_COUNT
+};
+
+/*
+ Name, number of arguments and estimated cycles of each OS subroutine. The
+ cycles are those of a typical call to the standard OS; subroutines whose
+ work depends on their arguments add to them as they run.
+ */
+static const struct
+{
+    const char *name;
+    int argumentCount;
+    int cycles;
+} natives[] =
+{
+    { "Math.multiply", 2, 300 }, { "Math.divide", 2, 450 },
+    { "Math.min", 2, 20 }, { "Math.max", 2, 20 }, { "Math.sqrt", 1, 1200 },
+    { "Math.abs", 1, 20 }, { "Memory.peek", 1, 15 },
+    { "Memory.poke", 2, 15 }, { "Memory.alloc", 1, 150 },
+    { "Memory.deAlloc", 1, 40 }, { "Array.new", 1, 160 },
+    { "Array.dispose", 1, 50 }, { "String.new", 1, 200 },
+    { "String.dispose", 1, 50 }, { "String.length", 1, 15 },
+    { "String.charAt", 2, 25 }, { "String.setCharAt", 3, 25 },
+    { "String.appendChar", 2, 40 }, { "String.eraseLastChar", 1, 20 },
+    { "String.intValue", 1, 300 }, { "String.setInt", 2, 600 },
+    { "String.backSpace", 0, 10 }, { "String.doubleQuote", 0, 10 },
+    { "String.newLine", 0, 10 }, { "Output.moveCursor", 2, 100 },
+    { "Output.printChar", 1, 800 }, { "Output.printString", 1, 100 },
+    { "Output.printInt", 1, 300 }, { "Output.println", 0, 50 },
+    { "Output.backSpace", 0, 800 }, { "Screen.clearScreen", 0, 70000 },
+    { "Screen.setColor", 1, 10 }, { "Screen.drawPixel", 2, 200 },
+    { "Screen.drawLine", 4, 300 }, { "Screen.drawRectangle", 4, 200 },
+    { "Screen.drawCircle", 3, 500 }, { "Keyboard.keyPressed", 0, 15 },
+    { "Keyboard.readChar", 0, 1000 }, { "Keyboard.readLine", 1, 1000 },
+    { "Keyboard.readInt", 1, 1500 }, { "Sys.halt", 0, 0 },
+    { "Sys.error", 1, 0 }, { "Sys.wait", 1, 0 }
+};
+
+// Estimated cycles per character drawn, per pixel of a line and per row
+static const int CHARACTER_CYCLES = 800;
+static const int LINE_PIXEL_CYCLES = 100;
+static const int ROW_CYCLES = 300;
+
+// The key codes the OS gives newline and backspace
+static const int NEW_LINE = 128;
+static const int BACK_SPACE = 129;
+
+/*
+ Starts with no program.
+ */
+VMInterpreter::VMInterpreter()
+{
+    stepLimit = 0;
+    reset();
+}
+
+/*
+ Clears the machine and the counts, ready to run the program again.
+ */
+void VMInterpreter::reset()
+{
+    memset(ram, 0, sizeof(ram));
+    freeBlocks.clear();
+    heapTop = HEAP_BASE;
+    color = true;
+    inputPosition = 0;
+    keyHeld = false;
+    output.clear();
+    errorCode = 0;
+    fault.clear();
+    status = RUN_HALTED;
+    stopped = false;
+    hits.assign(operations.size(), 0);
+    nativeCalls.assign(NATIVE_COUNT, 0);
+    nativeCycles.assign(NATIVE_COUNT, 0);
+}
+
+/*
+ Translates a program's VM code for running. Returns false, with the reasons
+ in diagnostics, if the program calls a subroutine that neither it nor the
+ OS has, or does not fit in the Hack machine.
+ */
+bool VMInterpreter::load(VMProgram &program, string &diagnostics)
+{
+    bool ok = link(program, diagnostics);
+
+    reset();
+    return ok;
+}
+
+/*
+ Resolves the program into operations. The first two operations call the
+ entry point, Sys.init if the program has its own and otherwise Main.main,
+ and halt when it returns. Labels take no operation of their own: a jump
+ goes to the operation after the label.
+ */
+bool VMInterpreter::link(VMProgram &program, string &diagnostics)
+{
+    std::unordered_map<string, int> functionIndex;
+    std::unordered_map<string, int> nativeIndex;
+    std::unordered_map<string, int>::iterator it;
+    int staticBase = STATIC_BASE;
+    int next = 2;
+    bool ok = true;
+
+    operations.clear();
+    cost.clear();
+    subroutines.clear();
+
+    for (int n = 0; n < NATIVE_COUNT; n++)
+        nativeIndex[natives[n].name] = n;
+
+    // Find where each function's operations will start
+    for (int u = 0; u < program.getUnitCount(); u++)
+    {
+        VMCode &code = program.getCode(u);
+        vector<VMInstruction> &instructions = code.getInstructions();
+
+        for (size_t i = 0; i < instructions.size(); i++)
+        {
+            if (instructions[i].op == VM_FUNCTION)
+            {
+                Subroutine subroutine;
+
+                subroutine.name = code.getName(instructions[i].name);
+                subroutine.start = next;
+                subroutine.end = next;
+                functionIndex[subroutine.name] = next;
+                subroutines.push_back(subroutine);
+            }
+            if (instructions[i].op != VM_LABEL)
+                next++;
+        }
+    }
+    if (next > 0x10000)
+    {
+        diagnostics += "program is too large to run\n";
+        return false;
+    }
+    for (size_t s = 0; s < subroutines.size(); s++)
+    {
+        subroutines[s].end = (s + 1 < subroutines.size()) ?
+            subroutines[s + 1].start : next;
+    }
+
+    it = functionIndex.find("Sys.init");
+    if (it == functionIndex.end())
+        it = functionIndex.find("Main.main");
+    if (it == functionIndex.end())
+    {
+        diagnostics += "program has no Main.main\n";
+        return false;
+    }
+    operations.push_back(Operation { OP_CALL, it->second, 0 });
+    operations.push_back(Operation { OP_HALT, 0, 0 });
+
+    for (int u = 0; u < program.getUnitCount(); u++)
+    {
+        VMCode &code = program.getCode(u);
+        vector<VMInstruction> &instructions = code.getInstructions();
+        vector<int> labels(code.getNameCount(), -1);
+        int staticCount = 0;
+        size_t start = 0;
+
+        for (size_t i = 0; i < instructions.size(); i++)
+        {
+            if ((instructions[i].op == VM_PUSH ||
+                 instructions[i].op == VM_POP) &&
+                instructions[i].segment == SEG_STATIC)
+            {
+                staticCount = std::max(staticCount, instructions[i].value + 1);
+            }
+        }
+        if (staticBase + staticCount > STACK_BASE)
+        {
+            diagnostics += "program has too many static variables\n";
+            return false;
+        }
+
+        while (start < instructions.size())
+        {
+            size_t end = start + 1;
+            int position = (int) operations.size();
+
+            while (end < instructions.size() &&
+                   instructions[end].op != VM_FUNCTION)
+            {
+                end++;
+            }
+
+            // Labels are local to their function
+            for (size_t i = start; i < end; i++)
+            {
+                if (instructions[i].op == VM_LABEL)
+                    labels[instructions[i].name] = position;
+                else
+                    position++;
+            }
+
+            for (size_t i = start; i < end; i++)
+            {
+                VMInstruction &instruction = instructions[i];
+                Operation operation = { OP_HALT, instruction.value, 0 };
+
+                switch (instruction.op)
+                {
+                    case VM_PUSH:
+                    case VM_POP:
+                        switch (instruction.segment)
+                        {
+                            case SEG_CONSTANT:
+                                operation.op = OP_PUSH_CONSTANT;
+                                break;
+                            case SEG_LOCAL:
+                                operation.op = OP_PUSH_LOCAL;
+                                break;
+                            case SEG_ARGUMENT:
+                                operation.op = OP_PUSH_ARGUMENT;
+                                break;
+                            case SEG_THIS:
+                                operation.op = OP_PUSH_THIS;
+                                break;
+                            case SEG_THAT:
+                                operation.op = OP_PUSH_THAT;
+                                break;
+                            case SEG_STATIC:
+                                operation.op = OP_PUSH_DIRECT;
+                                operation.a += staticBase;
+                                break;
+                            case SEG_POINTER:
+                                operation.op = OP_PUSH_DIRECT;
+                                operation.a += 3;
+                                break;
+                            case SEG_TEMP:
+                                operation.op = OP_PUSH_DIRECT;
+                                operation.a += 5;
+                                break;
+                        }
+                        // Each pop follows the push of the same segment
+                        if (instruction.op == VM_POP)
+                            operation.op += OP_POP_LOCAL - OP_PUSH_LOCAL;
+                        break;
+
+                    case VM_ADD: operation.op = OP_ADD; break;
+                    case VM_SUB: operation.op = OP_SUB; break;
+                    case VM_NEG: operation.op = OP_NEG; break;
+                    case VM_EQ: operation.op = OP_EQ; break;
+                    case VM_GT: operation.op = OP_GT; break;
+                    case VM_LT: operation.op = OP_LT; break;
+                    case VM_AND: operation.op = OP_AND; break;
+                    case VM_OR: operation.op = OP_OR; break;
+                    case VM_NOT: operation.op = OP_NOT; break;
+
+                    case VM_LABEL:
+                        continue;
+
+                    case VM_GOTO:
+                    case VM_IF_GOTO:
+                        operation.op = (instruction.op == VM_GOTO) ?
+                            OP_GOTO : OP_IF_GOTO;
+                        operation.a = labels[instruction.name];
+                        if (operation.a < 0)
+                        {
+                            diagnostics += code.getName(instruction.name) +
+                                           ": no such label\n";
+                            ok = false;
+                        }
+                        break;
+
+                    case VM_FUNCTION:
+                        operation.op = OP_FUNCTION;
+                        break;
+
+                    case VM_CALL:
+                        operation.b = instruction.value;
+                        it = functionIndex.find(code.getName(instruction.name));
+                        if (it != functionIndex.end())
+                        {
+                            operation.op = OP_CALL;
+                            operation.a = it->second;
+                            break;
+                        }
+                        it = nativeIndex.find(code.getName(instruction.name));
+                        if (it != nativeIndex.end() &&
+                            natives[it->second].argumentCount ==
+                            instruction.value)
+                        {
+                            operation.op = OP_CALL_NATIVE;
+                            operation.a = it->second;
+                            break;
+                        }
+                        diagnostics += code.getName(instruction.name) +
+                                       ": no such subroutine\n";
+                        ok = false;
+                        break;
+
+                    case VM_RETURN:
+                        operation.op = OP_RETURN;
+                        break;
+                }
+                operations.push_back(operation);
+            }
+
+            for (size_t i = start; i < end; i++)
+            {
+                if (instructions[i].op == VM_LABEL)
+                    labels[instructions[i].name] = -1;
+            }
+            start = end;
+        }
+        staticBase += staticCount;
+    }
+
+    for (size_t i = 0; i < operations.size(); i++)
+    {
+        cost.push_back(operationCycles[operations[i].op]);
+        if (operations[i].op == OP_FUNCTION)
+            cost.back() += operations[i].a * FUNCTION_LOCAL_CYCLES;
+    }
+
+    return ok;
+}
+
+/*
+ Sets the text typed at the keyboard while the program runs.
+ */
+void VMInterpreter::setInput(const string &text)
+{
+    input = text;
+}
+
+/*
+ Sets the most VM instructions to run before stopping the program; 0 means
+ no limit.
+ */
+void VMInterpreter::setStepLimit(long long limit)
+{
+    stepLimit = limit;
+}
+
+/*
+ Runs the program from the start until it halts, calls Sys.error, faults
+ or reaches the step limit, and returns which it was.
+
+ With GCC and Clang each operation's handler ends by fetching the next
+ operation and jumping straight to its handler, so the branch predictor
+ sees a separate indirect jump for each kind of operation; other compilers
+ get the same loop as a switch.
+ */
+int VMInterpreter::run()
+{
+    const Operation *code = operations.data();
+    const Operation *current;
+    long long *hitCount;
+    long long budget;
+    int pc = 0;
+    int sp = STACK_BASE;
+    int lcl = STACK_BASE;
+    int arg = STACK_BASE;
+    int frame;
+    int result;
+    long long cycles;
+
+    reset();
+    if (operations.empty())
+        return RUN_FAULT;
+    hitCount = hits.data();
+    budget = (stepLimit > 0) ? stepLimit : -1;
+
+#define FETCH() \
+    if (budget-- == 0) goto outOfSteps; \
+    current = code + pc; \
+    hitCount[pc++]++
+
+#if defined(__GNUC__)
+    static const void *handlers[] =
+    {
+        &&L_OP_PUSH_CONSTANT, &&L_OP_PUSH_LOCAL, &&L_OP_PUSH_ARGUMENT,
+        &&L_OP_PUSH_THIS, &&L_OP_PUSH_THAT, &&L_OP_PUSH_DIRECT,
+        &&L_OP_POP_LOCAL, &&L_OP_POP_ARGUMENT, &&L_OP_POP_THIS,
+        &&L_OP_POP_THAT, &&L_OP_POP_DIRECT, &&L_OP_ADD, &&L_OP_SUB,
+        &&L_OP_NEG, &&L_OP_EQ, &&L_OP_GT, &&L_OP_LT, &&L_OP_AND, &&L_OP_OR,
+        &&L_OP_NOT, &&L_OP_GOTO, &&L_OP_IF_GOTO, &&L_OP_FUNCTION,
+        &&L_OP_CALL, &&L_OP_CALL_NATIVE, &&L_OP_RETURN, &&L_OP_HALT
+    };
+#define CASE(name) L_##name
+#define NEXT() FETCH(); goto *handlers[current->op]
+
+    NEXT();
+#else
+#define CASE(name) case name
+#define NEXT() continue
+
+    for (;;)
+    {
+        FETCH();
+        switch (current->op)
+        {
+#endif
+    CASE(OP_PUSH_CONSTANT):
+        ram[sp++] = (short) current->a;
+        NEXT();
+    CASE(OP_PUSH_LOCAL):
+        ram[sp++] = ram[lcl + current->a];
+        NEXT();
+    CASE(OP_PUSH_ARGUMENT):
+        ram[sp++] = ram[arg + current->a];
+        NEXT();
+    CASE(OP_PUSH_THIS):
+        ram[sp++] = ram[(ram[3] + current->a) & (RAM_SIZE - 1)];
+        NEXT();
+    CASE(OP_PUSH_THAT):
+        ram[sp++] = ram[(ram[4] + current->a) & (RAM_SIZE - 1)];
+        NEXT();
+    CASE(OP_PUSH_DIRECT):
+        ram[sp++] = ram[current->a];
+        NEXT();
+    CASE(OP_POP_LOCAL):
+        ram[lcl + current->a] = ram[--sp];
+        NEXT();
+    CASE(OP_POP_ARGUMENT):
+        ram[arg + current->a] = ram[--sp];
+        NEXT();
+    CASE(OP_POP_THIS):
+        ram[(ram[3] + current->a) & (RAM_SIZE - 1)] = ram[--sp];
+        NEXT();
+    CASE(OP_POP_THAT):
+        ram[(ram[4] + current->a) & (RAM_SIZE - 1)] = ram[--sp];
+        NEXT();
+    CASE(OP_POP_DIRECT):
+        ram[current->a] = ram[--sp];
+        NEXT();
+    CASE(OP_ADD):
+        sp--;
+        ram[sp - 1] = toWord(ram[sp - 1] + ram[sp]);
+        NEXT();
+    CASE(OP_SUB):
+        sp--;
+        ram[sp - 1] = toWord(ram[sp - 1] - ram[sp]);
+        NEXT();
+    CASE(OP_NEG):
+        ram[sp - 1] = toWord(-ram[sp - 1]);
+        NEXT();
+    CASE(OP_EQ):
+        sp--;
+        ram[sp - 1] = (ram[sp - 1] == ram[sp]) ? -1 : 0;
+        NEXT();
+    CASE(OP_GT):
+        sp--;
+        ram[sp - 1] = (ram[sp - 1] > ram[sp]) ? -1 : 0;
+        NEXT();
+    CASE(OP_LT):
+        sp--;
+        ram[sp - 1] = (ram[sp - 1] < ram[sp]) ? -1 : 0;
+        NEXT();
+    CASE(OP_AND):
+        sp--;
+        ram[sp - 1] = ram[sp - 1] & ram[sp];
+        NEXT();
+    CASE(OP_OR):
+        sp--;
+        ram[sp - 1] = ram[sp - 1] | ram[sp];
+        NEXT();
+    CASE(OP_NOT):
+        ram[sp - 1] = ~ram[sp - 1];
+        NEXT();
+    CASE(OP_GOTO):
+        pc = current->a;
+        NEXT();
+    CASE(OP_IF_GOTO):
+        if (ram[--sp] != 0)
+            pc = current->a;
+        NEXT();
+    CASE(OP_FUNCTION):
+        if (sp + current->a >= HEAP_BASE)
+            goto stackOverflow;
+        for (int i = 0; i < current->a; i++)
+            ram[sp++] = 0;
+        NEXT();
+    CASE(OP_CALL):
+        if (sp + 5 >= HEAP_BASE)
+            goto stackOverflow;
+        ram[sp] = toWord(pc);
+        ram[sp + 1] = (short) lcl;
+        ram[sp + 2] = (short) arg;
+        ram[sp + 3] = ram[3];
+        ram[sp + 4] = ram[4];
+        arg = sp - current->b;
+        sp += 5;
+        lcl = sp;
+        pc = current->a;
+        NEXT();
+    CASE(OP_CALL_NATIVE):
+        ram[0] = (short) sp;
+        ram[1] = (short) lcl;
+        ram[2] = (short) arg;
+        cycles = natives[current->a].cycles;
+        result = callNative(current->a, ram + sp - current->b, cycles);
+        nativeCalls[current->a]++;
+        nativeCycles[current->a] += cycles;
+        sp -= current->b;
+        ram[sp++] = (short) result;
+        if (stopped)
+            goto halt;
+        NEXT();
+    CASE(OP_RETURN):
+        // With no arguments the return value goes where the return
+        // address is, so the address is read first
+        frame = lcl;
+        pc = (unsigned short) ram[frame - 5];
+        ram[arg] = ram[sp - 1];
+        sp = arg + 1;
+        ram[4] = ram[frame - 1];
+        ram[3] = ram[frame - 2];
+        arg = ram[frame - 3];
+        lcl = ram[frame - 4];
+        NEXT();
+    CASE(OP_HALT):
+        goto halt;
+#if !defined(__GNUC__)
+        }
+    }
+#endif
+
+#undef FETCH
+#undef CASE
+#undef NEXT
+
+stackOverflow:
+    setFault("stack overflow");
+    goto halt;
+
+outOfSteps:
+    status = RUN_STEP_LIMIT;
+
+halt:
+    ram[0] = (short) sp;
+    ram[1] = (short) lcl;
+    ram[2] = (short) arg;
+    return status;
+}
+
+/*
+ Carries out an OS subroutine. args points at its arguments on the stack,
+ with 'this' first for a method. Adds any work that depends on the
+ arguments to cycles and returns the subroutine's value, or 0 for a void
+ one. Errors stop the program the way the OS's Sys.error does, with the
+ standard OS's error codes.
+ */
+short VMInterpreter::callNative(int native, short *args, long long &cycles)
+{
+    int value;
+    string line;
+
+    switch (native)
+    {
+        case MATH_MULTIPLY:
+            return toWord(args[0] * args[1]);
+
+        case MATH_DIVIDE:
+            if (args[1] == 0)
+            {
+                stop(3);
+                return 0;
+            }
+            return toWord(args[0] / args[1]);
+
+        case MATH_MIN:
+            return std::min(args[0], args[1]);
+
+        case MATH_MAX:
+            return std::max(args[0], args[1]);
+
+        case MATH_SQRT:
+            if (args[0] < 0)
+            {
+                stop(4);
+                return 0;
+            }
+            value = 0;
+            while ((value + 1) * (value + 1) <= args[0])
+                value++;
+            return (short) value;
+
+        case MATH_ABS:
+            return toWord(args[0] < 0 ? -args[0] : args[0]);
+
+        case MEMORY_PEEK:
+            return at(args[0]);
+
+        case MEMORY_POKE:
+            at(args[0]) = args[1];
+            return 0;
+
+        case MEMORY_ALLOC:
+            if (args[0] <= 0)
+            {
+                stop(5);
+                return 0;
+            }
+            return allocate(args[0]);
+
+        case ARRAY_NEW:
+            if (args[0] <= 0)
+            {
+                stop(2);
+                return 0;
+            }
+            return allocate(args[0]);
+
+        case MEMORY_DEALLOC:
+        case ARRAY_DISPOSE:
+        case STRING_DISPOSE:
+            deallocate(args[0]);
+            return 0;
+
+        case STRING_NEW:
+            if (args[0] < 0)
+            {
+                stop(14);
+                return 0;
+            }
+            return newString(args[0]);
+
+        case STRING_LENGTH:
+            return at(args[0] + 1);
+
+        case STRING_CHAR_AT:
+            if (args[1] < 0 || args[1] >= at(args[0] + 1))
+            {
+                stop(15);
+                return 0;
+            }
+            return at(args[0] + 2 + args[1]);
+
+        case STRING_SET_CHAR_AT:
+            if (args[1] < 0 || args[1] >= at(args[0] + 1))
+            {
+                stop(16);
+                return 0;
+            }
+            at(args[0] + 2 + args[1]) = args[2];
+            return 0;
+
+        case STRING_APPEND_CHAR:
+            if (at(args[0] + 1) >= at(args[0]))
+            {
+                stop(17);
+                return 0;
+            }
+            at(args[0] + 2 + at(args[0] + 1)) = args[1];
+            at(args[0] + 1)++;
+            return args[0];
+
+        case STRING_ERASE_LAST_CHAR:
+            if (at(args[0] + 1) == 0)
+            {
+                stop(18);
+                return 0;
+            }
+            at(args[0] + 1)--;
+            return 0;
+
+        case STRING_INT_VALUE:
+        {
+            int i = 0;
+            bool negative = false;
+
+            value = 0;
+            if (at(args[0] + 1) > 0 && at(args[0] + 2) == '-')
+            {
+                negative = true;
+                i++;
+            }
+            for (; i < at(args[0] + 1); i++)
+            {
+                short c = at(args[0] + 2 + i);
+
+                if (c < '0' || c > '9')
+                    break;
+                value = value * 10 + (c - '0');
+            }
+            return toWord(negative ? -value : value);
+        }
+
+        case STRING_SET_INT:
+            line = std::to_string(args[1]);
+            if ((int) line.length() > at(args[0]))
+            {
+                stop(19);
+                return 0;
+            }
+            at(args[0] + 1) = 0;
+            appendText(args[0], line.c_str());
+            return 0;
+
+        case STRING_BACK_SPACE:
+            return BACK_SPACE;
+
+        case STRING_DOUBLE_QUOTE:
+            return '"';
+
+        case STRING_NEW_LINE:
+            return NEW_LINE;
+
+        case OUTPUT_MOVE_CURSOR:
+            if (args[0] < 0 || args[0] > 22 || args[1] < 0 || args[1] > 63)
+            {
+                stop(20);
+                return 0;
+            }
+            // With no screen, text at a new place starts a new line
+            if (!output.empty() && output[output.length() - 1] != '\n')
+                output += '\n';
+            return 0;
+
+        case OUTPUT_PRINT_CHAR:
+            if (args[0] == NEW_LINE)
+                output += '\n';
+            else if (args[0] == BACK_SPACE)
+                goto backSpace;
+            else
+                output += (char) args[0];
+            return 0;
+
+        case OUTPUT_PRINT_STRING:
+            for (int i = 0; i < at(args[0] + 1); i++)
+                output += (char) at(args[0] + 2 + i);
+            cycles += at(args[0] + 1) * CHARACTER_CYCLES;
+            return 0;
+
+        case OUTPUT_PRINT_INT:
+            line = std::to_string(args[0]);
+            output += line;
+            cycles += line.length() * CHARACTER_CYCLES;
+            return 0;
+
+        case OUTPUT_PRINTLN:
+            output += '\n';
+            return 0;
+
+        case OUTPUT_BACK_SPACE:
+        backSpace:
+            if (!output.empty() && output[output.length() - 1] != '\n')
+                output.erase(output.length() - 1);
+            return 0;
+
+        case SCREEN_CLEAR_SCREEN:
+            memset(ram + SCREEN, 0, (KEYBOARD - SCREEN) * sizeof(short));
+            return 0;
+
+        case SCREEN_SET_COLOR:
+            color = (args[0] != 0);
+            return 0;
+
+        case SCREEN_DRAW_PIXEL:
+            if (!drawPixel(args[0], args[1]))
+                stop(7);
+            return 0;
+
+        case SCREEN_DRAW_LINE:
+            if (!drawLine(args[0], args[1], args[2], args[3], cycles))
+                stop(8);
+            return 0;
+
+        case SCREEN_DRAW_RECTANGLE:
+            if (!drawRectangle(args[0], args[1], args[2], args[3], cycles))
+                stop(9);
+            return 0;
+
+        case SCREEN_DRAW_CIRCLE:
+            if (!drawCircle(args[0], args[1], args[2], cycles))
+                stop((args[2] < 0 || args[2] > 181) ? 13 : 12);
+            return 0;
+
+        case KEYBOARD_KEY_PRESSED:
+            ram[KEYBOARD] = readKey();
+            return ram[KEYBOARD];
+
+        case KEYBOARD_READ_CHAR:
+            if (inputPosition >= input.length())
+            {
+                setFault("ran out of keyboard input");
+                return 0;
+            }
+            value = (unsigned char) input[inputPosition++];
+            if (value == '\n')
+                value = NEW_LINE;
+            else
+                output += (char) value;
+            return (short) value;
+
+        case KEYBOARD_READ_LINE:
+            line = readLine(args[0]);
+            value = newString((int) line.length());
+            if (stopped)
+                return 0;
+            appendText((short) value, line.c_str());
+            return (short) value;
+
+        case KEYBOARD_READ_INT:
+            line = readLine(args[0]);
+            return toWord(atoi(line.c_str()));
+
+        case SYS_HALT:
+            stopped = true;
+            return 0;
+
+        case SYS_ERROR:
+            stop(args[0]);
+            return 0;
+
+        case SYS_WAIT:
+            if (args[0] < 0)
+                stop(1);
+            return 0;
+    }
+    return 0;
+}
+
+/*
+ Allocates a block of the heap, reusing the first freed block that is big
+ enough. Each block is preceded by its size, as in the standard OS.
+ */
+short VMInterpreter::allocate(int size)
+{
+    std::map<int, int>::iterator it;
+
+    for (it = freeBlocks.begin(); it != freeBlocks.end(); it++)
+    {
+        if (it->second >= size)
+        {
+            int address = it->first;
+
+            freeBlocks.erase(it);
+            return (short) address;
+        }
+    }
+
+    if (heapTop + size + 1 > HEAP_END)
+    {
+        stop(6);
+        return 0;
+    }
+    ram[heapTop] = (short) size;
+    heapTop += size + 1;
+    return (short) (heapTop - size);
+}
+
+/*
+ Returns a block to the heap.
+ */
+void VMInterpreter::deallocate(int address)
+{
+    if (address > HEAP_BASE && address < heapTop)
+        freeBlocks[address] = ram[address - 1];
+}
+
+/*
+ Allocates an empty String object: its capacity, its length and then its
+ characters.
+ */
+short VMInterpreter::newString(int maxLength)
+{
+    short string = allocate(std::max(maxLength, 1) + 2);
+
+    if (string != 0)
+    {
+        ram[string] = (short) maxLength;
+        ram[string + 1] = 0;
+    }
+    return string;
+}
+
+/*
+ Appends characters to a String object, which must have room for them.
+ */
+void VMInterpreter::appendText(short string, const char *text)
+{
+    for (; *text != '\0'; text++)
+        at(string + 2 + at(string + 1)++) = *text;
+}
+
+/*
+ Sets or clears one pixel in the current color. Returns false if it is off
+ the screen.
+ */
+bool VMInterpreter::drawPixel(int x, int y)
+{
+    short *word;
+
+    if (x < 0 || x > 511 || y < 0 || y > 255)
+        return false;
+
+    word = ram + SCREEN + y * 32 + x / 16;
+    if (color)
+        *word = (short) (*word | (1 << (x & 15)));
+    else
+        *word = (short) (*word & ~(1 << (x & 15)));
+    return true;
+}
+
+/*
+ Draws a line between two points with Bresenham's algorithm.
+ */
+bool VMInterpreter::drawLine(int x1, int y1, int x2, int y2,
+                             long long &cycles)
+{
+    int dx = std::abs(x2 - x1);
+    int dy = -std::abs(y2 - y1);
+    int sx = (x1 < x2) ? 1 : -1;
+    int sy = (y1 < y2) ? 1 : -1;
+    int error = dx + dy;
+
+    if (x1 < 0 || x1 > 511 || x2 < 0 || x2 > 511 ||
+        y1 < 0 || y1 > 255 || y2 < 0 || y2 > 255)
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        drawPixel(x1, y1);
+        cycles += LINE_PIXEL_CYCLES;
+        if (x1 == x2 && y1 == y2)
+            break;
+        if (2 * error >= dy)
+        {
+            error += dy;
+            x1 += sx;
+        }
+        if (2 * error <= dx)
+        {
+            error += dx;
+            y1 += sy;
+        }
+    }
+    return true;
+}
+
+/*
+ Fills a rectangle, given its top left and bottom right corners.
+ */
+bool VMInterpreter::drawRectangle(int x1, int y1, int x2, int y2,
+                                  long long &cycles)
+{
+    if (x1 > x2 || y1 > y2 || x1 < 0 || x2 > 511 || y1 < 0 || y2 > 255)
+        return false;
+
+    for (int y = y1; y <= y2; y++)
+        fillRow(y, x1, x2);
+    cycles += (long long) (y2 - y1 + 1) * ROW_CYCLES;
+    return true;
+}
+
+/*
+ Fills a circle, one row at a time.
+ */
+bool VMInterpreter::drawCircle(int x, int y, int r, long long &cycles)
+{
+    if (x < 0 || x > 511 || y < 0 || y > 255)
+        return false;
+    if (r < 0 || r > 181 || x - r < 0 || x + r > 511 ||
+        y - r < 0 || y + r > 255)
+    {
+        return false;
+    }
+
+    for (int dy = -r; dy <= r; dy++)
+    {
+        int dx = 0;
+
+        while ((dx + 1) * (dx + 1) + dy * dy <= r * r)
+            dx++;
+        fillRow(y + dy, x - dx, x + dx);
+    }
+    cycles += (long long) (2 * r + 1) * ROW_CYCLES;
+    return true;
+}
+
+void VMInterpreter::fillRow(int y, int x1, int x2)
+{
+    for (int x = x1; x <= x2; x++)
+        drawPixel(x, y);
+}
+
+/*
+ Returns the key held down, for Keyboard.keyPressed. Each character of the
+ input is held for one call and released for the next, so that programs
+ that wait for a key to be released see it happen; once the input is used
+ up no key is ever pressed.
+ */
+short VMInterpreter::readKey()
+{
+    short key;
+
+    if (keyHeld || inputPosition >= input.length())
+    {
+        keyHeld = false;
+        return 0;
+    }
+
+    key = (unsigned char) input[inputPosition++];
+    keyHeld = true;
+    return (key == '\n') ? (short) NEW_LINE : key;
+}
+
+/*
+ Prints a prompt and reads a line of input, echoing it as the OS does.
+ Stops the program if the input is used up.
+ */
+string VMInterpreter::readLine(short prompt)
+{
+    string line;
+    size_t end;
+
+    for (int i = 0; i < at(prompt + 1); i++)
+        output += (char) at(prompt + 2 + i);
+
+    if (inputPosition >= input.length())
+    {
+        setFault("ran out of keyboard input");
+        return line;
+    }
+
+    end = input.find('\n', inputPosition);
+    if (end == string::npos)
+        end = input.length();
+    line = input.substr(inputPosition, end - inputPosition);
+    inputPosition = std::min(end + 1, input.length());
+    output += line + "\n";
+    return line;
+}
+
+/*
+ Stops the program as Sys.error does, printing the error code.
+ */
+void VMInterpreter::stop(int code)
+{
+    if (errorCode != 0)
+        return;
+
+    errorCode = code;
+    status = RUN_SYS_ERROR;
+    stopped = true;
+    output += "ERR" + std::to_string(code);
+}
+
+/*
+ Stops the program because the machine could not go on.
+ */
+void VMInterpreter::setFault(const char *reason)
+{
+    fault = reason;
+    status = RUN_FAULT;
+    stopped = true;
+}
+
+/*
+ Returns everything the program printed, and the input it echoed.
+ */
+const string &VMInterpreter::getOutput()
+{
+    return output;
+}
+
+/*
+ Returns the code the program passed to Sys.error, or 0.
+ */
+int VMInterpreter::getErrorCode()
+{
+    return errorCode;
+}
+
+/*
+ Returns why the machine could not go on, after a run that faulted.
+ */
+const string &VMInterpreter::getFault()
+{
+    return fault;
+}
+
+/*
+ Returns the number of VM instructions the last run executed, not counting
+ labels or the instructions of the OS.
+ */
+long long VMInterpreter::getInstructionCount()
+{
+    long long count = 0;
+
+    for (size_t i = 2; i < hits.size(); i++)
+        count += hits[i];
+    return count;
+}
+
+/*
+ Returns the estimated Hack machine cycles of the last run, including the
+ OS.
+ */
+long long VMInterpreter::getCycleCount()
+{
+    long long count = 0;
+
+    for (size_t i = 0; i < hits.size(); i++)
+        count += hits[i] * cost[i];
+    for (int n = 0; n < NATIVE_COUNT; n++)
+        count += nativeCycles[n];
+    return count;
+}
+
+/*
+ Writes the calls, VM instructions and estimated cycles of each subroutine
+ and OS subroutine the last run used, most expensive first. Cycles are
+ those spent in the subroutine itself, not in the ones it called.
+ */
+void VMInterpreter::writeProfile(std::ostream &out)
+{
+    struct Row
+    {
+        string name;
+        long long calls;
+        long long instructions;
+        long long cycles;
+
+        bool operator<(const Row &other) const
+        {
+            if (cycles != other.cycles)
+                return cycles > other.cycles;
+            return name < other.name;
+        }
+    };
+    vector<Row> rows;
+
+    for (size_t s = 0; s < subroutines.size(); s++)
+    {
+        Row row = { subroutines[s].name, hits[subroutines[s].start], 0, 0 };
+
+        for (int i = subroutines[s].start; i < subroutines[s].end; i++)
+        {
+            row.instructions += hits[i];
+            row.cycles += hits[i] * cost[i];
+        }
+        if (row.calls > 0)
+            rows.push_back(row);
+    }
+    for (int n = 0; n < NATIVE_COUNT; n++)
+    {
+        Row row = { natives[n].name, nativeCalls[n], 0, nativeCycles[n] };
+
+        if (row.calls > 0)
+            rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end());
+
+    out << std::left << std::setw(32) << "subroutine" << std::right
+        << std::setw(12) << "calls" << std::setw(16) << "instructions"
+        << std::setw(16) << "cycles" << "\n";
+    for (size_t r = 0; r < rows.size(); r++)
+    {
+        out << std::left << std::setw(32) << rows[r].name << std::right
+            << std::setw(12) << rows[r].calls << std::setw(16)
+            << rows[r].instructions << std::setw(16) << rows[r].cycles
+            << "\n";
+    }
+    out << std::left << std::setw(32) << "total" << std::right
+        << std::setw(12) << "" << std::setw(16) << getInstructionCount()
+        << std::setw(16) << getCycleCount() << "\n";
+}
+
+/*
+ Writes the screen as a 512 by 256 PBM image.
+ */
+bool VMInterpreter::writeScreen(const string &fileName)
+{
+    OutputFile out;
+
+    if (!out.open(fileName))
+        return false;
+
+    out.append("P4\n512 256\n");
+    for (int word = SCREEN; word < KEYBOARD; word++)
+    {
+        char bytes[2] = { 0, 0 };
+
+        // The screen's leftmost pixel is bit 0; PBM's is the high bit
+        for (int bit = 0; bit < 16; bit++)
+        {
+            if (ram[word] & (1 << bit))
+                bytes[bit / 8] |= (char) (0x80 >> (bit % 8));
+        }
+        out.append(bytes, 2);
+    }
+    return out.close();
+}
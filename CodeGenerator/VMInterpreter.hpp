@@ -0,0 +1,144 @@
+/*
+ VMInterpreter.hpp
+ CodeGenerator
+
+ Runs a compiled program on a model of the Hack machine, so that the code
+ the compiler generates can be measured without an external emulator. The
+ VM code is first translated into a flat array of operations with every
+ segment, label and call resolved, and then run by a dispatch loop that
+ jumps straight from one operation's handler to the next. The OS classes
+ are implemented natively, on the same RAM the program sees, and the screen
+ is an ordinary block of that RAM with nothing to display it.
+
+ Every operation counts how often it runs. Afterwards the counts are
+ turned into the VM instructions executed and the Hack machine cycles
+ spent in each subroutine, estimated from the length of the assembly a
+ straightforward VM translator produces for each instruction and of the
+ standard OS's subroutines.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef VMInterpreter_hpp
+#define VMInterpreter_hpp
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include "VMCode.hpp"
+#include "VMProgram.hpp"
+
+using std::string;
+using std::vector;
+
+/*
+ How a run ended.
+ */
+enum RunStatus
+{
+    RUN_HALTED = 0, RUN_SYS_ERROR, RUN_FAULT, RUN_STEP_LIMIT
+};
+
+class VMInterpreter
+{
+private:
+    /*
+     One operation of the translated program. a and b hold whatever the
+     operation needs: an index, a RAM address, a target operation, a
+     native subroutine or an argument count.
+     */
+    struct Operation
+    {
+        int op;
+        int a;
+        int b;
+    };
+
+    /*
+     A subroutine of the program and the range of operations it occupies.
+     */
+    struct Subroutine
+    {
+        string name;
+        int start;
+        int end;
+    };
+
+    static const int RAM_SIZE = 32768;
+    static const int STATIC_BASE = 16;
+    static const int STACK_BASE = 256;
+    static const int HEAP_BASE = 2048;
+    static const int HEAP_END = 16384;
+    static const int SCREEN = 16384;
+    static const int KEYBOARD = 24576;
+
+    vector<Operation> operations;
+    vector<int> cost;
+    vector<long long> hits;
+    vector<Subroutine> subroutines;
+    vector<long long> nativeCalls;
+    vector<long long> nativeCycles;
+    short ram[RAM_SIZE];
+    std::map<int, int> freeBlocks;
+    int heapTop;
+    bool color;
+    string input;
+    size_t inputPosition;
+    bool keyHeld;
+    string output;
+    long long stepLimit;
+    int errorCode;
+    string fault;
+    int status;
+    bool stopped;
+
+private:
+    bool link(VMProgram &program, string &diagnostics);
+    void reset();
+    short callNative(int native, short *args, long long &cycles);
+    short allocate(int size);
+    void deallocate(int address);
+    short newString(int maxLength);
+    void appendText(short string, const char *text);
+    bool drawPixel(int x, int y);
+    bool drawLine(int x1, int y1, int x2, int y2, long long &cycles);
+    bool drawRectangle(int x1, int y1, int x2, int y2, long long &cycles);
+    bool drawCircle(int x, int y, int r, long long &cycles);
+    void fillRow(int y, int x1, int x2);
+    short readKey();
+    string readLine(short prompt);
+    void stop(int code);
+    void setFault(const char *reason);
+
+    /*
+     Returns a word of RAM, wrapping the address as the Hack machine does.
+     */
+    short &at(int address)
+    {
+        return ram[address & (RAM_SIZE - 1)];
+    }
+
+    /*
+     Wraps a value to 16 bits, as the Hack machine's arithmetic does.
+     */
+    static short toWord(int value)
+    {
+        return (short) (unsigned short) value;
+    }
+
+public:
+    VMInterpreter();
+    bool load(VMProgram &program, string &diagnostics);
+    void setInput(const string &text);
+    void setStepLimit(long long limit);
+    int run();
+    const string &getOutput();
+    int getErrorCode();
+    const string &getFault();
+    long long getInstructionCount();
+    long long getCycleCount();
+    void writeProfile(std::ostream &out);
+    bool writeScreen(const string &fileName);
+};
+
+#endif /* VMInterpreter_hpp */
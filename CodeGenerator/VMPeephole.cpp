@@ -0,0 +1,538 @@
+/*
+ VMPeephole.cpp
+ CodeGenerator
+
+ A peephole pass over the VM code of a class, run before it is written. The
+ statement code the VMGenerator builds from fixed templates leaves short
+ runs of instructions that a shorter run does the same work as: a value
+ pushed and popped straight back, a condition negated only to be tested,
+ an array address put into 'that' again when it is already there, a value
+ parked in temp 0 for no reason. Each rule in a table rewrites one such
+ pattern, and counts how often it did.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "VMPeephole.hpp"
+
+/*
+ The rules, indexed by PeepholeRule. Each is tried in turn on every
+ instruction before it is added to the output, and the first that applies
+ replaces it.
+ */
+const VMPeephole::Rule VMPeephole::rules[PEEPHOLE_RULE_COUNT] =
+{
+    { "push-pop", &VMPeephole::pushPop },
+    { "double-not", &VMPeephole::doubleNot },
+    { "not-compare", &VMPeephole::notCompare },
+    { "eq-not-if-goto", &VMPeephole::notEqualBranch },
+    { "invert-branch", &VMPeephole::invertBranch },
+    { "zero-operand", &VMPeephole::zeroOperand },
+    { "array-store", &VMPeephole::arrayStore },
+    { "array-update", &VMPeephole::arrayUpdate },
+    { "same-address", &VMPeephole::sameAddress },
+    { "dead-temp", &VMPeephole::deadTemp }
+};
+
+VMPeephole::VMPeephole()
+{
+    for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++)
+        hits[r] = 0;
+    in = NULL;
+    position = 0;
+    thatKnown = false;
+}
+
+/*
+ Rewrites the instructions of a class in place. The counts of the rules
+ applied are added to those of earlier calls.
+ */
+void VMPeephole::optimize(VMCode &code)
+{
+    vector<VMInstruction> &instructions = code.getInstructions();
+
+    in = &instructions;
+    out.clear();
+    out.reserve(instructions.size());
+    thatKnown = false;
+
+    for (position = 0; position < instructions.size(); )
+    {
+        VMInstruction next = instructions[position++];
+        emit(next);
+    }
+
+    instructions.swap(out);
+    out.clear();
+    in = NULL;
+}
+
+/*
+ Adds an instruction to the output, or whatever the first rule that applies
+ to it puts there instead.
+ */
+void VMPeephole::emit(const VMInstruction &next)
+{
+    for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++)
+    {
+        if ((this->*rules[r].apply)(next))
+        {
+            hits[r]++;
+            return;
+        }
+    }
+
+    trackThat(next);
+    out.push_back(next);
+}
+
+/*
+ push s i; pop s i
+ Puts back the value that was already there.
+ */
+bool VMPeephole::pushPop(const VMInstruction &next)
+{
+    if (next.op != VM_POP || !tailIs(0, VM_PUSH) ||
+        out.back().segment != next.segment || out.back().value != next.value)
+    {
+        return false;
+    }
+
+    out.pop_back();
+    return true;
+}
+
+/*
+ not; not
+ */
+bool VMPeephole::doubleNot(const VMInstruction &next)
+{
+    if (next.op != VM_NOT || !tailIs(0, VM_NOT))
+        return false;
+
+    out.pop_back();
+    return true;
+}
+
+/*
+ push constant k; lt; not  =>  push constant k-1; gt
+ push constant k; gt; not  =>  push constant k+1; lt
+ x >= k is x > k-1, and x <= k is x < k+1, as long as k-1 and k+1 can still
+ be pushed. Loops and ifs test such conditions negated, so this usually
+ takes the not out of a branch.
+ */
+bool VMPeephole::notCompare(const VMInstruction &next)
+{
+    int compare;
+    int constant;
+
+    if (next.op != VM_NOT || out.size() < 2 ||
+        !is(out[out.size() - 2], VM_PUSH, SEG_CONSTANT, -1))
+    {
+        return false;
+    }
+
+    compare = out.back().op;
+    constant = out[out.size() - 2].value;
+    if (compare == VM_LT && constant > 0)
+        constant--;
+    else if (compare == VM_GT && constant < 32767)
+        constant++;
+    else
+        return false;
+
+    out.resize(out.size() - 2);
+    emit(make(VM_PUSH, SEG_CONSTANT, constant, -1));
+    emit(make((compare == VM_LT) ? VM_GT : VM_LT, 0, 0, -1));
+    return true;
+}
+
+/*
+ eq; not; if-goto L  =>  sub; if-goto L
+ The values differ exactly when their difference is not 0.
+ */
+bool VMPeephole::notEqualBranch(const VMInstruction &next)
+{
+    if (next.op != VM_IF_GOTO || !tailIs(0, VM_NOT) || !tailIs(1, VM_EQ))
+        return false;
+
+    out.resize(out.size() - 2);
+    emit(make(VM_SUB, 0, 0, -1));
+    emit(next);
+    return true;
+}
+
+/*
+ eq|gt|lt; not; if-goto A; goto B; label A  =>  eq|gt|lt; if-goto B; label A
+ The VM has no branch for a false condition, so an if with an empty branch
+ jumps over a jump. It may only be turned around when the condition is a
+ comparison: if-goto branches on anything but 0, and not maps only true
+ (-1) and false (0) onto each other.
+ */
+bool VMPeephole::invertBranch(const VMInstruction &next)
+{
+    size_t size = out.size();
+    int compare;
+    int target;
+
+    if (next.op != VM_LABEL || size < 4 || !tailIs(0, VM_GOTO) ||
+        !tailIs(1, VM_IF_GOTO) || out[size - 2].name != next.name ||
+        !tailIs(2, VM_NOT))
+    {
+        return false;
+    }
+
+    compare = out[size - 4].op;
+    if (compare != VM_EQ && compare != VM_GT && compare != VM_LT)
+        return false;
+
+    target = out.back().name;
+    out.resize(size - 3);
+    emit(make(VM_IF_GOTO, 0, 0, target));
+    emit(next);
+    return true;
+}
+
+/*
+ push constant 0; add|sub|or
+ */
+bool VMPeephole::zeroOperand(const VMInstruction &next)
+{
+    if ((next.op != VM_ADD && next.op != VM_SUB && next.op != VM_OR) ||
+        out.empty() || !is(out.back(), VM_PUSH, SEG_CONSTANT, 0))
+    {
+        return false;
+    }
+
+    out.pop_back();
+    return true;
+}
+
+/*
+ value; pop temp 0; pop pointer 1; push temp 0  =>  pop pointer 1; value
+ A let to an array element parks the value in temp 0 while 'that' is
+ pointed at the element, because the address was pushed first. When the
+ value is computed without calls and without reading 'that', it can be
+ computed after 'that' is set instead.
+ */
+bool VMPeephole::arrayStore(const VMInstruction &next)
+{
+    vector<VMInstruction> value;
+    int start;
+
+    if (!is(next, VM_POP, SEG_POINTER, 1) || out.empty() ||
+        !is(out.back(), VM_POP, SEG_TEMP, 0) || position >= in->size() ||
+        !is((*in)[position], VM_PUSH, SEG_TEMP, 0) ||
+        !isTempDead(0, position + 1))
+    {
+        return false;
+    }
+
+    start = findValue(out.size() - 1, VALUE_MOVABLE);
+    if (start < 0)
+        return false;
+
+    value.assign(out.begin() + start, out.end() - 1);
+    out.resize(start);
+    position++;
+
+    emit(next);
+    for (size_t i = 0; i < value.size(); i++)
+        emit(value[i]);
+    return true;
+}
+
+/*
+ address; address; pop pointer 1; push that 0; value; pop temp 0;
+ pop pointer 1; push temp 0  =>  address; pop pointer 1; push that 0; value
+ A let that changes an array element by its own value, as a[i] = a[i] + 1
+ does, computes the address twice, and the second time 'that' is set to it
+ already. The first address need not be pushed at all, nor the value
+ parked, as long as the value is computed without calls and without
+ setting 'that' again.
+ */
+bool VMPeephole::arrayUpdate(const VMInstruction &next)
+{
+    size_t size = out.size();
+    int value;
+    int second;
+    int first;
+
+    if (!is(next, VM_POP, SEG_POINTER, 1) || size < 3 ||
+        !is(out.back(), VM_POP, SEG_TEMP, 0) || position >= in->size() ||
+        !is((*in)[position], VM_PUSH, SEG_TEMP, 0) ||
+        !isTempDead(0, position + 1))
+    {
+        return false;
+    }
+
+    value = findValue(size - 1, VALUE_ANY);
+    if (value < 2 || !is(out[value - 1], VM_POP, SEG_POINTER, 1))
+        return false;
+
+    second = findValue(value - 1, VALUE_ADDRESS);
+    if (second < 0)
+        return false;
+
+    first = findValue(second, VALUE_ADDRESS);
+    if (first < 0 || second - first != value - 1 - second ||
+        !sameCode(&out[first], &out[second], second - first))
+    {
+        return false;
+    }
+
+    out.pop_back();
+    out.erase(out.begin() + first, out.begin() + second);
+    position++;
+    return true;
+}
+
+/*
+ address; pop pointer 1
+ Drops the setting of 'that' to the address it already holds. Arrays are
+ often read twice at one index, as in a[i] * a[i] or a swap.
+ */
+bool VMPeephole::sameAddress(const VMInstruction &next)
+{
+    int start;
+
+    if (!thatKnown || !is(next, VM_POP, SEG_POINTER, 1))
+        return false;
+
+    start = findValue(out.size(), VALUE_ADDRESS);
+    if (start < 0 || out.size() - start != thatAddress.size() ||
+        !sameCode(&out[start], &thatAddress[0], thatAddress.size()))
+    {
+        return false;
+    }
+
+    out.resize(start);
+    return true;
+}
+
+/*
+ push x; pop temp i
+ Drops a value parked in a temp that is not read again, such as the 0 a
+ void subroutine returns when its body has been inlined at a do.
+ */
+bool VMPeephole::deadTemp(const VMInstruction &next)
+{
+    if (next.op != VM_POP || next.segment != SEG_TEMP ||
+        !tailIs(0, VM_PUSH) || !isTempDead(next.value, position))
+    {
+        return false;
+    }
+
+    out.pop_back();
+    return true;
+}
+
+/*
+ Keeps track of the address 'that' points at, as far as it is known, for
+ sameAddress(). It is forgotten at any jump or label, and when something
+ it was computed from may have changed. A call leaves 'that' itself as it
+ was, since the return restores it, but may change statics and fields.
+ */
+void VMPeephole::trackThat(const VMInstruction &next)
+{
+    int start;
+
+    switch (next.op)
+    {
+        case VM_LABEL:
+        case VM_GOTO:
+        case VM_IF_GOTO:
+        case VM_FUNCTION:
+        case VM_RETURN:
+            thatKnown = false;
+            break;
+
+        case VM_CALL:
+            if (reads(thatAddress, SEG_STATIC) || reads(thatAddress, SEG_THIS))
+                thatKnown = false;
+            break;
+
+        case VM_POP:
+            if (next.segment == SEG_POINTER && next.value == 1)
+            {
+                start = findValue(out.size(), VALUE_ADDRESS);
+                thatKnown = (start >= 0);
+                if (thatKnown)
+                    thatAddress.assign(out.begin() + start, out.end());
+                break;
+            }
+
+            // 'that' may point into the object 'this' points at
+            if ((next.segment == SEG_POINTER || next.segment == SEG_THAT) &&
+                reads(thatAddress, SEG_THIS))
+            {
+                thatKnown = false;
+            }
+
+            for (size_t i = 0; i < thatAddress.size(); i++)
+            {
+                if (is(thatAddress[i], VM_PUSH, next.segment, next.value))
+                    thatKnown = false;
+            }
+            break;
+    }
+}
+
+/*
+ Finds the instructions just before end that push one value and do nothing
+ else: pushes and arithmetic, reading nothing from below where they begin.
+ Returns the index of the first of them, or -1 if there are none. An
+ address may only read variables and constants, and a movable value
+ anything but 'that'.
+ */
+int VMPeephole::findValue(size_t end, int kind)
+{
+    int needed = 1;
+
+    for (size_t i = end; i-- > 0; )
+    {
+        const VMInstruction &instruction = out[i];
+        int segment = instruction.segment;
+
+        switch (instruction.op)
+        {
+            case VM_PUSH:
+                if (kind == VALUE_ADDRESS && (segment == SEG_THAT ||
+                                              segment == SEG_POINTER ||
+                                              segment == SEG_TEMP))
+                {
+                    return -1;
+                }
+                if (kind == VALUE_MOVABLE && (segment == SEG_THAT ||
+                    is(instruction, VM_PUSH, SEG_POINTER, 1)))
+                {
+                    return -1;
+                }
+                needed--;
+                break;
+            case VM_ADD:
+            case VM_SUB:
+            case VM_EQ:
+            case VM_GT:
+            case VM_LT:
+            case VM_AND:
+            case VM_OR:
+                needed++;
+                break;
+            case VM_NEG:
+            case VM_NOT:
+                break;
+            default:
+                return -1;
+        }
+
+        if (needed == 0)
+            return (int) i;
+    }
+    return -1;
+}
+
+/*
+ Determines whether temp i is written again, from instruction from of the
+ input on, before it is read. The VMGenerator only keeps a value in a temp
+ for the few instructions of one operation, never across a call or a jump,
+ so at those it is dead too.
+ */
+bool VMPeephole::isTempDead(int index, size_t from)
+{
+    for (size_t i = from; i < in->size(); i++)
+    {
+        const VMInstruction &instruction = (*in)[i];
+
+        if (instruction.op == VM_PUSH || instruction.op == VM_POP)
+        {
+            if (instruction.segment == SEG_TEMP && instruction.value == index)
+                return (instruction.op == VM_POP);
+        }
+        else if (instruction.op >= VM_LABEL)
+        {
+            return true;
+        }
+    }
+    return true;
+}
+
+/*
+ Determines whether two runs of instructions are the same.
+ */
+bool VMPeephole::sameCode(const VMInstruction *a, const VMInstruction *b,
+                          size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (a[i].op != b[i].op || a[i].segment != b[i].segment ||
+            a[i].value != b[i].value)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ Determines whether a run of instructions pushes from a segment.
+ */
+bool VMPeephole::reads(const vector<VMInstruction> &run, int segment)
+{
+    for (size_t i = 0; i < run.size(); i++)
+    {
+        if (run[i].op == VM_PUSH && run[i].segment == segment)
+            return true;
+    }
+    return false;
+}
+
+/*
+ Determines whether the instruction back places from the end of the output
+ is the given operation.
+ */
+bool VMPeephole::tailIs(size_t back, int op)
+{
+    return (out.size() > back && out[out.size() - 1 - back].op == op);
+}
+
+VMInstruction VMPeephole::make(int op, int segment, int value, int name)
+{
+    VMInstruction instruction;
+
+    instruction.op = (unsigned char) op;
+    instruction.segment = (unsigned char) segment;
+    instruction.value = value;
+    instruction.name = name;
+    return instruction;
+}
+
+/*
+ Determines whether an instruction is the given push or pop. A value of -1
+ matches any index.
+ */
+bool VMPeephole::is(const VMInstruction &instruction, int op, int segment,
+                    int value)
+{
+    return (instruction.op == op && instruction.segment == segment &&
+            (value < 0 || instruction.value == value));
+}
+
+/*
+ Returns the number of times a rule has been applied.
+ */
+int VMPeephole::getHits(int rule) const
+{
+    if (rule < 0 || rule >= PEEPHOLE_RULE_COUNT)
+        return 0;
+
+    return hits[rule];
+}
+
+const char *VMPeephole::getRuleName(int rule)
+{
+    if (rule < 0 || rule >= PEEPHOLE_RULE_COUNT)
+        return "";
+
+    return rules[rule].name;
+}
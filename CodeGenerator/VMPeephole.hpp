@@ -0,0 +1,99 @@
+/*
+ VMPeephole.hpp
+ CodeGenerator
+
+ A peephole pass over the VM code of a class, run before it is written. The
+ statement code the VMGenerator builds from fixed templates leaves short
+ runs of instructions that a shorter run does the same work as: a value
+ pushed and popped straight back, a condition negated only to be tested,
+ an array address put into 'that' again when it is already there, a value
+ parked in temp 0 for no reason. Each rule in a table rewrites one such
+ pattern, and counts how often it did.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef VMPeephole_hpp
+#define VMPeephole_hpp
+
+#include <iostream>
+#include <vector>
+#include "VMCode.hpp"
+
+using std::string;
+using std::vector;
+
+/*
+ The rewrites the pass makes, in the order they are tried.
+ */
+enum PeepholeRule
+{
+    PEEP_PUSH_POP = 0, PEEP_DOUBLE_NOT, PEEP_NOT_COMPARE, PEEP_NOT_EQ_BRANCH,
+    PEEP_INVERT_BRANCH, PEEP_ZERO_OPERAND, PEEP_ARRAY_STORE,
+    PEEP_ARRAY_UPDATE, PEEP_SAME_ADDRESS, PEEP_DEAD_TEMP, PEEPHOLE_RULE_COUNT
+};
+
+class VMPeephole
+{
+private:
+    // The kinds of value findValue() looks for
+    enum ValueKind
+    {
+        VALUE_ADDRESS = 0, VALUE_MOVABLE, VALUE_ANY
+    };
+
+    /*
+     A rule: its name, for reports, and the function that tries it on the
+     next instruction. The function returns true if it rewrote the code,
+     which it does by taking instructions off the end of the output and
+     emitting others in place of them and of the next instruction.
+     */
+    struct Rule
+    {
+        const char *name;
+        bool (VMPeephole::*apply)(const VMInstruction &next);
+    };
+
+    static const Rule rules[PEEPHOLE_RULE_COUNT];
+
+    int hits[PEEPHOLE_RULE_COUNT];
+    const vector<VMInstruction> *in;
+    size_t position;
+    vector<VMInstruction> out;
+
+    // The instructions that computed the address 'that' points at, if it
+    // still holds and is known
+    vector<VMInstruction> thatAddress;
+    bool thatKnown;
+
+private:
+    void emit(const VMInstruction &next);
+    bool pushPop(const VMInstruction &next);
+    bool doubleNot(const VMInstruction &next);
+    bool notCompare(const VMInstruction &next);
+    bool notEqualBranch(const VMInstruction &next);
+    bool invertBranch(const VMInstruction &next);
+    bool zeroOperand(const VMInstruction &next);
+    bool arrayStore(const VMInstruction &next);
+    bool arrayUpdate(const VMInstruction &next);
+    bool sameAddress(const VMInstruction &next);
+    bool deadTemp(const VMInstruction &next);
+    void trackThat(const VMInstruction &next);
+    int findValue(size_t end, int kind);
+    static bool sameCode(const VMInstruction *a, const VMInstruction *b,
+                         size_t length);
+    static bool reads(const vector<VMInstruction> &run, int segment);
+    bool isTempDead(int index, size_t from);
+    bool tailIs(size_t back, int op);
+    static VMInstruction make(int op, int segment, int value, int name);
+    static bool is(const VMInstruction &instruction, int op, int segment,
+                   int value);
+
+public:
+    VMPeephole();
+    void optimize(VMCode &code);
+    int getHits(int rule) const;
+    static const char *getRuleName(int rule);
+};
+
+#endif /* VMPeephole_hpp */
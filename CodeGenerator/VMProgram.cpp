@@ -0,0 +1,553 @@
+/*
+ VMProgram.cpp
+ CodeGenerator
+
+ The VM code of every class in a program, held in memory so that it can be
+ optimized as a whole before any of it is written. Jack resolves every call
+ at compile time, so the call graph is exact: a subroutine that cannot be
+ reached from the program's entry point is never run, and is removed along
+ with the static variables that only it used, and a call to a small
+ subroutine can be replaced by a copy of its body, even across classes.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "VMProgram.hpp"
+#include "VMWriter.hpp"
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+/*
+ Starts with no classes.
+ */
+VMProgram::VMProgram()
+{
+    removedFunctions = 0;
+    removedStatics = 0;
+    inlinedCalls = 0;
+}
+
+/*
+ Sets the number of classes in the program. Each is then filled in by
+ setUnit(), which may be called from several threads for different units.
+ */
+void VMProgram::setUnitCount(int count)
+{
+    units.clear();
+    units.resize(count);
+}
+
+/*
+ Takes over the VM code of one class, leaving the given VMCode empty. The
+ code is written to outFileName by write().
+ */
+void VMProgram::setUnit(int unit, string outFileName, VMCode &code)
+{
+    units[unit].outFileName = outFileName;
+    units[unit].code.swap(code);
+}
+
+/*
+ Indexes every function in the program by name.
+ */
+void VMProgram::findFunctions()
+{
+    functions.clear();
+    functionIndex.clear();
+
+    for (size_t u = 0; u < units.size(); u++)
+    {
+        vector<VMInstruction> &code = units[u].code.getInstructions();
+
+        for (size_t i = 0; i < code.size(); i++)
+        {
+            if (code[i].op != VM_FUNCTION)
+                continue;
+
+            Function entry = { (int) u, (int) i, (int) code.size() };
+
+            if (!functions.empty() && functions.back().unit == (int) u)
+                functions.back().end = (int) i;
+
+            functionIndex[units[u].code.getName(code[i].name)] =
+                (int) functions.size();
+            functions.push_back(entry);
+        }
+    }
+}
+
+/*
+ Marks every function that can be reached by calls from the given one.
+ Calls to functions outside the program, such as the OS, are not followed.
+ */
+void VMProgram::markReachable(int function, vector<bool> &reachable)
+{
+    vector<int> pending(1, function);
+
+    reachable[function] = true;
+
+    while (!pending.empty())
+    {
+        Function &f = functions[pending.back()];
+        VMCode &code = units[f.unit].code;
+        vector<VMInstruction> &instructions = code.getInstructions();
+
+        pending.pop_back();
+
+        for (int i = f.start; i < f.end; i++)
+        {
+            if (instructions[i].op != VM_CALL)
+                continue;
+
+            std::unordered_map<string, int>::iterator it =
+                functionIndex.find(code.getName(instructions[i].name));
+
+            if (it != functionIndex.end() && !reachable[it->second])
+            {
+                reachable[it->second] = true;
+                pending.push_back(it->second);
+            }
+        }
+    }
+}
+
+/*
+ Removes the unreachable functions of one class.
+ */
+void VMProgram::removeFunctions(int unit, vector<bool> &reachable)
+{
+    vector<VMInstruction> &code = units[unit].code.getInstructions();
+    vector<VMInstruction> kept;
+    size_t next = 0;
+
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        if (functions[f].unit != unit)
+            continue;
+
+        // Anything before the first function is kept as it is
+        while ((int) next < functions[f].start)
+            kept.push_back(code[next++]);
+
+        if (reachable[f])
+            kept.insert(kept.end(), code.begin() + functions[f].start,
+                        code.begin() + functions[f].end);
+        else
+            removedFunctions++;
+
+        next = functions[f].end;
+    }
+    kept.insert(kept.end(), code.begin() + next, code.end());
+
+    code.swap(kept);
+}
+
+/*
+ Removes the static variables of one class that its remaining code never
+ uses, renumbering the rest in their original order.
+ */
+void VMProgram::removeStatics(int unit)
+{
+    vector<VMInstruction> &code = units[unit].code.getInstructions();
+    std::map<int, int> renumber;
+    int highest = -1;
+    int next = 0;
+
+    for (size_t i = 0; i < code.size(); i++)
+    {
+        if ((code[i].op == VM_PUSH || code[i].op == VM_POP) &&
+            code[i].segment == SEG_STATIC)
+        {
+            renumber[code[i].value] = 0;
+            if (code[i].value > highest)
+                highest = code[i].value;
+        }
+    }
+
+    for (std::map<int, int>::iterator it = renumber.begin();
+         it != renumber.end(); ++it)
+    {
+        it->second = next++;
+    }
+    removedStatics += (highest + 1) - next;
+
+    for (size_t i = 0; i < code.size(); i++)
+    {
+        if ((code[i].op == VM_PUSH || code[i].op == VM_POP) &&
+            code[i].segment == SEG_STATIC)
+        {
+            code[i].value = renumber[code[i].value];
+        }
+    }
+}
+
+/*
+ Removes every function that cannot be reached from the program's entry
+ point, and then any static variable no remaining code uses. The entry point
+ is Sys.init if the program has its own, and otherwise Main.main, which the
+ OS's Sys.init calls. Without a Sys.init of its own, a program runs on the
+ built-in OS, which calls into any OS class the program replaces, so every
+ function of such a class is kept. Returns false, leaving the program as it
+ was, if there is no entry point.
+ */
+bool VMProgram::removeDeadCode(string &diagnostics)
+{
+    static const char *const osClasses[] =
+    {
+        "Array.", "Keyboard.", "Math.", "Memory.", "Output.", "Screen.",
+        "String.", "Sys."
+    };
+    std::unordered_map<string, int>::iterator root;
+    vector<bool> reachable;
+    bool builtInOS;
+
+    findFunctions();
+
+    root = functionIndex.find("Sys.init");
+    builtInOS = root == functionIndex.end();
+    if (builtInOS)
+        root = functionIndex.find("Main.main");
+    if (root == functionIndex.end())
+    {
+        diagnostics += "program has no Main.main\n";
+        return false;
+    }
+
+    reachable.assign(functions.size(), false);
+    markReachable(root->second, reachable);
+
+    for (root = functionIndex.begin(); builtInOS && root !=
+         functionIndex.end(); ++root)
+    {
+        for (size_t i = 0; i < sizeof(osClasses) / sizeof(osClasses[0]); i++)
+        {
+            const char *prefix = osClasses[i];
+
+            if (root->first.compare(0, strlen(prefix), prefix) == 0)
+                markReachable(root->second, reachable);
+        }
+    }
+
+    for (size_t u = 0; u < units.size(); u++)
+    {
+        removeFunctions((int) u, reachable);
+        removeStatics((int) u);
+    }
+
+    findFunctions();
+    return true;
+}
+
+/*
+ Finds the functions that can call themselves, directly or through others.
+ */
+void VMProgram::findRecursive(vector<bool> &recursive)
+{
+    recursive.assign(functions.size(), false);
+
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        vector<bool> reachable(functions.size(), false);
+        Function &entry = functions[f];
+        VMCode &code = units[entry.unit].code;
+        vector<VMInstruction> &instructions = code.getInstructions();
+
+        for (int i = entry.start; i < entry.end; i++)
+        {
+            if (instructions[i].op != VM_CALL)
+                continue;
+
+            std::unordered_map<string, int>::iterator it =
+                functionIndex.find(code.getName(instructions[i].name));
+
+            if (it != functionIndex.end() && !reachable[it->second])
+                markReachable(it->second, reachable);
+        }
+        recursive[f] = reachable[f];
+    }
+}
+
+/*
+ Determines whether calls to a function may be inlined into a function of
+ the given class. The function must be no longer than the limit and must
+ not be recursive. Static variables belong to their class's .vm file, so a
+ function that uses any can only be inlined within its own class.
+ */
+bool VMProgram::canInline(int callee, int callerUnit, int limit,
+                          vector<bool> &recursive)
+{
+    Function &f = functions[callee];
+    vector<VMInstruction> &code = originalCode[f.unit];
+
+    if (recursive[callee] || f.end - f.start - 1 > limit)
+        return false;
+
+    if (f.unit != callerUnit)
+    {
+        for (int i = f.start + 1; i < f.end; i++)
+        {
+            if ((code[i].op == VM_PUSH || code[i].op == VM_POP) &&
+                code[i].segment == SEG_STATIC)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ Appends a copy of a function's body in place of a call to it, and returns
+ the number of extra locals the copy needs in the caller.
+
+ The arguments on the stack are popped into caller locals from base
+ upwards, and the callee's own locals follow them, set to 0 as a call would.
+ The body's argument and local references are moved onto those, its labels
+ are renamed so that they are unique in the caller, and each return becomes
+ a jump to the end of the copy, where its value is left on the stack. If the
+ body changes 'this' or 'that', the caller's is kept in one more local and
+ put back afterwards, as a return would, since the peephole pass may have
+ counted on the call leaving 'that' where it was.
+ */
+int VMProgram::inlineCall(int callerUnit, int callee, int argumentCount,
+                          int base)
+{
+    Function &f = functions[callee];
+    VMCode &from = units[f.unit].code;
+    VMCode &to = units[callerUnit].code;
+    vector<VMInstruction> &body = originalCode[f.unit];
+    int localCount = body[f.start].value;
+    int saveThis = -1;
+    int saveThat = -1;
+    int extra = 0;
+    int endLabel = -1;
+    string prefix = from.getName(body[f.start].name) + "$" +
+                    std::to_string(inlinedCalls++) + "$";
+
+    for (int i = f.start + 1; i < f.end; i++)
+    {
+        if (body[i].op != VM_POP || body[i].segment != SEG_POINTER)
+            continue;
+        if (body[i].value == 0 && saveThis < 0)
+            saveThis = base + argumentCount + localCount + extra++;
+        else if (body[i].value == 1 && saveThat < 0)
+            saveThat = base + argumentCount + localCount + extra++;
+    }
+
+    if (saveThis >= 0)
+    {
+        to.push(SEG_POINTER, 0);
+        to.pop(SEG_LOCAL, saveThis);
+    }
+    if (saveThat >= 0)
+    {
+        to.push(SEG_POINTER, 1);
+        to.pop(SEG_LOCAL, saveThat);
+    }
+    for (int i = argumentCount - 1; i >= 0; i--)
+        to.pop(SEG_LOCAL, base + i);
+    for (int i = 0; i < localCount; i++)
+    {
+        to.push(SEG_CONSTANT, 0);
+        to.pop(SEG_LOCAL, base + argumentCount + i);
+    }
+
+    for (int i = f.start + 1; i < f.end; i++)
+    {
+        VMInstruction &instruction = body[i];
+        int segment = instruction.segment;
+        int value = instruction.value;
+
+        switch (instruction.op)
+        {
+            case VM_PUSH:
+            case VM_POP:
+                if (segment == SEG_ARGUMENT)
+                {
+                    segment = SEG_LOCAL;
+                    value += base;
+                }
+                else if (segment == SEG_LOCAL)
+                {
+                    value += base + argumentCount;
+                }
+                to.add(instruction.op, segment, value, -1);
+                break;
+
+            case VM_LABEL:
+            case VM_GOTO:
+            case VM_IF_GOTO:
+                to.add(instruction.op, 0, 0,
+                       to.addName(prefix + from.getName(instruction.name)));
+                break;
+
+            case VM_CALL:
+                to.call(from.getName(instruction.name), value);
+                break;
+
+            case VM_RETURN:
+                // The last return just falls through to the caller's code
+                if (i == f.end - 1)
+                    break;
+                if (endLabel < 0)
+                    endLabel = to.addName(prefix + "END");
+                to.gotoLabel(endLabel);
+                break;
+
+            default:
+                to.arithmetic(instruction.op);
+                break;
+        }
+    }
+
+    if (endLabel >= 0)
+        to.label(endLabel);
+    if (saveThis >= 0)
+    {
+        to.push(SEG_LOCAL, saveThis);
+        to.pop(SEG_POINTER, 0);
+    }
+    if (saveThat >= 0)
+    {
+        to.push(SEG_LOCAL, saveThat);
+        to.pop(SEG_POINTER, 1);
+    }
+
+    return argumentCount + localCount + extra;
+}
+
+/*
+ Replaces each call to a function no longer than limit instructions with a
+ copy of its body. Bodies are copied as they were before this pass, so each
+ call is expanded at most one level deep. The copies in one function never
+ run at the same time, so they share a single block of extra locals, as
+ large as the largest copy needs. Functions that are no longer called are
+ left for removeDeadCode() to remove.
+ */
+void VMProgram::inlineCalls(int limit)
+{
+    vector<bool> recursive;
+
+    findFunctions();
+    findRecursive(recursive);
+
+    // Names are only ever added, so the old code's name numbers stay valid
+    originalCode.resize(units.size());
+    for (size_t u = 0; u < units.size(); u++)
+        originalCode[u].swap(units[u].code.getInstructions());
+
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        Function &caller = functions[f];
+        VMCode &code = units[caller.unit].code;
+        vector<VMInstruction> &in = originalCode[caller.unit];
+        int header = code.getSize();
+        int base = in[caller.start].value;
+        int extra = 0;
+
+        code.getInstructions().push_back(in[caller.start]);
+        for (int i = caller.start + 1; i < caller.end; i++)
+        {
+            std::unordered_map<string, int>::iterator it =
+                functionIndex.end();
+
+            if (in[i].op == VM_CALL)
+                it = functionIndex.find(code.getName(in[i].name));
+
+            if (it == functionIndex.end() || it->second == (int) f ||
+                !canInline(it->second, caller.unit, limit, recursive))
+            {
+                code.getInstructions().push_back(in[i]);
+                continue;
+            }
+
+            extra = std::max(extra, inlineCall(caller.unit, it->second,
+                                               in[i].value, base));
+        }
+        code.getInstructions()[header].value = base + extra;
+    }
+
+    originalCode.clear();
+    findFunctions();
+}
+
+/*
+ Writes each class's code to its .vm file. A class left with no code still
+ gets an empty file, so no stale code from an earlier build is loaded with
+ the program. Returns false if a file could not be written.
+ */
+bool VMProgram::write(string &diagnostics)
+{
+    bool ok = true;
+
+    for (size_t u = 0; u < units.size(); u++)
+    {
+        VMWriter writer;
+
+        if (!writer.open(units[u].outFileName))
+        {
+            diagnostics += "cannot create " + units[u].outFileName + "\n";
+            ok = false;
+            continue;
+        }
+        writer.writeCode(units[u].code);
+        if (!writer.close())
+        {
+            diagnostics += units[u].outFileName + ": cannot write output\n";
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+/*
+ Returns the number of classes in the program.
+ */
+int VMProgram::getUnitCount()
+{
+    return (int) units.size();
+}
+
+/*
+ Returns the VM code of one class, for running or inspecting the program
+ without writing it out.
+ */
+VMCode &VMProgram::getCode(int unit)
+{
+    return units[unit].code;
+}
+
+/*
+ Returns the number of functions in the program.
+ */
+int VMProgram::getFunctionCount()
+{
+    return (int) functions.size();
+}
+
+/*
+ Returns the number of functions removed as unreachable.
+ */
+int VMProgram::getRemovedFunctions()
+{
+    return removedFunctions;
+}
+
+/*
+ Returns the number of static variable slots freed by removing unused
+ statics.
+ */
+int VMProgram::getRemovedStatics()
+{
+    return removedStatics;
+}
+
+/*
+ Returns the number of calls replaced by inlineCalls().
+ */
+int VMProgram::getInlinedCalls()
+{
+    return inlinedCalls;
+}
@@ -0,0 +1,81 @@
+/*
+ VMProgram.hpp
+ CodeGenerator
+
+ The VM code of every class in a program, held in memory so that it can be
+ optimized as a whole before any of it is written. Jack resolves every call
+ at compile time, so the call graph is exact: a subroutine that cannot be
+ reached from the program's entry point is never run, and is removed along
+ with the static variables that only it used, and a call to a small
+ subroutine can be replaced by a copy of its body, even across classes.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef VMProgram_hpp
+#define VMProgram_hpp
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include "VMCode.hpp"
+
+using std::string;
+using std::vector;
+
+class VMProgram
+{
+private:
+    struct Unit
+    {
+        string outFileName;
+        VMCode code;
+    };
+
+    /*
+     Where a function's code is: its class, and the range of instructions
+     from its function instruction up to the next one.
+     */
+    struct Function
+    {
+        int unit;
+        int start;
+        int end;
+    };
+
+    vector<Unit> units;
+    vector<Function> functions;
+    std::unordered_map<string, int> functionIndex;
+    int removedFunctions;
+    int removedStatics;
+    int inlinedCalls;
+
+    // Each class's instructions as they were before inlineCalls() began
+    vector<vector<VMInstruction> > originalCode;
+
+private:
+    void findFunctions();
+    void markReachable(int function, vector<bool> &reachable);
+    void removeFunctions(int unit, vector<bool> &reachable);
+    void removeStatics(int unit);
+    void findRecursive(vector<bool> &recursive);
+    bool canInline(int callee, int callerUnit, int limit,
+                   vector<bool> &recursive);
+    int inlineCall(int callerUnit, int callee, int argumentCount, int base);
+
+public:
+    VMProgram();
+    void setUnitCount(int count);
+    void setUnit(int unit, string outFileName, VMCode &code);
+    bool removeDeadCode(string &diagnostics);
+    void inlineCalls(int limit);
+    bool write(string &diagnostics);
+    int getUnitCount();
+    VMCode &getCode(int unit);
+    int getFunctionCount();
+    int getRemovedFunctions();
+    int getRemovedStatics();
+    int getInlinedCalls();
+};
+
+#endif /* VMProgram_hpp */
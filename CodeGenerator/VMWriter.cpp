@@ -0,0 +1,104 @@
+/*
+ VMWriter.cpp
+ CodeGenerator
+
+ Writes the VM code generated for a class out as a .vm file, one instruction
+ per line, through a buffered OutputFile.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "VMWriter.hpp"
+
+/*
+ Opens the .vm file. An empty name writes to standard output.
+ */
+bool VMWriter::open(string fileName)
+{
+    return out.open(fileName);
+}
+
+/*
+ Writes out anything still buffered and closes the file. Returns false if
+ any write failed.
+ */
+bool VMWriter::close()
+{
+    return out.close();
+}
+
+size_t VMWriter::getBytesWritten()
+{
+    return out.getBytesWritten();
+}
+
+/*
+ Appends a number in decimal.
+ */
+void VMWriter::writeNumber(int value)
+{
+    char digits[12];
+    char *p = digits + sizeof(digits);
+    unsigned int n = (value < 0) ? 0u - (unsigned int) value :
+                                   (unsigned int) value;
+
+    do
+    {
+        *--p = (char) ('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+
+    if (value < 0)
+        *--p = '-';
+
+    out.append(p, (size_t) (digits + sizeof(digits) - p));
+}
+
+/*
+ Writes one instruction on a line of its own, e.g. "push local 2".
+ */
+void VMWriter::writeInstruction(VMCode &code, const VMInstruction &instruction)
+{
+    out.append(VMCode::getOpText(instruction.op));
+
+    switch (instruction.op)
+    {
+        case VM_PUSH:
+        case VM_POP:
+            out.append(" ", 1);
+            out.append(VMCode::getSegmentText(instruction.segment));
+            out.append(" ", 1);
+            writeNumber(instruction.value);
+            break;
+
+        case VM_FUNCTION:
+        case VM_CALL:
+            out.append(" ", 1);
+            out.append(code.getName(instruction.name).data(),
+                       code.getName(instruction.name).length());
+            out.append(" ", 1);
+            writeNumber(instruction.value);
+            break;
+
+        case VM_LABEL:
+        case VM_GOTO:
+        case VM_IF_GOTO:
+            out.append(" ", 1);
+            out.append(code.getName(instruction.name).data(),
+                       code.getName(instruction.name).length());
+            break;
+    }
+
+    out.append("\n", 1);
+}
+
+/*
+ Writes every instruction of a class.
+ */
+void VMWriter::writeCode(VMCode &code)
+{
+    vector<VMInstruction> &instructions = code.getInstructions();
+
+    for (size_t i = 0; i < instructions.size(); i++)
+        writeInstruction(code, instructions[i]);
+}
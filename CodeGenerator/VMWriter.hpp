@@ -0,0 +1,36 @@
+/*
+ VMWriter.hpp
+ CodeGenerator
+
+ Writes the VM code generated for a class out as a .vm file, one instruction
+ per line, through a buffered OutputFile.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef VMWriter_hpp
+#define VMWriter_hpp
+
+#include <iostream>
+#include "OutputFile.hpp"
+#include "VMCode.hpp"
+
+using std::string;
+
+class VMWriter
+{
+private:
+    OutputFile out;
+
+private:
+    void writeNumber(int value);
+
+public:
+    bool open(string fileName);
+    bool close();
+    size_t getBytesWritten();
+    void writeInstruction(VMCode &code, const VMInstruction &instruction);
+    void writeCode(VMCode &code);
+};
+
+#endif /* VMWriter_hpp */
@@ -0,0 +1,248 @@
+/*
+ XMLWriter.cpp
+ CodeGenerator
+
+ Writes the parse tree built by the CompilationEngine out as indented XML.
+ Lines go through a buffered OutputFile, so memory use does not grow with the
+ size of the output and an unchanged file is not rewritten.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#include "XMLWriter.hpp"
+#include "JackTokenizer.hpp"
+
+/*
+ Indentation is copied out of this run of spaces rather than built a space at
+ a time.
+ */
+static const char indentSlab[] =
+    "                                                                "
+    "                                                                ";
+
+/*
+ The entity each character is replaced with in XML text, as an index into
+ entityText, or 0 if the character is written as is. All of the escaped
+ characters fall in the first 64 entries; the rest are 0.
+ */
+static const unsigned char escapeIndex[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0,     // '"' and '&'
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 4, 0      // '<' and '>'
+};
+
+static const char *const entityText[5] =
+{
+    "", "&quot;", "&amp;", "&lt;", "&gt;"
+};
+
+static const unsigned char entityLength[5] =
+{
+    0, 6, 5, 4, 4
+};
+
+/*
+ Starts with no output open.
+ */
+XMLWriter::XMLWriter()
+{
+    indentLevel = 0;
+}
+
+/*
+ Opens the output. The output is written to a temporary file beside the named
+ one until it is closed. An empty name writes to standard output. Returns
+ false if the file could not be created.
+ */
+bool XMLWriter::open(string fileName)
+{
+    indentLevel = 0;
+    return out.open(fileName);
+}
+
+/*
+ Writes out anything still buffered and closes the output, replacing the
+ named file only if its contents changed. Returns false if any write failed.
+ */
+bool XMLWriter::close()
+{
+    return out.close();
+}
+
+size_t XMLWriter::getBytesWritten()
+{
+    return out.getBytesWritten();
+}
+
+/*
+ Writes the buffer out and empties it.
+ */
+void XMLWriter::flush()
+{
+    out.flush();
+}
+
+/*
+ Indents the next line to the current depth of the tree.
+ */
+void XMLWriter::writeIndent()
+{
+    size_t spaces = (size_t) (indentLevel * INDENT_SPACES);
+
+    while (spaces > sizeof(indentSlab) - 1)
+    {
+        out.append(indentSlab, sizeof(indentSlab) - 1);
+        spaces -= sizeof(indentSlab) - 1;
+    }
+    out.append(indentSlab, spaces);
+}
+
+/*
+ Appends text, replacing the characters XML reserves with their entities.
+ */
+void XMLWriter::writeEscaped(const char *text, size_t length)
+{
+    size_t run = 0;
+    int entity;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        entity = escapeIndex[(unsigned char) text[i]];
+        if (entity != 0)
+        {
+            out.append(text + run, i - run);
+            out.append(entityText[entity], entityLength[entity]);
+            run = i + 1;
+        }
+    }
+    out.append(text + run, length - run);
+}
+
+/*
+ Writes an opening tag and indents the lines that follow one level deeper.
+ */
+void XMLWriter::startTag(const char *tag)
+{
+    writeIndent();
+    indentLevel++;
+
+    out.append("<", 1);
+    out.append(tag);
+    out.append(">\n", 2);
+}
+
+/*
+ Closes the innermost open tag.
+ */
+void XMLWriter::endTag(const char *tag)
+{
+    indentLevel--;
+    writeIndent();
+
+    out.append("</", 2);
+    out.append(tag);
+    out.append(">\n", 2);
+}
+
+/*
+ Writes a terminal element on a line of its own, e.g.
+ <identifier> x </identifier>
+ */
+void XMLWriter::writeTerminal(const char *tag, const char *text, size_t length)
+{
+    writeIndent();
+
+    out.append("<", 1);
+    out.append(tag);
+    out.append("> ", 2);
+    writeEscaped(text, length);
+    out.append(" </", 3);
+    out.append(tag);
+    out.append(">\n", 2);
+}
+
+void XMLWriter::writeTerminal(const char *tag, const char *text)
+{
+    writeTerminal(tag, text, strlen(text));
+}
+
+/*
+ Writes bytes as they are, without indentation or escaping.
+ */
+void XMLWriter::writeRaw(const char *text, size_t length)
+{
+    out.append(text, length);
+}
+
+/*
+ Writes a node of a parse tree and everything below it. Nonterminals become
+ a pair of tags around their children, and terminals a line of their own.
+ */
+void XMLWriter::writeTree(SyntaxTree &tree, int node)
+{
+    const SyntaxNode &n = tree.getNode(node);
+    const char *tag = SyntaxTree::getKindName(n.kind);
+
+    if (n.kind == N_KEYWORD)
+    {
+        writeTerminal(tag, JackTokenizer::getKeywordText(n.code));
+    }
+    else if (n.kind == N_SYMBOL)
+    {
+        writeTerminal(tag, JackTokenizer::getSymbolText(n.code));
+    }
+    else if (SyntaxTree::isTerminal(n.kind))
+    {
+        writeTerminal(tag, tree.getNameText(n.name),
+                      tree.getNameLength(n.name));
+    }
+    else
+    {
+        startTag(tag);
+        for (int i = 0; i < tree.getChildCount(node); i++)
+            writeTree(tree, tree.getChild(node, i));
+        endTag(tag);
+    }
+}
+
+/*
+ Writes a whole parse tree, starting from its root.
+ */
+void XMLWriter::writeTree(SyntaxTree &tree)
+{
+    if (tree.getRoot() >= 0)
+        writeTree(tree, tree.getRoot());
+}
+
+/*
+ As above, for a tree read from a binary tree file, so that one can be
+ turned back into the XML the compiler would have written.
+ */
+void XMLWriter::writeTree(TreeReader &tree, int node)
+{
+    const TreeNode &n = tree.getNode(node);
+    const char *tag = SyntaxTree::getKindName(n.kind);
+
+    if (SyntaxTree::isTerminal(n.kind))
+    {
+        writeTerminal(tag, tree.getText(node), tree.getTextLength(node));
+    }
+    else
+    {
+        startTag(tag);
+        for (int child = node + 1; child < tree.getEnd(node);
+             child = tree.getEnd(child))
+        {
+            writeTree(tree, child);
+        }
+        endTag(tag);
+    }
+}
+
+void XMLWriter::writeTree(TreeReader &tree)
+{
+    if (tree.getRoot() >= 0)
+        writeTree(tree, tree.getRoot());
+}
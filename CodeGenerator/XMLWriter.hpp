@@ -0,0 +1,55 @@
+/*
+ XMLWriter.hpp
+ CodeGenerator
+
+ Writes the parse tree built by the CompilationEngine out as indented XML.
+ Lines go through a buffered OutputFile, so memory use does not grow with the
+ size of the output and an unchanged file is not rewritten.
+
+ Copyright © 2016 Kyle Bludworth. All rights reserved.
+ */
+
+#ifndef XMLWriter_hpp
+#define XMLWriter_hpp
+
+#include <iostream>
+#include <cstring>
+#include "OutputFile.hpp"
+#include "SyntaxTree.hpp"
+#include "TreeReader.hpp"
+
+using std::string;
+
+class XMLWriter
+{
+private:
+    static const int INDENT_SPACES = 2;
+    OutputFile out;
+    int indentLevel;
+
+private:
+    void writeIndent();
+    void writeEscaped(const char *text, size_t length);
+
+public:
+    XMLWriter();
+    bool open(string fileName);
+    bool close();
+    void flush();
+    size_t getBytesWritten();
+    void startTag(const char *tag);
+    void endTag(const char *tag);
+    void writeTerminal(const char *tag, const char *text, size_t length);
+    void writeTerminal(const char *tag, const char *text);
+    void writeRaw(const char *text, size_t length);
+    void writeTree(SyntaxTree &tree, int node);
+    void writeTree(SyntaxTree &tree);
+    void writeTree(TreeReader &tree, int node);
+    void writeTree(TreeReader &tree);
+
+private:
+    XMLWriter(const XMLWriter &);
+    XMLWriter &operator=(const XMLWriter &);
+};
+
+#endif /* XMLWriter_hpp */
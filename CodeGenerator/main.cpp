@@ -7,11 +7,654 @@
 //
 
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "CompilationEngine.hpp"
+#include "ThreadPool.hpp"
+#include "BuildCache.hpp"
+#include "TokenCache.hpp"
+#include "CompileServer.hpp"
+#include "LanguageServer.hpp"
+#include "VMProgram.hpp"
+#include "VMPeephole.hpp"
+#include "VMInterpreter.hpp"
+#include "AsmWriter.hpp"
+#include "SourceFile.hpp"
+#include "Benchmark.hpp"
+#include "BuildStats.hpp"
+#include "TreeReader.hpp"
 
+/*
+ Adds a source to the list of files to compile. A directory contributes
+ every .jack file directly inside it, in name order.
+ */
+static bool addInput(string path, vector<string> &files)
+{
+    struct stat info;
+    DIR *dir;
+    struct dirent *entry;
+    vector<string> found;
+    
+    if (stat(path.c_str(), &info) != 0)
+    {
+        std::cerr << path << ": no such file or directory" << endl;
+        return false;
+    }
+    
+    if (!S_ISDIR(info.st_mode))
+    {
+        files.push_back(path);
+        return true;
+    }
+    
+    dir = opendir(path.c_str());
+    if (dir == NULL)
+    {
+        std::cerr << path << ": cannot read directory" << endl;
+        return false;
+    }
+    
+    while ((entry = readdir(dir)) != NULL)
+    {
+        string name = entry->d_name;
+        if (name.length() > 5 &&
+            name.compare(name.length() - 5, 5, ".jack") == 0)
+        {
+            found.push_back(name);
+        }
+    }
+    closedir(dir);
+    
+    std::sort(found.begin(), found.end());
+    if (path[path.length() - 1] != '/')
+        path += '/';
+    for (size_t i = 0; i < found.size(); i++)
+        files.push_back(path + found[i]);
+    
+    return true;
+}
+
+/*
+ Compiles each file as an independent task on a pool of threads. Diagnostics
+ are collected per file and printed in the order the files were given, so the
+ output is the same as a serial build's. What each file took is recorded in
+ stats if it is not NULL. Returns the number of files that had errors.
+ */
+static int compileFiles(vector<string> &files, int threadCount,
+                        BuildCache *cache, const CompileOptions &options,
+                        BuildStats *stats)
+{
+    vector<string> diagnostics(files.size());
+    vector<int> errors(files.size(), 0);
+    int failed = 0;
+    
+    if (threadCount > (int) files.size())
+        threadCount = (int) files.size();
+    if (stats != NULL)
+        stats->start(files, std::max(threadCount, 1));
+    
+    auto compileOne = [&files, &diagnostics, &errors, cache, &options,
+                       stats](size_t i)
+    {
+        CompilationEngine ce(files[i], cache, options);
+        diagnostics[i] = ce.getDiagnostics();
+        errors[i] = !diagnostics[i].empty();
+        if (stats != NULL)
+            stats->setFile(i, ce.getStats());
+    };
+    
+    if (threadCount <= 1)
+    {
+        for (size_t i = 0; i < files.size(); i++)
+            compileOne(i);
+    }
+    else
+    {
+        ThreadPool pool(threadCount);
+        
+        for (size_t i = 0; i < files.size(); i++)
+            pool.submit([i, &compileOne] { compileOne(i); });
+        pool.wait();
+    }
+    if (stats != NULL)
+        stats->finish();
+    
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        std::cerr << diagnostics[i];
+        failed += errors[i];
+    }
+    
+    return failed;
+}
+
+/*
+ Compiles the files as one program. Each class is compiled to VM code on the
+ pool of threads as usual, into program rather than to files, and once every
+ class is done calls to small subroutines are inlined if asked for and the
+ functions the program can never call are removed. With -O the inlined code
+ goes through the peephole pass again. Returns the number of files that had
+ errors.
+ */
+static int compileProgram(vector<string> &files, int threadCount,
+                          const CompileOptions &options, VMProgram &program,
+                          BuildStats *stats)
+{
+    vector<string> diagnostics(files.size());
+    vector<int> errors(files.size(), 0);
+    string report;
+    int failed = 0;
+    
+    program.setUnitCount((int) files.size());
+    
+    auto compileOne = [&files, &diagnostics, &errors, &program,
+                       &options, stats](size_t i)
+    {
+        CompilationEngine ce(files[i], NULL, options);
+        diagnostics[i] = ce.getDiagnostics();
+        errors[i] = !diagnostics[i].empty();
+        program.setUnit((int) i,
+                        CompilationEngine::getOutFileName(files[i], options),
+                        ce.getVMCode());
+        if (stats != NULL)
+            stats->setFile(i, ce.getStats());
+    };
+    
+    if (threadCount > (int) files.size())
+        threadCount = (int) files.size();
+    if (stats != NULL)
+        stats->start(files, std::max(threadCount, 1));
+    
+    if (threadCount <= 1)
+    {
+        for (size_t i = 0; i < files.size(); i++)
+            compileOne(i);
+    }
+    else
+    {
+        ThreadPool pool(threadCount);
+        
+        for (size_t i = 0; i < files.size(); i++)
+            pool.submit([i, &compileOne] { compileOne(i); });
+        pool.wait();
+    }
+    if (stats != NULL)
+        stats->finish();
+    
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        std::cerr << diagnostics[i];
+        failed += errors[i];
+    }
+    if (failed > 0)
+        return failed;
+    
+    if (options.inlineLimit > 0 && program.removeDeadCode(report))
+        program.inlineCalls(options.inlineLimit);
+    program.removeDeadCode(report);
+    std::cerr << report;
+    
+    // Inlined bodies leave new patterns where they meet the caller's code
+    if (options.optimize && options.inlineLimit > 0)
+    {
+        for (int u = 0; u < program.getUnitCount(); u++)
+        {
+            VMPeephole peephole;
+            
+            peephole.optimize(program.getCode(u));
+            if (stats != NULL)
+                stats->addPeepholeHits(u, peephole);
+        }
+    }
+    
+    return failed;
+}
+
+/*
+ Runs a compiled program in the VM interpreter, typing the contents of
+ inputFile at its keyboard, and prints what it printed followed by the
+ instructions and estimated cycles of each subroutine. The screen is saved
+ to screenFile if one is given. Returns 0 if the program ran to its end.
+ */
+static int runProgram(VMProgram &program, string inputFile,
+                      string screenFile, long long stepLimit)
+{
+    VMInterpreter interpreter;
+    string diagnostics;
+    int status;
+    
+    if (!interpreter.load(program, diagnostics))
+    {
+        std::cerr << diagnostics;
+        return 1;
+    }
+    
+    if (!inputFile.empty())
+    {
+        SourceFile input;
+        
+        if (!input.open(inputFile))
+        {
+            std::cerr << inputFile << ": cannot open file" << endl;
+            return 1;
+        }
+        interpreter.setInput(string(input.begin(), input.end()));
+    }
+    interpreter.setStepLimit(stepLimit);
+    
+    status = interpreter.run();
+    cout << interpreter.getOutput() << endl;
+    if (status == RUN_SYS_ERROR)
+        std::cerr << "program stopped with Sys.error "
+                  << interpreter.getErrorCode() << endl;
+    else if (status == RUN_FAULT)
+        std::cerr << "program stopped: " << interpreter.getFault() << endl;
+    else if (status == RUN_STEP_LIMIT)
+        std::cerr << "program stopped after " << stepLimit
+                  << " instructions" << endl;
+    
+    cout << endl;
+    interpreter.writeProfile(cout);
+    
+    if (!screenFile.empty() && !interpreter.writeScreen(screenFile))
+    {
+        std::cerr << screenFile << ": cannot write file" << endl;
+        return 1;
+    }
+    return (status == RUN_HALTED) ? 0 : 1;
+}
+
+/*
+ Tokenizes each file with the scalar scanner and again with every vector
+ scanner this CPU supports, and reports any file whose token tables differ.
+ */
+static int checkScanner(int argc, const char * argv[], int first)
+{
+    int failures = 0;
+
+    for (int i = first; i < argc; i++)
+    {
+        SourceFile source;
+        JackTokenizer reference;
+
+        if (!source.open(argv[i]))
+        {
+            std::cerr << argv[i] << ": cannot open file" << endl;
+            failures++;
+            continue;
+        }
+
+        reference.setScanEngine(SCAN_SCALAR);
+        reference.tokenize(source.begin(), source.end());
+
+        for (int engine = SCAN_SSE42; engine <= SCAN_AVX2; engine++)
+        {
+            JackTokenizer candidate;
+
+            if (!candidate.setScanEngine(engine))
+                continue;
+
+            candidate.tokenize(source.begin(), source.end());
+            if (!candidate.hasSameTokens(reference))
+            {
+                cout << argv[i] << ": " << JackScanner::getEngineName(engine)
+                     << " scanner differs from scalar" << endl;
+                failures++;
+            }
+        }
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
+
+/*
+ Converts each binary tree file back into the XML the compiler writes, as
+ Out<Name>.xml next to it.
+ */
+static int convertTrees(int argc, const char * argv[], int first)
+{
+    int failures = 0;
+
+    for (int i = first; i < argc; i++)
+    {
+        TreeReader reader;
+        XMLWriter xml;
+        string outFileName = CompilationEngine::getOutFileName(argv[i]);
+
+        if (!reader.open(argv[i]))
+        {
+            std::cerr << argv[i] << ": not a tree file" << endl;
+            failures++;
+            continue;
+        }
+        if (!xml.open(outFileName))
+        {
+            std::cerr << outFileName << ": cannot create file" << endl;
+            failures++;
+            continue;
+        }
+        xml.writeTree(reader);
+        if (!xml.close())
+        {
+            std::cerr << outFileName << ": cannot write file" << endl;
+            failures++;
+        }
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
+
+/*
+ Usage: CodeGenerator [options] [file.jack | directory]...
+        CodeGenerator [options] --serve SOCKET
+        CodeGenerator [options] --watch [file.jack | directory]...
+        CodeGenerator --connect SOCKET [file.jack | directory]...
+        CodeGenerator [--precedence] --lsp
+        CodeGenerator --tree-to-xml file.jtree...
+ Options: [-j N] [--cache DIR] [--tokens | --token-cache DIR]
+          [--vm [-O] | --tree] [--program [--inline N]] [--precedence]
+          [--pipeline] [--stream]
+          [--run [--input FILE] [--screen FILE] [--steps N]] [--asm FILE]
+          [--bench [--bench-max MB] [--baseline FILE] [--save-baseline FILE]
+                   [--threshold PERCENT]] [--stats]
+ 
+ Compiles each .jack file, and every .jack file in each directory, into an
+ Out<Name>.xml file next to it, or with --vm into a <Name>.vm file of Hack VM
+ code, or with --tree into a <Name>.jtree file holding the parse tree in a
+ binary form tools can map and walk without parsing; --tree-to-xml turns
+ such files back into XML. -O folds constant expressions, replaces
+ multiplication and division by suitable constants with inline code, and
+ rewrites short runs of the generated instructions into shorter ones.
+ --program compiles the files as one program to VM code, leaving out every
+ subroutine that Main.main can never call and every static variable no
+ remaining code uses. --inline replaces each call to a subroutine of at most
+ N instructions with a copy of its body, except where the subroutine is
+ recursive or uses another class's statics, and implies --program.
+ --precedence gives the binary operators the precedence they have in C, so
+ that 2 + 3 * 4 is 14, where Jack applies them strictly left to right; the
+ tree then has a term holding an expression around each tighter operation.
+ -j sets the number of files compiled at once and defaults to the number of
+ hardware threads. --pipeline also splits each file across three threads
+ that tokenize, parse and write it at the same time, which shortens the
+ compile of a single large class. --stream compiles each file a little at a
+ time, tokenizing only as far ahead as the parser has read and writing XML
+ as each part of the class is parsed, so that a file of any size is
+ compiled in the same memory; VM and --tree output still need the whole
+ class in memory. Neither applies to files whose tokens are cached.
+ --cache keeps the output of every file in DIR, keyed on its contents, so
+ unchanged files are not compiled again. --tokens saves the tokens of each
+ file beside it in a .tok file, and --token-cache in DIR, so a file that has
+ not changed is not tokenized again even when it is compiled. With no files
+ the source is read from standard input and the output written to standard
+ output.
+ 
+ --serve keeps running as a compile server on a Unix socket, and --connect
+ sends the files to such a server instead of compiling them in this process.
+ --watch compiles the files and then recompiles them each time they are
+ saved.
+ 
+ --lsp runs a language server on standard input and output, which reports
+ the syntax errors of the files an editor has open as they are edited. An
+ edit inside a subroutine reparses only that subroutine.
+ 
+ --run compiles the files as a program, as --program does, and runs it in
+ the VM interpreter instead of writing it out. It prints what the program
+ printed and then the calls, VM instructions and estimated Hack cycles of
+ each subroutine. --input types the contents of FILE at the keyboard,
+ --screen saves the screen as a PBM image when the program ends, and --steps
+ stops the program after N VM instructions.
+ 
+ --asm compiles the files as a program, as --program does, and writes it as
+ one file of Hack assembly, or to standard output if FILE is -. The Hack
+ machine has no OS, so the OS's classes must be among the files. Calls,
+ returns and comparisons jump to routines the program shares, and the top
+ of the stack is kept in D between labels, which makes the code a good deal
+ smaller and faster than a translation of each VM instruction on its own.
+ 
+ --bench measures the speed of tokenizing, parsing and writing XML on each
+ file and on synthetic classes from 1KB up to --bench-max megabytes
+ (default 16), and fails if a phase's time grows faster than the size of
+ its input. --baseline compares the speeds with a file saved by
+ --save-baseline and fails if any is more than --threshold percent (default
+ 20) slower.
+ 
+ --stats prints, as JSON, the time and heap allocations of tokenizing,
+ parsing and writing each file, its tokens by type, the bytes it read and
+ wrote, how often each -O peephole rule rewrote its code, and the totals
+ for the build with its wall time and peak memory.
+ It goes to standard output, or to standard error when that is where the
+ compiled code or the running program's output goes.
+ */
 int main(int argc, const char * argv[]) {
     
-    CompilationEngine ce("");
+    vector<string> files;
+    int threadCount = ThreadPool::defaultThreadCount();
+    string cacheDirectory;
+    bool cacheTokens = false;
+    string tokenDirectory;
+    string serveSocket;
+    string connectSocket;
+    bool watchFiles = false;
+    bool languageServer = false;
+    bool runFiles = false;
+    string inputFile;
+    string screenFile;
+    long long stepLimit = 0;
+    string asmFile;
+    bool benchmark = false;
+    string baselineFile;
+    string saveBaselineFile;
+    Benchmark bench;
+    bool printStats = false;
+    BuildStats stats;
+    CompileOptions options;
+    bool useStandardInput = true;
+    BuildCache *cache = NULL;
+    bool ok = true;
+    
+    if (argc >= 2 && string(argv[1]) == "--check-scanner")
+    {
+        return checkScanner(argc, argv, 2);
+    }
+    
+    if (argc >= 2 && string(argv[1]) == "--tree-to-xml")
+    {
+        return convertTrees(argc, argv, 2);
+    }
+    
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        
+        if (arg == "-j" && i + 1 < argc)
+            threadCount = atoi(argv[++i]);
+        else if (arg.compare(0, 2, "-j") == 0 && arg.length() > 2)
+            threadCount = atoi(arg.c_str() + 2);
+        else if (arg == "--cache" && i + 1 < argc)
+            cacheDirectory = argv[++i];
+        else if (arg == "--tokens")
+            cacheTokens = true;
+        else if (arg == "--token-cache" && i + 1 < argc)
+        {
+            tokenDirectory = argv[++i];
+            cacheTokens = true;
+        }
+        else if (arg == "--serve" && i + 1 < argc)
+            serveSocket = argv[++i];
+        else if (arg == "--connect" && i + 1 < argc)
+            connectSocket = argv[++i];
+        else if (arg == "--watch")
+            watchFiles = true;
+        else if (arg == "--lsp")
+            languageServer = true;
+        else if (arg == "--vm")
+            options.format = FORMAT_VM;
+        else if (arg == "--tree")
+            options.format = FORMAT_TREE;
+        else if (arg == "-O")
+            options.optimize = true;
+        else if (arg == "--precedence")
+            options.precedence = true;
+        else if (arg == "--pipeline")
+            options.pipeline = true;
+        else if (arg == "--stream")
+            options.streaming = true;
+        else if (arg == "--program")
+            options.wholeProgram = true;
+        else if (arg == "--inline" && i + 1 < argc)
+        {
+            options.inlineLimit = atoi(argv[++i]);
+            options.wholeProgram = true;
+        }
+        else if (arg == "--run")
+        {
+            runFiles = true;
+            options.wholeProgram = true;
+        }
+        else if (arg == "--asm" && i + 1 < argc)
+        {
+            asmFile = argv[++i];
+            options.wholeProgram = true;
+        }
+        else if (arg == "--input" && i + 1 < argc)
+            inputFile = argv[++i];
+        else if (arg == "--screen" && i + 1 < argc)
+            screenFile = argv[++i];
+        else if (arg == "--steps" && i + 1 < argc)
+            stepLimit = atoll(argv[++i]);
+        else if (arg == "--stats")
+            printStats = true;
+        else if (arg == "--bench")
+            benchmark = true;
+        else if (arg == "--bench-max" && i + 1 < argc)
+            bench.setMaxSize((size_t) (atof(argv[++i]) * 1024 * 1024));
+        else if (arg == "--baseline" && i + 1 < argc)
+            baselineFile = argv[++i];
+        else if (arg == "--save-baseline" && i + 1 < argc)
+            saveBaselineFile = argv[++i];
+        else if (arg == "--threshold" && i + 1 < argc)
+            bench.setThreshold(atof(argv[++i]) / 100);
+        else
+        {
+            ok = addInput(arg, files) && ok;
+            useStandardInput = false;
+        }
+    }
+    
+    if (benchmark)
+    {
+        return (bench.run(files, baselineFile, saveBaselineFile) && ok) ?
+            0 : 1;
+    }
+    
+    if (!connectSocket.empty())
+    {
+        return CompileServer::request(connectSocket, files);
+    }
+    
+    if (languageServer)
+    {
+        LanguageServer server(options);
+        
+        return server.run(std::cin, cout);
+    }
+    
+    TokenCache tokenCache(tokenDirectory);
+    NameTable nameTable;
+    
+    options.nameTable = &nameTable;
+    
+    if (cacheTokens)
+    {
+        if (tokenCache.isUsable())
+        {
+            options.tokenCache = &tokenCache;
+        }
+        else
+        {
+            std::cerr << tokenDirectory << ": cannot use as token cache"
+                      << endl;
+        }
+    }
+    
+    if (options.wholeProgram)
+    {
+        VMProgram program;
+        string report;
+        
+        options.format = FORMAT_VM;
+        if (useStandardInput)
+            files.push_back("-");
+        if (compileProgram(files, threadCount, options, program,
+                           printStats ? &stats : NULL) > 0)
+            ok = false;
+        if (printStats)
+            stats.writeJSON((useStandardInput || runFiles || asmFile == "-") ?
+                            std::cerr : cout);
+        if (!ok)
+            return 1;
+        
+        if (runFiles)
+            return runProgram(program, inputFile, screenFile, stepLimit);
+        
+        if (!asmFile.empty())
+        {
+            AsmWriter writer;
+            
+            ok = writer.write(program, (asmFile == "-") ? "" : asmFile,
+                              report);
+            std::cerr << report;
+            return ok ? 0 : 1;
+        }
+        
+        ok = program.write(report);
+        std::cerr << report;
+        return ok ? 0 : 1;
+    }
+    
+    if (useStandardInput && serveSocket.empty() && !watchFiles)
+    {
+        stats.start(vector<string>(1, "-"), 1);
+        CompilationEngine ce("", NULL, options);
+        std::cerr << ce.getDiagnostics();
+        if (printStats)
+        {
+            stats.setFile(0, ce.getStats());
+            stats.finish();
+            stats.writeJSON(std::cerr);
+        }
+        return (ce.getDiagnostics().empty()) ? 0 : 1;
+    }
+    
+    if (!cacheDirectory.empty())
+    {
+        cache = new BuildCache(cacheDirectory,
+                               CompilationEngine::getOptionsKey(options));
+        if (!cache->isUsable())
+        {
+            std::cerr << cacheDirectory << ": cannot use as cache" << endl;
+            delete cache;
+            cache = NULL;
+        }
+    }
+    
+    if (!serveSocket.empty() || watchFiles)
+    {
+        CompileServer server(threadCount, cache, options);
+        
+        if (!serveSocket.empty())
+            return server.serve(serveSocket);
+        return server.watch(files);
+    }
+    
+    if (compileFiles(files, threadCount, cache, options,
+                     printStats ? &stats : NULL) > 0)
+        ok = false;
+    if (printStats)
+        stats.writeJSON(cout);
     
-    return 0;
+    delete cache;
+    return ok ? 0 : 1;
 }